@@ -0,0 +1,282 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	axil_tb.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	An AXI-Lite bus functional model for use with Verilator, the
+//		AXI-Lite counterpart to WB_TB.  Requests are issued on the AW
+//	and W channels (writes) and the AR channel (reads) back to back,
+//	without waiting for the responses to earlier ones, and the responses
+//	collected from the B and R channels as they arrive.
+//
+//	The core's slave port must use the usual S_AXI_* names.  Since such
+//	cores are clocked by S_AXI_ACLK, and reset by S_AXI_ARESETN (active
+//	low), TESTB_CLK, TESTB_RESET, and TESTB_RESET_ACTIVE are set here
+//	accordingly, and so this file must be included ahead of testb.h.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	AXIL_TB_H
+#define	AXIL_TB_H
+
+#include <stdio.h>
+
+#ifdef	TESTB_H
+#error	"axil_tb.h must be included before testb.h"
+#endif
+
+#define	TESTB_CLK		S_AXI_ACLK
+#define	TESTB_RESET		S_AXI_ARESETN
+#define	TESTB_RESET_ACTIVE	0
+
+#include <verilated.h>
+#include "testb.h"
+#include "tbhist.h"
+
+const int	AXIL_BOMBCOUNT = 32;
+
+// One element of a pipelined request list.  Addresses are byte addresses.
+// On return, read requests will have m_data set to the value returned by the
+// bus, and every request will have m_resp set to its response (BRESP or
+// RRESP).
+typedef	struct {
+	unsigned	m_addr, m_data, m_strb, m_resp;
+	bool		m_we;
+} AXILREQ;
+
+template <class VA>	class	AXIL_TB : public TESTB<VA> {
+public:
+	bool		m_bomb;
+	unsigned long	m_errs;
+	TBHIST		m_axil_stalls;	// Stall cycles, per request list
+
+	AXIL_TB(void) {
+		// {{{
+		VA	*core = TESTB<VA>::m_core;
+
+		m_bomb = false;
+		m_errs = 0;
+		core->S_AXI_AWVALID = 0;
+		core->S_AXI_WVALID  = 0;
+		core->S_AXI_ARVALID = 0;
+		core->S_AXI_AWPROT  = 0;
+		core->S_AXI_ARPROT  = 0;
+		core->S_AXI_BREADY  = 1;
+		core->S_AXI_RREADY  = 1;
+	}
+	// }}}
+
+	// axil_pipeline
+	// {{{
+	// Issue a list of requests, reads and writes in any mix.  Reads are
+	// issued on AR, and writes on AW and W, each in the order given, and
+	// each as soon as the last on its channel has been accepted.  Since
+	// AXI places no order between reads and writes, neither does this.
+	void	axil_pipeline(unsigned n, AXILREQ *req) {
+		VA		*core = TESTB<VA>::m_core;
+		unsigned	*rd, *wr, nrd = 0, nwr = 0,
+				nar = 0, naw = 0, nw = 0, nr = 0, nb = 0,
+				nstalls = 0;
+		int		errcount = 0;
+
+		if (n == 0)
+			return;
+
+		rd = new unsigned[n];
+		wr = new unsigned[n];
+		for(unsigned k=0; k<n; k++) {
+			if (req[k].m_we)
+				wr[nwr++] = k;
+			else
+				rd[nrd++] = k;
+		}
+
+		core->S_AXI_BREADY = 1;
+		core->S_AXI_RREADY = 1;
+		while((nr < nrd || nb < nwr)&&(errcount++ < AXIL_BOMBCOUNT)) {
+			bool	ar, aw, w, r, b;
+
+			core->S_AXI_ARVALID = (nar < nrd);
+			if (nar < nrd)
+				core->S_AXI_ARADDR = req[rd[nar]].m_addr;
+
+			core->S_AXI_AWVALID = (naw < nwr);
+			if (naw < nwr)
+				core->S_AXI_AWADDR = req[wr[naw]].m_addr;
+
+			core->S_AXI_WVALID = (nw < nwr);
+			if (nw < nwr) {
+				core->S_AXI_WDATA = req[wr[nw]].m_data;
+				core->S_AXI_WSTRB = req[wr[nw]].m_strb;
+			}
+
+			// The ready lines may depend upon the valids
+			core->eval();
+			ar = core->S_AXI_ARVALID && core->S_AXI_ARREADY;
+			aw = core->S_AXI_AWVALID && core->S_AXI_AWREADY;
+			w  = core->S_AXI_WVALID  && core->S_AXI_WREADY;
+			r  = core->S_AXI_RVALID  && (nr < nrd);
+			b  = core->S_AXI_BVALID  && (nb < nwr);
+			if ((core->S_AXI_ARVALID && !ar)
+					|| (core->S_AXI_AWVALID && !aw)
+					|| (core->S_AXI_WVALID && !w))
+				nstalls++;
+
+			if (r) {
+				req[rd[nr]].m_data = core->S_AXI_RDATA;
+				req[rd[nr]].m_resp = core->S_AXI_RRESP;
+			} if (b)
+				req[wr[nb]].m_resp = core->S_AXI_BRESP;
+
+			this->tick();
+
+			if (ar) nar++;
+			if (aw) naw++;
+			if (w)  nw++;
+			if (r)  nr++;
+			if (b)  nb++;
+			// Any progress restarts the count to a bomb
+			if (ar || aw || w || r || b)
+				errcount = 0;
+		}
+
+		core->S_AXI_ARVALID = 0;
+		core->S_AXI_AWVALID = 0;
+		core->S_AXI_WVALID  = 0;
+		m_axil_stalls.add(nstalls);
+
+		if (nr < nrd || nb < nwr) {
+			printf("AXIL/PIPE-BOMB: NO RESPONSE AFTER %d CLOCKS, %d of %d reads, %d of %d writes\n",
+				errcount, nr, nrd, nb, nwr);
+			m_bomb = true;
+		}
+
+		for(unsigned k=0; k<nr; k++)
+			if (req[rd[k]].m_resp != 0) {
+				printf("AXIL-READ(%08x): RRESP = %d\n",
+					req[rd[k]].m_addr, req[rd[k]].m_resp);
+				m_errs++;
+			}
+		for(unsigned k=0; k<nb; k++)
+			if (req[wr[k]].m_resp != 0) {
+				printf("AXIL-WRITE(%08x): BRESP = %d\n",
+					req[wr[k]].m_addr, req[wr[k]].m_resp);
+				m_errs++;
+			}
+
+		delete[] rd;
+		delete[] wr;
+	}
+	// }}}
+
+	unsigned	axil_read(unsigned a) {
+		// {{{
+		AXILREQ	req;
+
+		req.m_addr = a;
+		req.m_data = 0;
+		req.m_strb = 0;
+		req.m_resp = 0;
+		req.m_we   = false;
+		axil_pipeline(1, &req);
+
+		return req.m_data;
+	}
+	// }}}
+
+	void	axil_read(unsigned a, int len, unsigned *buf, const int inc=4) {
+		// {{{
+		AXILREQ	*req;
+
+		if (len <= 0)
+			return;
+
+		req = new AXILREQ[len];
+		for(int k=0; k<len; k++) {
+			req[k].m_addr = a + k * inc;
+			req[k].m_data = 0;
+			req[k].m_strb = 0;
+			req[k].m_resp = 0;
+			req[k].m_we   = false;
+		}
+
+		axil_pipeline(len, req);
+
+		for(int k=0; k<len; k++)
+			buf[k] = req[k].m_data;
+		delete[] req;
+	}
+	// }}}
+
+	void	axil_write(unsigned a, unsigned v, unsigned strb = 0x0f) {
+		// {{{
+		AXILREQ	req;
+
+		req.m_addr = a;
+		req.m_data = v;
+		req.m_strb = strb;
+		req.m_resp = 0;
+		req.m_we   = true;
+		axil_pipeline(1, &req);
+	}
+	// }}}
+
+	void	axil_write(unsigned a, unsigned ln, unsigned *buf, const int inc=4) {
+		// {{{
+		AXILREQ	*req;
+
+		if (ln == 0)
+			return;
+
+		req = new AXILREQ[ln];
+		for(unsigned k=0; k<ln; k++) {
+			req[k].m_addr = a + k * inc;
+			req[k].m_data = buf[k];
+			req[k].m_strb = 0x0f;
+			req[k].m_resp = 0;
+			req[k].m_we   = true;
+		}
+
+		axil_pipeline(ln, req);
+		delete[] req;
+	}
+	// }}}
+
+	bool	bombed(void) const { return m_bomb; }
+
+	// Requests returning anything other than OKAY
+	unsigned long	axil_errors(void) const { return m_errs; }
+
+	// The distribution of stall cycles per request list, so far
+	const TBHIST	&axil_stalls(void) const { return m_axil_stalls; }
+};
+
+#endif
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	axili2ccpu_tb.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A test bench and benchmark for the AXI-Lite I2C CPU, axili2ccpu,
+//		the counterpart to wbi2ccpu_tb.  An i2casm assembled script is
+//	loaded into a simulated AXI-Lite memory (AXILMEM), from which the CPU
+//	fetches its instructions, and the CPU is controlled over its AXI-Lite
+//	slave port (AXIL_TB).  The I2C port is connected to a bus of
+//	I2CSIMSLAVE models and EEPROMs, and the outgoing AXI stream is
+//	captured.  Once the script halts, or a clock limit is reached, the same
+//	figures are reported as by wbi2ccpu_tb, so that the two CPUs may be
+//	compared running the same scripts.
+//
+//	The instruction memory may be given read latency, stalls, and refresh
+//	intervals, and a limit to the number of reads outstanding at once.
+//	The stream sink (AXISSINK) may apply backpressure, as in wbi2ccpu_tb.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "verilated.h"
+#include "Vaxili2ccpu.h"
+
+#include "axil_tb.h"
+#include "testb.h"
+#include "tbhist.h"
+#include "i2csim.h"
+#include "i2cstats.h"
+#include "i2ceeprom.h"
+#include "i2cmonitor.h"
+#include "axilmem.h"
+#include "axissink.h"
+#include "cpubench.h"
+
+#ifdef	OLD_VERILATOR
+#define	VVAR(A)	v__DOT_ ## A
+#elif defined(ROOT_VERILATOR)
+#include "Vaxili2ccpu___024root.h"
+
+#define	VVAR(A)	rootp->axili2ccpu__DOT_ ## A
+#else
+#define	VVAR(A)	axili2ccpu__DOT_ ## A
+#endif
+
+#define	insn_valid	VVAR(_insn_valid)
+#define	s_tready	VVAR(_s_tready)
+#define	i2c_abort	VVAR(_i2c_abort)
+#define	insn		VVAR(_insn)
+
+// RXK, RXN, RXLK, and RXLN each receive one byte for the stream
+#define	RXINSN(I)	((((I) >> 8) & 0x0c) == 0x04)
+
+// Address locations, as byte addresses
+#define	ADR_CONTROL	(0<<2)
+#define	ADR_OVERRIDE	(1<<2)
+#define	ADR_ADDRESS	(2<<2)
+#define	ADR_CKCOUNT	(3<<2)
+
+// The core has no interrupt output.  Instead, o_debug[19] follows r_halted,
+// as does bit 19 of the control register
+#define	DBG_HALTED	(1u<<19)
+
+#define	LGMEMBYTES	16
+
+class	AXILCPU_TB : public AXIL_TB<Vaxili2ccpu> {
+	AXILMEM<uint32_t>	m_imem;
+	unsigned long	m_insns, m_i2c_busy, m_pf_busy, m_pf_pending,
+			m_rx_insns, m_bp_scl, m_aborts;
+	bool		m_i2c_active;
+	I2CBUS		m_last_bus;
+	I2CSIMBUS	m_i2c;
+	I2CMONITOR	*m_mon;
+	I2CSTATS	m_stats;
+	AXISSINK	m_sink;
+public:
+
+	AXILCPU_TB(void) : m_imem(LGMEMBYTES),
+			m_insns(0), m_i2c_busy(0), m_pf_busy(0),
+			m_pf_pending(0), m_rx_insns(0), m_bp_scl(0),
+			m_aborts(0), m_i2c_active(false), m_mon(NULL) {
+		m_core->i_i2c_scl = 1;
+		m_core->i_i2c_sda = 1;
+		m_core->M_INSN_ARREADY = m_imem.arready();
+		m_core->M_INSN_RVALID  = 0;
+		m_core->M_INSN_RDATA   = 0;
+		m_core->M_INSN_RRESP   = AXI_OKAY;
+		m_core->M_AXIS_TREADY = m_sink.tready();
+		m_core->i_sync_signal = 1;
+	}
+
+	~AXILCPU_TB(void) {
+		if (m_mon)
+			delete m_mon;
+	}
+
+	// Load an i2casm script into memory at the byte address given.
+	// Returns the number of bytes loaded.
+	unsigned	load(const char *fname, unsigned addr) {
+		return m_imem.load(fname, addr);
+	}
+
+	unsigned char	&operator[](unsigned addr) {
+		return m_imem[addr];
+	}
+
+	// The instruction memory, so that its latency and stalls may be
+	// configured, and its statistics read
+	AXILMEM<uint32_t>	&imem(void) { return m_imem; }
+
+	const I2CSTATS	&stats(void) const { return m_stats; }
+
+	I2CSIMBUS	&i2cbus(void) { return m_i2c; }
+
+	// The stream sink, so that its backpressure may be configured, and
+	// the stream read back
+	AXISSINK	&sink(void) { return m_sink; }
+
+	// Log every bus transaction to the given file.  See I2CMONITOR.
+	void	monitor(const char *fname) {
+		if (!m_mon)
+			m_mon = new I2CMONITOR();
+		m_mon->open(fname);
+	}
+
+	unsigned long	insns(void) const	{ return m_insns; }
+	unsigned long	i2c_busy(void) const	{ return m_i2c_busy; }
+	unsigned long	pf_busy(void) const	{ return m_pf_busy; }
+	unsigned long	stream_bytes(void) const { return m_sink.beats(); }
+
+	// I2C clocks while the sink held off a stream byte, and the bytes
+	// dropped as a result (see wbi2ccpu_tb)
+	unsigned long	backpressure_scl(void) const { return m_bp_scl; }
+	unsigned long	stream_lost(void) const {
+		unsigned long	got = m_sink.beats()
+					+ (m_core->M_AXIS_TVALID ? 1:0);
+
+		return (m_rx_insns > got) ? m_rx_insns - got : 0;
+	}
+	unsigned long	aborts(void) const	{ return m_aborts; }
+
+	// Any reads still outstanding are lost across a reset
+	void	reset(void) {
+		AXIL_TB<Vaxili2ccpu>::reset();
+		m_imem.reset();
+		m_pf_pending = 0;
+		m_core->M_INSN_ARREADY = m_imem.arready();
+		m_core->M_INSN_RVALID  = m_imem.rvalid();
+	}
+
+	void	tick(void) {
+		I2CBUS		ib;
+		bool		arvalid, rready, tvalid, tlast;
+		unsigned	araddr, tdata, tid;
+
+		// I2C bus
+		// {{{
+		ib = m_i2c(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda));
+		m_core->i_i2c_scl = ib.m_scl;
+		m_core->i_i2c_sda = ib.m_sda;
+		if (m_mon)
+			(*m_mon)(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+		m_stats(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+
+		// I2C clocks while the stream is being held off
+		if (ib.m_scl && !m_last_bus.m_scl && m_sink.stalled())
+			m_bp_scl++;
+
+		// Keep track of when the bus is between a START and a STOP
+		if (ib.m_scl) {
+			if (!ib.m_sda && m_last_bus.m_sda)
+				m_i2c_active = true;
+			else if (ib.m_sda && !m_last_bus.m_sda)
+				m_i2c_active = false;
+		}
+		m_last_bus = ib;
+		if (m_i2c_active)
+			m_i2c_busy++;
+		// }}}
+
+		// Instruction and stream accounting
+		// {{{
+		if (m_core->insn_valid && m_core->s_tready) {
+			m_insns++;
+			if (RXINSN(m_core->insn))
+				m_rx_insns++;
+		}
+		if (m_core->i2c_abort)
+			m_aborts++;
+		// }}}
+
+		// Instruction memory, and the stream sink
+		// {{{
+		// The fetch bus is busy from the clock a read address is first
+		// presented, until its data is returned
+		arvalid = m_core->M_INSN_ARVALID;
+		araddr  = m_core->M_INSN_ARADDR;
+		rready  = m_core->M_INSN_RREADY;
+		tvalid  = m_core->M_AXIS_TVALID;
+		tdata   = m_core->M_AXIS_TDATA & 0x0ff;
+		tlast   = m_core->M_AXIS_TLAST;
+		tid     = m_core->M_AXIS_TID;
+		if (arvalid || m_pf_pending > 0)
+			m_pf_busy++;
+		if (arvalid && m_core->M_INSN_ARREADY)
+			m_pf_pending++;
+		if (m_core->M_INSN_RVALID && rready && m_pf_pending > 0)
+			m_pf_pending--;
+
+		AXIL_TB<Vaxili2ccpu>::tick();
+
+		m_sink.clock(tvalid, tdata, tlast, tid);
+		m_core->M_AXIS_TREADY = m_sink.tready();
+
+		m_imem.clock(arvalid, araddr, rready);
+		m_core->M_INSN_ARREADY = m_imem.arready();
+		m_core->M_INSN_RVALID  = m_imem.rvalid();
+		m_core->M_INSN_RDATA   = m_imem.rdata();
+		m_core->M_INSN_RRESP   = m_imem.rresp();
+		// }}}
+	}
+
+	// Start the CPU running from the given address
+	void	run(unsigned addr) {
+		axil_write(ADR_ADDRESS, addr);
+	}
+
+	bool	halted(void) {
+		return (m_core->o_debug & DBG_HALTED) != 0;
+	}
+};
+
+int	main(int argc, char **argv) {
+	// {{{
+	CPUBENCH	cpu("axili2ccpu_tb", NULL);
+	AXILCPU_TB	*tb;
+	unsigned long	start_clk, nclks;
+	bool		tb_halted;
+
+	Verilated::commandArgs(argc, argv);
+
+	// Argument processing.  This bench has no options of its own.
+	while(cpu.getopt(argc, argv) != -1)
+		;
+
+	tb = new AXILCPU_TB();
+	cpu.imem(tb->imem());
+	cpu.setup(*tb);
+
+	cpu.load(*tb);
+
+	tb->reset();
+	tb->axil_write(ADR_CKCOUNT, cpu.m_ckcount);
+	tb->run(cpu.m_start_addr);
+
+	cpu.start();
+	start_clk = tb->m_tickcount;
+	do {
+		tb->m_core->i_sync_signal = cpu.sync(tb->m_tickcount - start_clk);
+		tb->tick();
+		nclks = tb->m_tickcount - start_clk;
+	} while(!tb->halted() && nclks < cpu.m_maxclks);
+	cpu.stop();
+	tb_halted = tb->halted();
+
+	printf("\n");
+	if (tb_halted) {
+		unsigned	ctrl = tb->axil_read(ADR_CONTROL),
+				pc   = tb->axil_read(ADR_ADDRESS);
+		printf("Halted after %ld clocks, PC = 0x%08x, CONTROL = 0x%08x\n",
+			nclks, pc, ctrl);
+	} else
+		printf("Timed out after %ld clocks, script still running\n",
+			nclks);
+
+	cpu.report(*tb, nclks);
+	printf("Fetch bus utilization: %10.2f%%\n",
+		100.0 * tb->pf_busy() / (double)nclks);
+	printf("Fetches:               %10ld, %ld clocks stalled\n",
+		tb->imem().requests(), tb->imem().stalls());
+	printf("I2C clocks held off:   %10ld\n", tb->backpressure_scl());
+	if (tb->axil_errors() > 0)
+		printf("AXI-Lite errors:       %10ld\n", tb->axil_errors());
+
+	// How much the fetch latency slows the bus, between bits (SCL low)
+	// and between transactions
+	tb->imem().latency().dump(stdout, "Fetch latency, clocks");
+	tb->stats().scl_low().dump(stdout, "SCL low time");
+	tb->stats().idle().dump(stdout, "I2C idle, STOP to START");
+	tb->sink().dump(stdout);
+	cpu.report_rate(nclks);
+
+	delete tb;
+
+	exit((tb_halted) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+// }}}
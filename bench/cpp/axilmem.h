@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	axilmem.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	An AXI-Lite read only memory model, to serve a core's AR and R
+//		channels--such as the instruction fetch port of axili2ccpu.
+//	Addresses are accepted whenever ARVALID and ARREADY are both high, and
+//	answered in order on the R channel, each after a (configurable, and
+//	possibly random) number of wait states, and held until RREADY.
+//	ARREADY may be dropped at random, during periodic "refresh" intervals
+//	(when no new responses are issued either), or whenever too many reads
+//	are outstanding.  Reads beyond the end of memory return SLVERR.
+//
+//	As with WBMEM, call clock() each clock with the master's outputs as
+//	they were going into the clock edge, and then set the slave's inputs
+//	from arready(), rvalid(), rdata(), and rresp().
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	AXILMEM_H
+#define	AXILMEM_H
+
+#include <stdint.h>
+
+#include "tbmem.h"
+#include "tbrand.h"
+#include "tbhist.h"
+
+// The most reads that may be outstanding at once
+#define	AXILMEM_MAXPENDING	64
+
+// AXI response codes
+#define	AXI_OKAY	0
+#define	AXI_SLVERR	2
+
+template <class BW = uint32_t>	class	AXILMEM : public TBMEM {
+	// A read address, once accepted, awaiting its response
+	typedef	struct {
+		unsigned long	m_addr, m_start, m_due;
+	} AXILMEMREQ;
+
+	AXILMEMREQ	m_fifo[AXILMEM_MAXPENDING];
+	unsigned	m_head, m_count, m_maxpending, m_minwait, m_maxwait;
+	double		m_stall_prob;
+	unsigned long	m_refresh_period, m_refresh_length;
+	TBRAND		m_rng;
+	unsigned long	m_tick, m_waiting, m_requests, m_stalls;
+	TBHIST		m_latency;
+	bool		m_arready, m_rvalid;
+	unsigned	m_rresp;
+	BW		m_rdata;
+
+	bool	refreshing(void) const {
+		return m_refresh_period
+			&& (m_tick % m_refresh_period) < m_refresh_length;
+	}
+
+	unsigned long	words(void) const { return m_size / sizeof(BW); }
+
+public:
+	AXILMEM(const int lgsize, uint64_t seed = 1)
+			: TBMEM(lgsize), m_rng(seed) {
+		m_maxpending = AXILMEM_MAXPENDING;
+		m_minwait = m_maxwait = 0;
+		m_stall_prob = 0.0;
+		m_refresh_period = m_refresh_length = 0;
+		m_requests = m_stalls = 0;
+		m_tick = 0;
+		reset();
+	}
+
+	// Configuration, as for WBMEM
+	// {{{
+	void	seed(uint64_t s) { m_rng.reseed(s); }
+
+	// Each read is answered 1+<n> clocks after its address, where n is
+	// chosen (uniformly) from lo through hi
+	void	wait_states(unsigned lo, unsigned hi) {
+		m_minwait = lo;
+		m_maxwait = (hi > lo) ? hi : lo;
+	}
+	void	wait_states(unsigned n) { wait_states(n, n); }
+
+	// Drop ARREADY on any given clock with probability prob
+	void	stall(double prob) { m_stall_prob = prob; }
+
+	// Every <period> clocks, accept and answer nothing for <length>
+	void	refresh(unsigned long period, unsigned long length) {
+		m_refresh_period = period;
+		m_refresh_length = length;
+	}
+
+	// Allow no more than <n> reads to be outstanding, counting the one
+	// (if any) being presented on the R channel
+	void	pipeline(unsigned n) {
+		m_maxpending = (n < 1) ? 1
+			: (n > AXILMEM_MAXPENDING) ? AXILMEM_MAXPENDING : n;
+	}
+	// }}}
+
+	// Abandon everything outstanding, as on a bus reset
+	void	reset(void) {
+		m_head = m_count = 0;
+		m_waiting = 0;
+		m_arready = true;
+		m_rvalid = false;
+		m_rresp = AXI_OKAY;
+		m_rdata = 0;
+	}
+
+	// clock
+	// {{{
+	// The master's outputs, as they were going into this clock edge
+	void	clock(bool arvalid, unsigned long araddr, bool rready) {
+		m_tick++;
+
+		if (m_rvalid && rready)
+			m_rvalid = false;
+
+		if (arvalid && !m_arready) {
+			m_stalls++;
+			m_waiting++;
+		} else if (arvalid) {
+			AXILMEMREQ	*req;
+			unsigned	wait = m_minwait;
+
+			if (m_maxwait > m_minwait)
+				wait += m_rng.range(m_maxwait - m_minwait + 1);
+
+			req = &m_fifo[(m_head+m_count) % AXILMEM_MAXPENDING];
+			req->m_addr  = araddr;
+			req->m_start = m_tick - m_waiting;
+			req->m_due   = m_tick + wait;
+			m_count++;
+			m_waiting = 0;
+			m_requests++;
+		}
+
+		// Outputs for the next clock: answer the next read, in order,
+		// once it's due and the R channel is free
+		if (!m_rvalid && m_count > 0 && m_fifo[m_head].m_due <= m_tick
+				&& !refreshing()) {
+			AXILMEMREQ	*req = &m_fifo[m_head];
+			unsigned long	waddr = req->m_addr / sizeof(BW);
+
+			if (waddr >= words()) {
+				m_rresp = AXI_SLVERR;
+				m_rdata = 0;
+			} else {
+				m_rresp = AXI_OKAY;
+				m_rdata = rdword<BW>(waddr);
+			}
+			m_rvalid = true;
+			m_latency.add(m_tick + 1 - req->m_start);
+			m_head = (m_head + 1) % AXILMEM_MAXPENDING;
+			m_count--;
+		}
+
+		m_arready = (m_count + (m_rvalid ? 1:0) < m_maxpending)
+			&& !refreshing()
+			&& !(m_stall_prob > 0 && m_rng.uniform() < m_stall_prob);
+	}
+	// }}}
+
+	// The slave's outputs, for the next clock
+	bool		arready(void) const	{ return m_arready; }
+	bool		rvalid(void) const	{ return m_rvalid; }
+	BW		rdata(void) const	{ return m_rdata; }
+	unsigned	rresp(void) const	{ return m_rresp; }
+
+	// Statistics
+	// {{{
+	// Reads accepted, clocks a read address was stalled, and the clocks
+	// from each address first being presented until its response
+	unsigned long	requests(void) const	{ return m_requests; }
+	unsigned long	stalls(void) const	{ return m_stalls; }
+	const TBHIST	&latency(void) const	{ return m_latency; }
+	// }}}
+};
+
+#endif
@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	axissink.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	An AXI stream sink, applying backpressure to a core's outgoing
+//		stream in any of several patterns, and recording each beat
+//	accepted along with the clock it was accepted on.
+//
+//	TREADY follows one of three patterns: always ready, ready on any given
+//	clock with some probability (a duty cycle), or bursts of so many clocks
+//	ready followed by so many not.  The pattern may either drive TREADY
+//	directly or, if a FIFO depth is given, drain a FIFO placed in front of
+//	it--as a DMA would drain the FIFO in front of it.  In that case, TREADY
+//	is low only while the FIFO is full, and the most the FIFO ever held
+//	tells how deep such a FIFO must be to keep from pushing back on the
+//	core.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	AXISSINK_H
+#define	AXISSINK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tbrand.h"
+#include "tbhist.h"
+
+typedef	enum {
+	AXISSINK_READY=0,	// TREADY is always high
+	AXISSINK_DUTY,		// TREADY is high with a given probability
+	AXISSINK_BURST		// TREADY is high <on> clocks, low <off> clocks
+} AXISSINKMODE;
+
+// One beat, as accepted by the sink
+typedef	struct {
+	unsigned long	m_tick;		// The clock the beat was accepted on
+	unsigned	m_wait;		// Clocks TVALID was held before then
+	unsigned	m_tid, m_data;
+	bool		m_last;
+} AXISBEAT;
+
+class	AXISSINK {
+	AXISSINKMODE	m_mode;
+	double		m_duty;
+	unsigned long	m_on, m_off, m_depth, m_fill, m_maxfill;
+	TBRAND		m_rng;
+	unsigned long	m_tick, m_waiting, m_stalls, m_nbeats, m_alloc,
+			m_packets;
+	TBHIST		m_wait;
+	AXISBEAT	*m_beat;
+	FILE		*m_fp;
+	bool		m_tready, m_drain;
+
+	// The drain pattern, for the clock about to start
+	bool	pattern(void) {
+		switch(m_mode) {
+		case AXISSINK_DUTY:
+			return m_rng.uniform() < m_duty;
+		case AXISSINK_BURST:
+			return (m_tick % (m_on + m_off)) < m_on;
+		default:
+			return true;
+		}
+	}
+
+	void	record(unsigned tid, unsigned data, bool last) {
+		AXISBEAT	*b;
+
+		if (m_nbeats >= m_alloc) {
+			m_alloc = (m_alloc) ? 2 * m_alloc : 4096;
+			m_beat = (AXISBEAT *)realloc(m_beat,
+					m_alloc * sizeof(AXISBEAT));
+			if (NULL == m_beat) {
+				fprintf(stderr, "ERR: Out of memory for AXIS beats\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		b = &m_beat[m_nbeats++];
+		b->m_tick = m_tick;
+		b->m_wait = m_waiting;
+		b->m_tid  = tid;
+		b->m_data = data;
+		b->m_last = last;
+
+		if (m_fp)
+			fprintf(m_fp, "%10lu %d %02x%s\n", m_tick, tid, data,
+				(last) ? " LAST":"");
+	}
+
+public:
+	AXISSINK(uint64_t seed = 1) : m_rng(seed) {
+		m_mode = AXISSINK_READY;
+		m_duty = 1.0;
+		m_on = 1; m_off = 0;
+		m_depth = m_fill = m_maxfill = 0;
+		m_tick = m_waiting = m_stalls = m_nbeats = m_alloc = 0;
+		m_packets = 0;
+		m_beat = NULL;
+		m_fp = NULL;
+		m_tready = m_drain = true;
+	}
+
+	~AXISSINK(void) {
+		if (m_fp)
+			fclose(m_fp);
+		free(m_beat);
+	}
+
+	// Configuration
+	// {{{
+	// Restart the stream the duty cycle is drawn from
+	void	seed(uint64_t s) { m_rng.reseed(s); }
+
+	void	always_ready(void) { m_mode = AXISSINK_READY; }
+
+	// Ready on any given clock with probability prob
+	void	duty(double prob) {
+		m_mode = AXISSINK_DUTY;
+		m_duty = prob;
+	}
+
+	// Ready for <on> clocks, then not ready for <off>, repeating
+	void	burst(unsigned long on, unsigned long off) {
+		m_mode = AXISSINK_BURST;
+		m_on  = (on < 1) ? 1 : on;
+		m_off = off;
+	}
+
+	// Set the pattern from a command line argument: one of "ready",
+	// "duty:<prob>", or "burst:<on>:<off>".  Returns false if the
+	// argument can't be understood.
+	bool	pattern(const char *spec) {
+		const char	*ptr;
+		char		*end;
+
+		if (0 == strcmp(spec, "ready")) {
+			always_ready();
+			return true;
+		} else if (0 == strncmp(spec, "duty:", 5)) {
+			double	prob = strtod(spec+5, &end);
+
+			if (end == spec+5 || *end || prob <= 0.0 || prob > 1.0)
+				return false;
+			duty(prob);
+			return true;
+		} else if (0 == strncmp(spec, "burst:", 6)) {
+			unsigned long	on, off;
+
+			ptr = spec+6;
+			on = strtoul(ptr, &end, 0);
+			if (end == ptr || *end != ':' || on == 0)
+				return false;
+			ptr = end+1;
+			off = strtoul(ptr, &end, 0);
+			if (end == ptr || *end)
+				return false;
+			burst(on, off);
+			return true;
+		} return false;
+	}
+
+	// Place a FIFO of <depth> beats in front of the pattern, which then
+	// drains it one beat per ready clock.  Zero, the default, lets the
+	// pattern drive TREADY directly.
+	void	fifo(unsigned long depth) { m_depth = depth; }
+
+	// Write every beat to the given file as it's accepted: the clock, the
+	// channel ID, the data, and LAST if TLAST was set
+	void	log(const char *fname) {
+		if (m_fp)
+			fclose(m_fp);
+		m_fp = fopen(fname, "w");
+		if (NULL == m_fp) {
+			fprintf(stderr, "ERR: Cannot open %s\n", fname);
+			perror("O/S Err:");
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	// clock
+	// {{{
+	// The core's stream outputs, as they were going into this clock edge
+	void	clock(bool tvalid, unsigned tdata, bool tlast, unsigned tid) {
+		// The FIFO drains a beat it held coming into this clock
+		bool	pop = (m_depth > 0) && m_drain && (m_fill > 0);
+
+		if (tvalid && m_tready) {
+			m_wait.add(m_waiting);
+			record(tid, tdata, tlast);
+			if (tlast)
+				m_packets++;
+			m_waiting = 0;
+			if (m_depth > 0)
+				m_fill++;
+		} else if (tvalid) {
+			m_stalls++;
+			m_waiting++;
+		}
+
+		if (pop)
+			m_fill--;
+		if (m_fill > m_maxfill)
+			m_maxfill = m_fill;
+
+		m_tick++;
+
+		// TREADY for the next clock
+		m_drain = pattern();
+		m_tready = (m_depth > 0) ? (m_fill < m_depth) : m_drain;
+	}
+	// }}}
+
+	// TREADY, for the next clock
+	bool	tready(void) const { return m_tready; }
+
+	// True if a beat was held off on the last clock
+	bool	stalled(void) const { return m_waiting > 0; }
+
+	// The beats accepted so far
+	unsigned long	beats(void) const { return m_nbeats; }
+	const AXISBEAT	&operator[](unsigned long k) const { return m_beat[k]; }
+
+	// Statistics
+	// {{{
+	// Beats with TLAST set, and the clocks TVALID was held low by TREADY
+	unsigned long	packets(void) const { return m_packets; }
+	unsigned long	stalls(void) const { return m_stalls; }
+
+	// The clocks each beat waited before being accepted
+	const TBHIST	&wait(void) const { return m_wait; }
+
+	// The most beats the FIFO (if any) ever held
+	unsigned long	max_fill(void) const { return m_maxfill; }
+
+	void	dump(FILE *fp) const {
+		fprintf(fp, "AXIS beats:            %10lu, %lu packets\n",
+			m_nbeats, m_packets);
+		fprintf(fp, "AXIS backpressure:     %10lu clocks\n", m_stalls);
+		if (m_depth > 0)
+			fprintf(fp, "AXIS FIFO high water:  %10lu of %lu beats\n",
+				m_maxfill, m_depth);
+		m_wait.dump(fp, "AXIS TVALID to TREADY");
+	}
+	// }}}
+};
+
+#endif
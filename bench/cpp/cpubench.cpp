@@ -0,0 +1,369 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	cpubench.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The command line options, bus setup, and report shared by the
+//		I2C CPU benches.  See cpubench.h.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "cpubench.h"
+
+// The options every CPU bench shares, unless it drops them.  The defaults
+// given here are those of cpubench.h.
+static const CPUBENCH_OPT	shared_opts[] = {
+	// {{{
+	{ 'a', "<addr>", false,
+"\tThe byte address to load the script into, and to start\n"
+"\t\tit running from.  Defaults to 0.\n" },
+	{ 'B', "<backpressure>", false,
+"\tHolds off the outgoing stream: ready (the\n"
+"\t\tdefault) never does, duty:<prob> is ready on any given clock\n"
+"\t\twith probability <prob>, and burst:<on>:<off> is ready <on>\n"
+"\t\tclocks out of every <on>+<off>.\n" },
+	{ 'c', "<ckcount>", false,
+"\tThe value to write to the clock control register.\n"
+"\t\tDefaults to 10.\n" },
+	{ 'd', "<devaddr>", true,
+"\tAdds a slave at the given 7-bit address to the I2C bus.\n"
+"\t\tMay be given more than once.  Defaults to a single slave at 0x50.\n" },
+	{ 'D', "<depth>", false,
+"\tPlaces a FIFO of <depth> bytes in front of the\n"
+"\t\tbackpressure, which then drains it, and reports the most the\n"
+"\t\tFIFO ever held\n" },
+	{ 'e', "<devaddr>[:<image>]", true,
+"\tAdds a 32kB EEPROM, with two byte addressing,\n"
+"\t\tat the given address.  If <image> is given, the EEPROM\'s\n"
+"\t\tcontents are mapped from (and written back to) that file.\n"
+"\t\tWrite cycles last 5ms, as measured by <clkhz>.\n" },
+	{ 'f', "<clkhz>", false,
+"\tThe system clock rate, used to report instructions per\n"
+"\t\tsecond.  Defaults to 100000000\n" },
+	{ 'l', NULL, false,
+"\tUse transaction level slave models, which never stretch the\n"
+"\t\tclock and skip their bit level protocol checks\n" },
+	{ 'm', "<log>", false,
+"\tLogs every I2C bus transaction to <log>, as text, or in\n"
+"\t\tbinary if <log> ends in .bin\n" },
+	{ 'o', "<file>", false,
+"\tWrites each stream byte to <file>, with the clock it was\n"
+"\t\taccepted on, its channel ID, and TLAST\n" },
+	{ 'p', "<depth>", false,
+"\tLets no more than <depth> fetches be outstanding at\n"
+"\t\tonce.  1 makes for a memory that isn't pipelined at all.\n" },
+	{ 'R', "<period>:<clocks>", false,
+"\tStalls the instruction memory, and holds off\n"
+"\t\tits responses, for <clocks> out of every <period>, as a DRAM\n"
+"\t\trefresh would.\n" },
+	{ 's', "<period>", false,
+"\tPulses the sync signal once every <period> clocks.  By\n"
+"\t\tdefault, the sync signal is held high so WAIT never waits.\n" },
+	{ 'S', "<seed>", false,
+"\tSeeds the random wait states, stalls, backpressure,\n"
+"\t\tcompeting master, and faults, each from a stream of its own.\n"
+"\t\tBy default a new seed is made up.  Either way, it is logged\n"
+"\t\tso the run may be repeated.\n" },
+	{ 't', "<maxclks>", false,
+"\tStop after <maxclks> clocks, if the script has not yet\n"
+"\t\thalted.  Defaults to 10000000\n" },
+	{ 'w', "<waits>[:<max>]", false,
+"\tAdds <waits> wait states to every instruction\n"
+"\t\tfetch or, if <max> is given, anywhere from <waits> through\n"
+"\t\t<max> chosen at random.  By default, each fetch is\n"
+"\t\tanswered on the clock after it is requested.\n" },
+	{ 'W', "<prob>", false,
+"\tStalls the instruction memory on any given clock with\n"
+"\t\tprobability <prob>\n" },
+	{ 'z', NULL, false,
+"\tUse slaves that never stretch the clock on an ACK\n" },
+	{ 0, NULL, false, NULL }
+	// }}}
+};
+
+// Options are listed in alphabetical order, with each lower case letter
+// ahead of its upper case
+static	int	optorder(int opt) {
+	return 2*tolower(opt) + (isupper(opt) ? 1:0);
+}
+
+CPUBENCH::CPUBENCH(const char *prog, const CPUBENCH_OPT *own,
+		const char *drop, const char *about)
+		: m_prog(prog), m_about(about), m_drop(drop), m_own(own),
+		m_script(NULL), m_start_addr(0), m_ckcount(DEFAULT_CKCOUNT),
+		m_sync_period(0), m_maxclks(DEFAULT_MAXCLKS),
+		m_clkhz(DEFAULT_CLKHZ), m_ndevs(0), m_neeproms(0),
+		m_no_stretch(false), m_tlm(false), m_stream_fname(NULL),
+		m_logname(NULL), m_backpressure(NULL), m_fifo_depth(0),
+		m_waits(0), m_maxwaits(0), m_pf_depth(0), m_pf_stall(0.0),
+		m_refresh_period(0), m_refresh_length(0), m_seedstr(NULL) {
+	// {{{
+	char	*ptr = m_optstr;
+
+	*ptr++ = 'h';
+	for(int opt=1; opt<128; opt++) {
+		const CPUBENCH_OPT	*op = lookup(opt);
+
+		if (!op)
+			continue;
+		assert(ptr + 2 < &m_optstr[sizeof(m_optstr)]);
+		*ptr++ = opt;
+		if (op->m_arg)
+			*ptr++ = ':';
+	} *ptr = '\0';
+
+	memset(m_eeprom, 0, sizeof(m_eeprom));
+}
+// }}}
+
+const CPUBENCH_OPT *CPUBENCH::lookup(int opt) const {
+	// {{{
+	for(const CPUBENCH_OPT *op = m_own; op && op->m_opt; op++)
+		if (op->m_opt == opt)
+			return op;
+	if (strchr(m_drop, opt))
+		return NULL;
+	for(const CPUBENCH_OPT *op = shared_opts; op->m_opt; op++)
+		if (op->m_opt == opt)
+			return op;
+	return NULL;
+}
+// }}}
+
+void	CPUBENCH::usage(void) const {
+	// {{{
+	const CPUBENCH_OPT	*list[128];
+	unsigned		nopts = 0;
+	int			col;
+
+	for(int opt=1; opt<128; opt++)
+		if (opt != 'h' && lookup(opt))
+			list[nopts++] = lookup(opt);
+	for(unsigned i=1; i<nopts; i++) {
+		const CPUBENCH_OPT	*op = list[i];
+		unsigned		j = i;
+
+		for(; j>0 && optorder(list[j-1]->m_opt) > optorder(op->m_opt);
+				j--)
+			list[j] = list[j-1];
+		list[j] = op;
+	}
+
+	// The usage line, wrapped to fit
+	col = printf("USAGE: %s [-h]", m_prog);
+	for(unsigned k=0; k<nopts; k++) {
+		char	str[64];
+
+		snprintf(str, sizeof(str), " [-%c%s%s]%s", list[k]->m_opt,
+			(list[k]->m_arg) ? " " : "",
+			(list[k]->m_arg) ? list[k]->m_arg : "",
+			(list[k]->m_many) ? "*" : "");
+		if (col + strlen(str) > 72)
+			col = 16 + printf("\n\t\t%s", str+1) - 3;
+		else
+			col += printf("%s", str);
+	}
+	if (col + strlen(" <script>") > 72)
+		printf("\n\t\t<script>\n\n");
+	else
+		printf(" <script>\n\n");
+
+	if (m_about)
+		printf("%s\n", m_about);
+
+	printf("\t<script>\tAn i2casm assembled script, in either binary (-b) or the\n"
+"\t\tdefault hex output format\n");
+	for(unsigned k=0; k<nopts; k++)
+		printf("\t-%c%s%s%s", list[k]->m_opt,
+			(list[k]->m_arg) ? " " : "",
+			(list[k]->m_arg) ? list[k]->m_arg : "",
+			list[k]->m_help);
+}
+// }}}
+
+void	CPUBENCH::option(int opt, char *arg) {
+	// {{{
+	char	*ptr;
+
+	switch(opt) {
+	case 'a': m_start_addr = strtoul(arg, NULL, 0); break;
+	case 'B': m_backpressure = arg; break;
+	case 'c': m_ckcount = strtoul(arg, NULL, 0); break;
+	case 'd':
+		if (m_ndevs >= CPUBENCH_MAXDEVS) {
+			fprintf(stderr, "ERR: Too many slaves\n");
+			exit(EXIT_FAILURE);
+		}
+		m_devaddr[m_ndevs++] = strtoul(arg, NULL, 0) & 0x07f;
+		break;
+	case 'D': m_fifo_depth = strtoul(arg, NULL, 0); break;
+	case 'e':
+		if (m_neeproms >= CPUBENCH_MAXDEVS) {
+			fprintf(stderr, "ERR: Too many EEPROMs\n");
+			exit(EXIT_FAILURE);
+		}
+		m_eeaddr[m_neeproms] = strtoul(arg, &ptr, 0) & 0x07f;
+		m_eeimage[m_neeproms++] = (*ptr == ':') ? ptr+1 : NULL;
+		break;
+	case 'f': m_clkhz = atof(arg); break;
+	case 'l': m_tlm = true; break;
+	case 'm': m_logname = arg; break;
+	case 'o': m_stream_fname = arg; break;
+	case 'p': m_pf_depth = strtoul(arg, NULL, 0); break;
+	case 'R':
+		m_refresh_period = strtoul(arg, &ptr, 0);
+		if (*ptr != ':' || m_refresh_period == 0) {
+			fprintf(stderr, "ERR: Bad refresh, %s\n", arg);
+			exit(EXIT_FAILURE);
+		}
+		m_refresh_length = strtoul(ptr+1, NULL, 0);
+		break;
+	case 's': m_sync_period = strtoul(arg, NULL, 0); break;
+	case 'S': m_seedstr = arg; break;
+	case 't': m_maxclks = strtoul(arg, NULL, 0); break;
+	case 'w':
+		m_waits = m_maxwaits = strtoul(arg, &ptr, 0);
+		if (*ptr == ':')
+			m_maxwaits = strtoul(ptr+1, NULL, 0);
+		break;
+	case 'W': m_pf_stall = atof(arg); break;
+	case 'z': m_no_stretch = true; break;
+	default:
+		// Not reached: getopt() only passes the shared options here
+		assert(0);
+	}
+}
+// }}}
+
+int	CPUBENCH::getopt(int argc, char **argv) {
+	// {{{
+	int	opt;
+
+	while((opt = ::getopt(argc, argv, m_optstr)) != -1) {
+		const CPUBENCH_OPT	*op;
+
+		if (opt == 'h') {
+			usage(); exit(EXIT_SUCCESS);
+		} else if (opt == '?' || (op = lookup(opt)) == NULL) {
+			usage(); exit(EXIT_FAILURE);
+		}
+
+		// The program's own options, including any shared option it
+		// takes differently, are left for it
+		for(const CPUBENCH_OPT *own = m_own; own && own->m_opt; own++)
+			if (own == op)
+				return opt;
+
+		option(opt, optarg);
+	}
+
+	if (optind + 1 != argc || m_clkhz <= 0 || (m_ckcount & ~0x0fff)) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+	m_script = argv[optind];
+
+	if (m_ndevs == 0 && m_neeproms == 0)
+		m_devaddr[m_ndevs++] = DEFAULT_SLAVE;
+
+	m_rng.reseed(tbrand_seed(m_seedstr));
+
+	return -1;
+}
+// }}}
+
+void	CPUBENCH::slaves(I2CSIMBUS &bus) {
+	// {{{
+	for(unsigned k=0; k<m_neeproms; k++) {
+		if (bus.slave(m_eeaddr[k]) != NULL) {
+			fprintf(stderr, "ERR: Two devices at 0x%02x\n",
+				m_eeaddr[k]);
+			exit(EXIT_FAILURE);
+		}
+		m_eeprom[k] = new I2CEEPROM(m_eeaddr[k], EEPROM_ADDR_BITS,
+				EEPROM_PAGE_BITS, m_eeimage[k]);
+		m_eeprom[k]->write_time((unsigned long)(5e-3 * m_clkhz));
+		if (m_no_stretch)
+			m_eeprom[k]->stretch(0);
+		bus.add(m_eeprom[k]);
+	}
+	for(unsigned k=0; k<m_ndevs; k++) {
+		if (bus.slave(m_devaddr[k]) == NULL)
+			bus.add(m_devaddr[k]);
+		if (m_no_stretch)
+			bus[m_devaddr[k]].stretch(0);
+	}
+	bus.transaction_level(m_tlm);
+}
+// }}}
+
+void	CPUBENCH::sink(AXISSINK &sink) {
+	// {{{
+	if (m_backpressure && !sink.pattern(m_backpressure)) {
+		fprintf(stderr, "ERR: Bad backpressure, %s\n", m_backpressure);
+		exit(EXIT_FAILURE);
+	}
+	sink.fifo(m_fifo_depth);
+	if (m_stream_fname)
+		sink.log(m_stream_fname);
+}
+// }}}
+
+void	CPUBENCH::report_eeproms(void) const {
+	// {{{
+	for(unsigned k=0; k<m_neeproms; k++) {
+		printf("EEPROM(0x%02x) writes:   %10ld, %ld busy NAKs\n",
+			m_eeaddr[k], m_eeprom[k]->write_cycles(),
+			m_eeprom[k]->busy_naks());
+		if (m_eeprom[k]->write_cycles() > 0)
+			printf("EEPROM(0x%02x) polling:  %10.1f clocks from STOP to ACK\n",
+				m_eeaddr[k], m_eeprom[k]->poll_latency());
+	}
+}
+// }}}
+
+void	CPUBENCH::report_rate(unsigned long nclks) const {
+	// {{{
+	double	wall;
+
+	wall = (m_tend.tv_sec - m_tstart.tv_sec)
+			+ (m_tend.tv_nsec - m_tstart.tv_nsec) * 1e-9;
+	if (wall > 0)
+		printf("Simulation rate:       %10.1f clocks/s\n", nclks / wall);
+}
+// }}}
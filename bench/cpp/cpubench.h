@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	cpubench.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	What the I2C CPU benches, wbi2ccpu_tb, axili2ccpu_tb, and
+//		wbi2ccpu_iss, have in common: their command line options and
+//	usage message, setting up the slaves on the bus and the stream sink,
+//	and the bulk of the report each prints once the script halts.
+//
+//	Each program lists the options it adds of its own, and any of the
+//	shared ones it takes differently, in a table of CPUBENCH_OPTs.  The
+//	usage message is put together from that table and the shared one, so
+//	the two can't drift apart.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	CPUBENCH_H
+#define	CPUBENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include "tbrand.h"
+#include "i2csim.h"
+#include "i2ceeprom.h"
+#include "axissink.h"
+
+#define	CPUBENCH_MAXDEVS	128
+
+#define	DEFAULT_SLAVE	0x50
+#define	DEFAULT_CKCOUNT	10
+#define	DEFAULT_MAXCLKS	10000000ul
+#define	DEFAULT_CLKHZ	100e6
+
+// One command line option: its letter, the name of its argument (NULL if it
+// takes none), whether it may be given more than once, and its help text.
+// The help text follows "\t-<opt> <arg>" in the usage message, so it starts
+// with a tab, and its continuation lines with two.
+typedef	struct {
+	char		m_opt;
+	const char	*m_arg;
+	bool		m_many;
+	const char	*m_help;
+} CPUBENCH_OPT;
+
+class	CPUBENCH {
+	const char		*m_prog, *m_about, *m_drop;
+	const CPUBENCH_OPT	*m_own;
+	char			m_optstr[128];
+	struct timespec		m_tstart, m_tend;
+
+	// The option for the given letter, taking the program's own first,
+	// or NULL if this program doesn't take it
+	const CPUBENCH_OPT	*lookup(int opt) const;
+
+	// Handle one of the shared options
+	void	option(int opt, char *arg);
+public:
+	// The shared options, as given on the command line
+	// {{{
+	const char	*m_script;
+	unsigned	m_start_addr, m_ckcount, m_sync_period;
+	unsigned long	m_maxclks;
+	double		m_clkhz;
+
+	// The slaves on the bus
+	unsigned	m_ndevs, m_devaddr[CPUBENCH_MAXDEVS];
+	unsigned	m_neeproms, m_eeaddr[CPUBENCH_MAXDEVS];
+	const char	*m_eeimage[CPUBENCH_MAXDEVS];
+	bool		m_no_stretch, m_tlm;
+
+	// The stream sink, and the bus log
+	const char	*m_stream_fname, *m_logname, *m_backpressure;
+	unsigned long	m_fifo_depth;
+
+	// The instruction memory, for those benches that model one
+	unsigned	m_waits, m_maxwaits, m_pf_depth;
+	double		m_pf_stall;
+	unsigned long	m_refresh_period, m_refresh_length;
+
+	// The seed, if one was given
+	const char	*m_seedstr;
+	// }}}
+
+	// Seeded from the command line once the options are parsed.  Each
+	// random model in the bench is seeded from this in turn, so that no
+	// two share a stream.
+	TBRAND		m_rng;
+
+	// The EEPROMs, once slaves() has created them
+	I2CEEPROM	*m_eeprom[CPUBENCH_MAXDEVS];
+
+	// prog is the program's name, and own lists the options it adds of
+	// its own, ending with one whose m_opt is zero.  Any shared option
+	// whose letter is in drop is left out.  about, if given, is printed
+	// beneath the usage line.
+	CPUBENCH(const char *prog, const CPUBENCH_OPT *own,
+		const char *drop = "", const char *about = NULL);
+
+	void	usage(void) const;
+
+	// Parse the command line as getopt() would.  The shared options are
+	// handled here, as are -h and any errors.  The program's own are
+	// returned for it to handle, with their argument in optarg.  Once
+	// the options run out, the script is checked for, m_rng is seeded,
+	// and -1 returned.
+	int	getopt(int argc, char **argv);
+
+	// Set up the slaves and the stream sink, and open the bus log.  TB
+	// may be any of the CPU benches, or I2CISS.
+	template<class TB>	void	setup(TB &tb) {
+		tb.sink().seed(m_rng.next());
+		slaves(tb.i2cbus());
+		sink(tb.sink());
+		if (m_logname)
+			tb.monitor(m_logname);
+	}
+
+	void	slaves(I2CSIMBUS &bus);
+	void	sink(AXISSINK &sink);
+
+	// Set up the instruction memory, either a WBMEM or an AXILMEM
+	template<class MEM>	void	imem(MEM &mem) {
+		mem.seed(m_rng.next());
+		mem.wait_states(m_waits, m_maxwaits);
+		mem.stall(m_pf_stall);
+		if (m_pf_depth > 0)
+			mem.pipeline(m_pf_depth);
+		mem.refresh(m_refresh_period, m_refresh_length);
+	}
+
+	// Load the script into the bench, returning its length
+	template<class TB>	unsigned	load(TB &tb) {
+		unsigned	ln = tb.load(m_script, m_start_addr);
+
+		printf("Loaded %d bytes from %s\n", ln, m_script);
+		return ln;
+	}
+
+	// The sync signal, clk clocks after the script was started.  Held
+	// high, unless a sync period was given.
+	bool	sync(unsigned long clk) const {
+		return (m_sync_period == 0) || (clk % m_sync_period) == 0;
+	}
+
+	// Time the simulation, from start() until stop()
+	void	start(void) { clock_gettime(CLOCK_MONOTONIC, &m_tstart); }
+	void	stop(void) { clock_gettime(CLOCK_MONOTONIC, &m_tend); }
+
+	// The instruction, bus, stream, and EEPROM counts every bench
+	// reports, after nclks clocks
+	template<class TB>	void	report(TB &tb, unsigned long nclks) {
+		printf("Instructions:          %10ld\n", tb.insns());
+		printf("Instructions/clock:    %10.6f\n",
+			tb.insns() / (double)nclks);
+		printf("Instructions/second:   %10.1f (at %.0f Hz)\n",
+			tb.insns() * m_clkhz / (double)nclks, m_clkhz);
+		printf("I2C bus utilization:   %10.2f%%\n",
+			100.0 * tb.i2c_busy() / (double)nclks);
+		printf("Stream bytes:          %10ld\n", tb.stream_bytes());
+		printf("Stream bytes/clock:    %10.6f\n",
+			tb.stream_bytes() / (double)nclks);
+		printf("Stream bytes lost:     %10ld\n", tb.stream_lost());
+		report_eeproms();
+		printf("I2C aborts:            %10ld\n", tb.aborts());
+	}
+
+	void	report_eeproms(void) const;
+
+	// The simulation rate, from start() to stop()
+	void	report_rate(unsigned long nclks) const;
+};
+
+#endif
@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2ceeprom.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The non-inline portions of the I2C EEPROM model.  See
+//		i2ceeprom.h for details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "i2ceeprom.h"
+
+char	*I2CEEPROM::mapimage(const char *fname, int memsz, bool shared) {
+	// {{{
+	struct stat	sb;
+	char		*mem;
+	int		fd;
+
+	if (!fname) {
+		mem = (char *)mmap(NULL, memsz, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) {
+			perror("O/S Err: ");
+			exit(EXIT_FAILURE);
+		}
+
+		memset(mem, 0x0ff, memsz);
+		return mem;
+	}
+
+	fd = open(fname, (shared) ? (O_RDWR|O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0 || fstat(fd, &sb) != 0) {
+		fprintf(stderr, "ERR: Cannot open EEPROM image, %s\n", fname);
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+
+	if (sb.st_size < memsz && shared) {
+		// Grow the file to the size of the EEPROM, so that all of it
+		// may be mapped
+		if (ftruncate(fd, memsz) != 0) {
+			fprintf(stderr, "ERR: Cannot extend %s\n", fname);
+			perror("O/S Err: ");
+			exit(EXIT_FAILURE);
+		}
+	} else if (sb.st_size < memsz) {
+		// We can't map past the end of a file we aren't allowed to
+		// change.  Read what's there into an erased EEPROM instead.
+		ssize_t	nr;
+
+		mem = mapimage(NULL, memsz, false);
+		nr = ::read(fd, mem, sb.st_size);
+		close(fd);
+		if (nr != sb.st_size) {
+			fprintf(stderr, "ERR: Cannot read %s\n", fname);
+			exit(EXIT_FAILURE);
+		}
+		return mem;
+	}
+
+	mem = (char *)mmap(NULL, memsz, PROT_READ|PROT_WRITE,
+			(shared) ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "ERR: Cannot map %s\n", fname);
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+
+	return mem;
+}
+// }}}
+
+I2CEEPROM::I2CEEPROM(const int ADDRESS, const int nbits, const int pgbits,
+		const char *fname, const bool shared)
+		: I2CSIMSLAVE(ADDRESS, nbits, mapimage(fname, 1<<nbits, shared)) {
+	// {{{
+	assert(nbits <= 16);
+	assert(pgbits <= nbits);
+
+	m_mem   = &(*this)[0];
+	m_memsz = 1<<nbits;
+	m_pgsz  = 1<<pgbits;
+	m_pgmsk = m_pgsz-1;
+	m_pgaddr = 0;
+	m_page    = new char[m_pgsz];
+	m_pgvalid = new bool[m_pgsz];
+	for(int k=0; k<m_pgsz; k++)
+		m_pgvalid[k] = false;
+	m_pending = false;
+	m_polling = false;
+
+	m_write_ticks = EEPROM_WRITE_TICKS;
+	m_busy_until  = 0;
+	m_cycle_start = 0;
+	m_cycles = m_naks = m_polls = m_poll_ticks = 0;
+
+	// Parts larger than 256 bytes take a two byte address
+	address_bytes((nbits > 8) ? 2 : 1);
+}
+// }}}
+
+I2CEEPROM::~I2CEEPROM(void) {
+	munmap(m_mem, m_memsz);
+	delete[] m_page;
+	delete[] m_pgvalid;
+}
+
+int	I2CEEPROM::devack(void) {
+	// {{{
+	if (busy()) {
+		m_naks++;
+		return 1;
+	}
+
+	if (m_polling) {
+		// This is the first time we've been addressed since our
+		// last write cycle completed
+		m_polls++;
+		m_poll_ticks += tickcount() - m_cycle_start;
+		m_polling = false;
+	}
+
+	return 0;
+}
+// }}}
+
+void	I2CEEPROM::store(int addr, char data) {
+	// {{{
+	// Writes are held in the page buffer until the STOP.  Since nxtaddr()
+	// keeps all of a transaction's writes within one page, the first
+	// sets the page.
+	if (!m_pending)
+		m_pgaddr = addr & ~m_pgmsk;
+	m_page[addr & m_pgmsk]    = data;
+	m_pgvalid[addr & m_pgmsk] = true;
+	m_pending = true;
+}
+// }}}
+
+void	I2CEEPROM::endxfer(bool stop) {
+	// {{{
+	if (!m_pending)
+		return;
+
+	// A repeated START, rather than a STOP, aborts the write
+	if (stop) {
+		for(int k=0; k<m_pgsz; k++)
+			if (m_pgvalid[k])
+				m_mem[m_pgaddr + k] = m_page[k];
+
+		m_cycle_start = tickcount();
+		m_busy_until  = m_cycle_start + m_write_ticks;
+		m_polling = true;
+		m_cycles++;
+	}
+
+	for(int k=0; k<m_pgsz; k++)
+		m_pgvalid[k] = false;
+	m_pending = false;
+}
+// }}}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2ceeprom.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	An I2C EEPROM model, such as a 24C256, built on top of the
+//		I2CSIMSLAVE.  Unlike the basic slave, the EEPROM may take two
+//	register address bytes, wraps writes around within a page, and only
+//	commits a page write on a STOP condition.  It then NAKs its device
+//	address for the duration of the write cycle, as real parts do, so that
+//	software which polls for the end of a write can be exercised and its
+//	latency measured.
+//
+//	The EEPROM's storage may be backed by a memory mapped image file, so
+//	that large images may be used without copying them into the model.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CEEPROM_H
+#define	I2CEEPROM_H
+
+#include "i2csim.h"
+
+// A 24C256: 32kB, with 64 byte pages
+#define	EEPROM_ADDR_BITS	15
+#define	EEPROM_PAGE_BITS	6
+
+// The default write cycle time, in ticks.  5ms at 100MHz.
+#define	EEPROM_WRITE_TICKS	500000ul
+
+class	I2CEEPROM : public I2CSIMSLAVE {
+	char		*m_mem, *m_page;
+	bool		*m_pgvalid, m_pending, m_polling;
+	int		m_memsz, m_pgsz, m_pgmsk, m_pgaddr;
+	unsigned long	m_write_ticks, m_busy_until, m_cycle_start,
+			m_cycles, m_naks, m_polls, m_poll_ticks;
+
+	static	char	*mapimage(const char *fname, int memsz, bool shared);
+
+protected:
+	int	devack(void);
+	void	store(int addr, char data);
+	int	nxtaddr(int addr) {
+		return (addr & ~m_pgmsk) | ((addr + 1) & m_pgmsk);
+	}
+	void	endxfer(bool stop);
+
+public:
+	// If fname is given, the EEPROM's contents are mapped from that file.
+	// If shared, writes go back to the file, which is created (or grown)
+	// as necessary.  Otherwise, the file is left untouched.  Without a
+	// file, the EEPROM starts out erased (all ones).
+	I2CEEPROM(const int ADDRESS = 0x050,
+			const int nbits = EEPROM_ADDR_BITS,
+			const int pgbits = EEPROM_PAGE_BITS,
+			const char *fname = NULL, const bool shared = true);
+	~I2CEEPROM(void);
+
+	// The length of the write cycle, in ticks
+	unsigned long	write_time(void) const { return m_write_ticks; }
+	void	write_time(unsigned long ticks) { m_write_ticks = ticks; }
+
+	// True if a write cycle is in progress
+	bool	busy(void) const { return tickcount() < m_busy_until; }
+
+	// Statistics
+	// {{{
+	// The number of write cycles, and the number of times our device
+	// address was NAK'd because one was in progress
+	unsigned long	write_cycles(void) const { return m_cycles; }
+	unsigned long	busy_naks(void) const { return m_naks; }
+
+	// The average number of ticks from the STOP that started a write
+	// cycle until we next ACK'd our device address.  This is the latency
+	// seen by software polling for the end of a write.
+	double	poll_latency(void) const {
+		return (m_polls) ? m_poll_ticks / (double)m_polls : 0.0;
+	}
+	// }}}
+};
+
+#endif
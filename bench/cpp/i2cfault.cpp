@@ -0,0 +1,273 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2cfault.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Injects faults into a simulated I2C bus.  See i2cfault.h for
+//		the details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "i2cfault.h"
+
+static	const char	*fault_names[I2CF_NTYPES] = {
+	"none", "nak", "sda", "scl", "glitch" };
+
+const char *I2CFAULT::name(I2CFTYPE t) {
+	return fault_names[(t < I2CF_NTYPES) ? t : I2CF_NONE];
+}
+
+I2CFAULT::I2CFAULT(uint64_t seed) : m_rng(seed), m_nspecs(0),
+		m_nbits(0), m_nbytes(0), m_sreg(0), m_read(false),
+		m_nakbit(false), m_type(I2CF_NONE),
+		m_pending_type(I2CF_NONE), m_tick(0), m_until(0),
+		m_onset(0), m_pending(false) {
+	for(int k=0; k<I2CF_NTYPES; k++) {
+		m_injected[k] = 0;
+		m_recovered[k] = 0;
+	}
+}
+
+void	I2CFAULT::add(I2CFTYPE type, double prob, unsigned long at,
+			unsigned long ticks) {
+	// {{{
+	assert(m_nspecs < I2CFAULT_MAXSPECS);
+	assert(type > I2CF_NONE && type < I2CF_NTYPES);
+
+	m_spec[m_nspecs].m_type  = type;
+	m_spec[m_nspecs].m_prob  = prob;
+	m_spec[m_nspecs].m_at    = at;
+	m_spec[m_nspecs].m_ticks = ticks;
+	m_spec[m_nspecs].m_fired = false;
+	m_nspecs++;
+}
+// }}}
+
+bool	I2CFAULT::add(const char *str) {
+	// {{{
+	I2CFTYPE	type = I2CF_NONE;
+	const char	*ptr = str;
+	char		*end;
+	double		prob = 0;
+	unsigned long	at = 0, ticks;
+	int		ln;
+
+	if (m_nspecs >= I2CFAULT_MAXSPECS)
+		return false;
+
+	ln = strcspn(str, ":@");
+	for(int k=I2CF_NONE+1; k<I2CF_NTYPES; k++)
+		if (ln == (int)strlen(fault_names[k])
+				&& 0 == strncmp(str, fault_names[k], ln))
+			type = (I2CFTYPE)k;
+	if (type == I2CF_NONE)
+		return false;
+
+	ptr = str + ln;
+	if (*ptr == ':') {
+		prob = strtod(ptr+1, &end);
+		if (end == ptr+1 || prob <= 0 || prob > 1)
+			return false;
+	} else if (*ptr == '@') {
+		at = strtoul(ptr+1, &end, 0);
+		if (end == ptr+1)
+			return false;
+	} else
+		return false;
+	ptr = end;
+
+	ticks = (type == I2CF_GLITCH) ? I2CFAULT_GLITCH : 0;
+	if (*ptr == ':') {
+		ticks = strtoul(ptr+1, &end, 0);
+		if (end == ptr+1)
+			return false;
+		ptr = end;
+	}
+
+	if (*ptr)
+		return false;
+
+	add(type, prob, at, ticks);
+	return true;
+}
+// }}}
+
+void	I2CFAULT::start(int k) {
+	// {{{
+	I2CFSPEC	&spec = m_spec[k];
+
+	spec.m_fired = true;
+	m_type  = spec.m_type;
+	m_until = (spec.m_ticks) ? m_tick + spec.m_ticks : 0;
+	m_injected[m_type]++;
+	m_pending = true;
+	m_pending_type = m_type;
+	m_onset = m_tick;
+}
+// }}}
+
+void	I2CFAULT::track(const I2CBUS bus, I2CSIMBUS &i2c) {
+	// {{{
+	if (bus.m_scl && m_last.m_scl && bus.m_sda != m_last.m_sda) {
+		// START or STOP.  Either way, a new byte count starts, and
+		// any NAK has run its course
+		m_nbits  = 0;
+		m_nbytes = 0;
+		m_nakbit = false;
+		if (m_type == I2CF_NAK)
+			m_type = I2CF_NONE;
+	} else if (bus.m_scl && !m_last.m_scl) {
+		m_sreg = (m_sreg << 1) | bus.m_sda;
+		if (++m_nbits == 8) {
+			if (m_nbytes == 0)
+				m_read = (m_sreg & 1);
+
+			// Pick a fault to inject, while SCL is high, once per
+			// byte
+			if (m_type == I2CF_NONE && !m_pending) {
+				for(int k=0; k<m_nspecs; k++) {
+					if (m_spec[k].m_type != I2CF_NAK
+						&& m_spec[k].m_prob > 0
+						&& m_rng.uniform()
+							< m_spec[k].m_prob) {
+						start(k);
+						break;
+					}
+				}
+			}
+		}
+	} else if (!bus.m_scl && m_last.m_scl) {
+		if (m_nbits == 7 && (m_nbytes == 0 || !m_read)
+				&& m_type == I2CF_NONE && !m_pending) {
+			// Entering the last bit of a byte the slave will ACK:
+			// the device word, or data written to it.  Only now
+			// may a NAK be injected, by having the slave NAK the
+			// byte for real.  (The read bit isn't needed to know
+			// the device word is the slave's to ACK.)
+			for(int k=0; k<m_nspecs; k++) {
+				if (m_spec[k].m_type != I2CF_NAK)
+					continue;
+				if (m_spec[k].m_prob > 0
+					? m_rng.uniform() < m_spec[k].m_prob
+					: !m_spec[k].m_fired
+						&& m_tick >= m_spec[k].m_at) {
+					start(k);
+					i2c.nak();
+					break;
+				}
+			}
+		} else if (m_nbits == 8) {
+			// Entering the ACK bit
+			m_nakbit = (m_type == I2CF_NAK);
+			if (m_nakbit)
+				m_onset = m_tick;
+		} else if (m_nbits >= 9) {
+			// End of the ACK bit
+			if (m_nakbit)
+				m_type = I2CF_NONE;
+			m_nakbit = false;
+			m_nbits = 0;
+			m_nbytes++;
+		}
+	}
+
+	m_last = bus;
+}
+// }}}
+
+I2CBUS	I2CFAULT::operator()(const I2CBUS master, I2CSIMBUS &bus) {
+	// {{{
+	I2CBUS	drv = master, r;
+
+	m_tick++;
+
+	// End any fault that has run its course
+	if (m_type != I2CF_NONE && m_type != I2CF_NAK
+			&& m_until != 0 && m_tick >= m_until)
+		m_type = I2CF_NONE;
+
+	// Start any scheduled fault whose time has come.  A NAK waits for
+	// the next byte the slave is to ACK, see track().
+	if (m_type == I2CF_NONE && !m_pending) {
+		for(int k=0; k<m_nspecs; k++)
+			if (m_spec[k].m_type != I2CF_NAK
+					&& m_spec[k].m_prob <= 0
+					&& !m_spec[k].m_fired
+					&& m_tick >= m_spec[k].m_at) {
+				start(k);
+				break;
+			}
+	}
+
+	// Stuck lines are seen by everyone on the bus
+	if (m_type == I2CF_SDA)
+		drv.m_sda = 0;
+	else if (m_type == I2CF_SCL || m_type == I2CF_GLITCH)
+		drv.m_scl = 0;
+
+	r = bus(drv);
+	track(r, bus);
+
+	return r;
+}
+// }}}
+
+void	I2CFAULT::recovered(void) {
+	// {{{
+	if (!m_pending)
+		return;
+
+	m_recovered[m_pending_type]++;
+	m_recovery[m_pending_type].add(m_tick - m_onset);
+	m_pending = false;
+}
+// }}}
+
+void	I2CFAULT::dump(FILE *fp) const {
+	// {{{
+	for(int k=I2CF_NONE+1; k<I2CF_NTYPES; k++) {
+		char	label[64];
+
+		if (m_injected[k] == 0)
+			continue;
+		fprintf(fp, "Fault %-8s %10lu injected, %lu recovered\n",
+			fault_names[k], m_injected[k], m_recovered[k]);
+		snprintf(label, sizeof(label), "Recovery from %s, clocks",
+			fault_names[k]);
+		m_recovery[k].dump(fp, label);
+	}
+}
+// }}}
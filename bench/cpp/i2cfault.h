@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2cfault.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A bus level fault injector, placed between the master under test
+//		and an I2CSIMBUS.  It can make a slave NAK, hold SDA low as
+//	a wedged slave might, glitch SCL, or hold SCL low forever (an endless
+//	clock stretch).  Faults are injected either at a given tick, or
+//	with some probability at every byte.  The test bench reports when its
+//	controller has recovered, via recovered(), and the injector keeps a
+//	histogram of the clocks from each fault to the recovery that followed.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CFAULT_H
+#define	I2CFAULT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "i2csim.h"
+#include "tbrand.h"
+#include "tbhist.h"
+
+#define	I2CFAULT_MAXSPECS	16
+
+// Default glitch length, in ticks.  Anything shorter than a couple of clocks
+// will never make it through the controllers' input synchronizers.
+#define	I2CFAULT_GLITCH		4
+
+typedef	enum { I2CF_NONE=0, I2CF_NAK, I2CF_SDA, I2CF_SCL, I2CF_GLITCH,
+	I2CF_NTYPES
+} I2CFTYPE;
+
+// One fault to be injected.  Either m_prob is non-zero, for a fault injected
+// at random with that probability per byte, or the fault is injected (once)
+// on tick m_at.
+typedef	struct {
+	I2CFTYPE	m_type;
+	double		m_prob;
+	unsigned long	m_at,
+			m_ticks;	// How long the fault lasts, 0 for forever
+	bool		m_fired;
+} I2CFSPEC;
+
+class	I2CFAULT {
+	TBRAND		m_rng;
+	I2CFSPEC	m_spec[I2CFAULT_MAXSPECS];
+	int		m_nspecs;
+
+	// Bus tracking
+	// {{{
+	I2CBUS		m_last;
+	int		m_nbits, m_nbytes, m_sreg;
+	bool		m_read, m_nakbit;
+	// }}}
+
+	// The fault being injected, if any
+	// {{{
+	I2CFTYPE	m_type, m_pending_type;
+	unsigned long	m_tick, m_until, m_onset;
+	bool		m_pending;
+	// }}}
+
+	// Statistics, by fault type
+	unsigned long	m_injected[I2CF_NTYPES], m_recovered[I2CF_NTYPES];
+	TBHIST		m_recovery[I2CF_NTYPES];
+
+	void	start(int k);
+	void	track(const I2CBUS bus, I2CSIMBUS &i2c);
+public:
+	I2CFAULT(uint64_t seed = 1);
+
+	// Add a fault, described by a string of the form
+	//	<type>:<prob>[:<ticks>]		Inject with probability <prob>,
+	//					at every byte on the bus
+	//	<type>@<tick>[:<ticks>]		Inject once, at tick <tick>
+	// where <type> is one of nak, sda, scl, or glitch.  <ticks> is how
+	// long the fault lasts, defaulting to forever for sda and scl (a stuck
+	// slave) and to I2CFAULT_GLITCH ticks for glitch.  A NAK is only ever
+	// injected on a byte the slave would ACK: the device word, or data
+	// written to it.  A scheduled NAK waits for the first such byte at or
+	// after <tick>.  Returns false if the string can't be parsed.
+	bool	add(const char *str);
+	void	add(I2CFTYPE type, double prob, unsigned long at,
+			unsigned long ticks);
+
+	// Given the master's outputs, step the bus one tick and return what
+	// the master sees of it
+	I2CBUS	operator()(const I2CBUS master, I2CSIMBUS &bus);
+
+	// Called by the test bench once its controller has recovered from
+	// the last fault.  No new fault will be injected until it has.
+	void	recovered(void);
+
+	// True while a fault is being applied to the bus
+	bool	active(void) const { return m_type != I2CF_NONE; }
+	// True from the start of a fault until recovered()
+	bool	pending(void) const { return m_pending; }
+
+	unsigned long	injected(I2CFTYPE t) const { return m_injected[t]; }
+	unsigned long	recovered(I2CFTYPE t) const { return m_recovered[t]; }
+	const TBHIST	&recovery(I2CFTYPE t) const { return m_recovery[t]; }
+
+	static	const char *name(I2CFTYPE t);
+
+	void	dump(FILE *fp) const;
+};
+
+#endif
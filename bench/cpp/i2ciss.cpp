@@ -0,0 +1,630 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2ciss.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The I2CISS instruction set simulator: the instruction decoder,
+//		and the clock by clock model of the I2C engine.  See
+//	i2ciss.h.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "i2ciss.h"
+
+// The stream's channel ID, as wbi2ccpu's default AXIS_ID_WIDTH of two bits
+// leaves it
+#define	TIDMASK		0x03
+
+#define	D_RD		false
+#define	D_WR		true
+
+static const char *const	mnemonics[16] = {
+	"NOOP", "START", "STOP", "SEND", "RXK", "RXN", "RXLK", "RXLN",
+	"WAIT", "HALT", "ABORT", "TARGET", "JUMP", "CHANNEL",
+	"ILLEGAL", "ILLEGAL" };
+
+I2CISS::I2CISS(const int lgmemsz) : m_mem(lgmemsz) {
+	// {{{
+	m_mon   = NULL;
+	m_trace = NULL;
+
+	m_pc = m_jump_target = m_abort_address = 0;
+	m_insn = m_insn_addr = m_half = m_channel = 0;
+	m_insn_valid = m_half_valid = m_wait = false;
+	// The CPU starts out halted, waiting on jump()
+	m_halted = true;
+	m_fetch_latency = m_fetch_wait = 0;
+
+	// The divider starts out at its slowest, as the RTL does
+	m_state  = I2CISS_IDLE_STOPPED;
+	m_nbits  = 0;
+	m_sreg   = 0x0ff;
+	m_ckcount = m_ckdiv = 0x0fff;
+	m_dir    = D_RD;
+	m_will_ack  = true;
+	m_last_byte = false;
+	m_scl = m_sda = m_o_scl = m_o_sda = true;
+	m_abort = m_ckedge = false;
+	m_q_scl = m_q_sda = m_ck_scl = m_ck_sda = true;
+	m_lst_scl = m_lst_sda = true;
+	m_stop_bit = m_channel_busy = false;
+
+	m_tvalid = m_tlast = m_mid_pkt = false;
+	m_tdata  = m_tid = 0;
+
+	m_tick = m_insns = m_rx_insns = m_aborts = m_i2c_busy = 0;
+	m_skipped = 0;
+	m_i2c_active = false;
+	m_fast_forward = true;
+}
+// }}}
+
+I2CISS::~I2CISS(void) {
+	if (m_mon)
+		delete m_mon;
+	if (m_trace)
+		fclose(m_trace);
+}
+
+void	I2CISS::monitor(const char *fname) {
+	if (!m_mon)
+		m_mon = new I2CMONITOR();
+	m_mon->open(fname);
+}
+
+void	I2CISS::trace(const char *fname) {
+	if (m_trace)
+		fclose(m_trace);
+	m_trace = fopen(fname, "w");
+	if (NULL == m_trace) {
+		fprintf(stderr, "ERR: Cannot open %s\n", fname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+}
+
+const char	*I2CISS::mnemonic(unsigned op) {
+	return mnemonics[op & 0x0f];
+}
+
+void	I2CISS::dump(FILE *fp, const I2CISSINSN &in) {
+	const unsigned	op = (in.m_insn >> 8) & 0x0f;
+
+	if (op == I2CISS_SEND || op == I2CISS_CHANNEL)
+		fprintf(fp, "0x%08x: %-7s 0x%02x\n", in.m_addr, mnemonic(op),
+			in.m_insn & 0x0ff);
+	else
+		fprintf(fp, "0x%08x: %s\n", in.m_addr, mnemonic(op));
+}
+
+void	I2CISS::jump(unsigned addr) {
+	// {{{
+	m_pc = m_jump_target = m_abort_address = addr;
+	m_insn_valid = m_half_valid = false;
+	m_halted = m_wait = false;
+	// The channel is held at its default while halted
+	m_channel = 0;
+	m_mid_pkt = false;
+	m_fetch_wait = m_fetch_latency;
+}
+// }}}
+
+// fetch
+// {{{
+// The CPU takes its instructions a nibble at a time, high nibble first.  A
+// NOOP in the high nibble is skipped, leaving the low nibble to issue on its
+// own.  SEND and CHANNEL take the next byte as their immediate, and any
+// low nibble beside them is ignored, as is any low nibble beside a HALT.
+//
+// TARGET and ABORT record the address of the byte following, and JUMP
+// jumps to the last TARGET--but only from the high nibble of a byte, as the
+// byte is fetched.  A JUMP in the low nibble still jumps, once it issues,
+// but a TARGET or ABORT there (or any of the three behind a NOOP) does
+// nothing at all.
+void	I2CISS::fetch(void) {
+	if (m_half_valid) {
+		m_half_valid = false;
+		m_insn = (m_half << 8) | (m_insn & 0x0ff);
+		if (m_half == I2CISS_JUMP) {
+			m_pc = m_jump_target;
+			m_fetch_wait = m_fetch_latency;
+		} else if (m_half == I2CISS_SEND || m_half == I2CISS_CHANNEL)
+			m_insn = (m_half << 8) | m_mem[m_pc++];
+	} else {
+		unsigned	byte, hi, lo;
+
+		m_insn_addr = m_pc;
+		byte = m_mem[m_pc++];
+		hi = (byte >> 4) & 0x0f;
+		lo =  byte & 0x0f;
+
+		if (hi == I2CISS_NOOP) {
+			hi = lo;
+			lo = I2CISS_NOOP;
+		} else if (hi == I2CISS_TARGET)
+			m_jump_target = m_insn_addr + 1;
+		else if (hi == I2CISS_ABORT)
+			m_abort_address = m_insn_addr + 1;
+		else if (hi == I2CISS_JUMP) {
+			m_pc = m_jump_target;
+			m_fetch_wait = m_fetch_latency;
+		}
+
+		m_insn = (hi << 8) | (m_insn & 0x0ff);
+		if (hi == I2CISS_SEND || hi == I2CISS_CHANNEL)
+			m_insn = (hi << 8) | m_mem[m_pc++];
+		else if (hi != I2CISS_HALT && lo != I2CISS_NOOP) {
+			m_half = lo;
+			m_half_valid = true;
+		}
+	}
+
+	m_insn_valid = true;
+}
+// }}}
+
+void	I2CISS::execute(unsigned insn, bool sync) {
+	// {{{
+	const unsigned	op = (insn >> 8) & 0x0f;
+
+	m_insns++;
+	if (m_trace) {
+		I2CISSINSN	in;
+
+		in.m_addr = m_insn_addr;
+		in.m_insn = insn & 0x0fff;
+		fprintf(m_trace, "%10lu ", m_tick);
+		dump(m_trace, in);
+	}
+
+	switch(op) {
+	case I2CISS_RXK: case I2CISS_RXN: case I2CISS_RXLK: case I2CISS_RXLN:
+		m_rx_insns++;
+		break;
+	case I2CISS_HALT:
+		m_halted = true;
+		break;
+	case I2CISS_CHANNEL:
+		m_channel = insn & TIDMASK;
+		break;
+	default:
+		break;
+	}
+}
+// }}}
+
+bool	I2CISS::issue(I2CISSINSN &in, bool refill) {
+	// {{{
+	if (m_halted)
+		return false;
+	if (!m_insn_valid)
+		fetch();
+
+	in.m_addr = m_insn_addr;
+	in.m_insn = m_insn & 0x0fff;
+	execute(m_insn, true);
+
+	// As soon as one instruction issues, the next is fetched into its
+	// place--so any TARGET, ABORT, or JUMP it holds takes effect now,
+	// before anything the instruction just issued might abort
+	m_insn_valid = false;
+	if (refill && !m_halted)
+		fetch();
+	return true;
+}
+// }}}
+
+void	I2CISS::abort(void) {
+	m_aborts++;
+	m_insn_valid = m_half_valid = false;
+	m_pc = m_abort_address;
+	m_fetch_wait = m_fetch_latency;
+}
+
+// engine
+// {{{
+// One clock of axisi2c.  Everything is computed from the registers as they
+// were at the start of the clock, and only then written back.
+void	I2CISS::engine(bool tvalid, bool stretch) {
+	I2CISSSTATE	state = m_state;
+	unsigned	nbits = m_nbits, sreg = m_sreg;
+	bool		dir = m_dir, will_ack = m_will_ack,
+			last_byte = m_last_byte, scl = m_scl, sda = m_sda;
+	const bool	tready = m_ckedge && (m_state == I2CISS_IDLE_STOPPED
+					|| m_state == I2CISS_IDLE_ACTIVE);
+	const unsigned	cmd = (m_insn >> 8) & 0x07, tdata = m_insn & 0x0ff;
+
+	if (!m_ckedge)
+		return;
+
+	switch(m_state) {
+	case I2CISS_IDLE_STOPPED:
+	case I2CISS_IDLE_ACTIVE:
+		nbits = 0;
+		will_ack  = true;
+		last_byte = false;
+		sreg = tdata;
+		dir  = D_RD;
+		if (m_state == I2CISS_IDLE_ACTIVE)
+			scl = sda = false;
+		if (!tvalid || !tready || cmd == I2CISS_NOOP)
+			break;
+
+		if (cmd == I2CISS_START) {
+			if (m_state == I2CISS_IDLE_STOPPED) {
+				sda = false; scl = true;
+				state = I2CISS_BUS_START;
+			} else {
+				scl = false; sda = true;
+				state = I2CISS_REPEAT_START;
+			}
+		} else if (cmd == I2CISS_STOP) {
+			// We are already stopped, if idle and stopped
+			if (m_state == I2CISS_IDLE_ACTIVE) {
+				scl = true; sda = false;
+				state = I2CISS_BUS_STOP;
+			}
+		} else {
+			// SEND or RX*, with a START first if need be
+			nbits = 7;
+			if (cmd == I2CISS_SEND)
+				dir = D_WR;
+			if (cmd == I2CISS_RXN || cmd == I2CISS_RXLN)
+				will_ack = false;
+			if (cmd == I2CISS_RXLK || cmd == I2CISS_RXLN)
+				last_byte = true;
+			if (m_state == I2CISS_IDLE_STOPPED) {
+				sda = false; scl = true;
+				state = I2CISS_BUS_START;
+			} else {
+				sda = false; scl = false;
+				state = I2CISS_DATA;
+			}
+		} break;
+	case I2CISS_BUS_START:
+		state = (nbits & 4) ? I2CISS_DATA : I2CISS_IDLE_ACTIVE;
+		scl = sda = false;
+		break;
+	case I2CISS_BUS_STOP:
+		scl = true;
+		if (m_ck_scl) {
+			state = I2CISS_IDLE_STOPPED;
+			sda = true;
+		} break;
+	case I2CISS_REPEAT_START:
+		if (stretch)
+			break;
+		scl = sda = true;
+		state = I2CISS_REPEAT_START2;
+		if (m_sda != m_ck_sda)
+			state = I2CISS_BUS_ABORT;
+		break;
+	case I2CISS_REPEAT_START2:
+		if (stretch)
+			break;
+		scl = true; sda = false;
+		state = I2CISS_BUS_START;
+		if (!m_ck_sda || !m_ck_scl) {
+			scl = sda = true;
+			state = I2CISS_BUS_ABORT;
+		} break;
+	case I2CISS_DATA:
+		scl = false;
+		sda = (m_sreg & 0x80) || (m_dir == D_RD);
+		if (m_sda == sda && !m_ck_scl)
+			state = I2CISS_CLOCK;
+		break;
+	case I2CISS_CLOCK:
+		if (m_ck_scl) {
+			scl = false;
+			sreg = ((m_sreg << 1) | (m_ck_sda ? 1:0)) & 0x0ff;
+			if (m_nbits > 0)
+				nbits = m_nbits - 1;
+
+			if (m_dir == D_WR && m_ck_sda != ((m_sreg & 0x80) != 0)) {
+				state = I2CISS_BUS_ABORT;
+				scl = sda = true;
+			} else if (m_nbits == 0)
+				state = I2CISS_ACK;
+			else
+				state = I2CISS_DATA;
+		} else
+			scl = true;
+		break;
+	case I2CISS_ACK:
+		scl = false;
+		sda = (m_dir == D_WR) || !m_will_ack;
+		if (!m_ck_scl && (m_dir == D_WR || m_sda != m_will_ack))
+			state = I2CISS_CKACKLO;
+		break;
+	case I2CISS_CKACKLO:
+		scl = true;
+		sda = (m_dir == D_WR) || !m_will_ack;
+		state = I2CISS_CKACKHI;
+		break;
+	case I2CISS_CKACKHI:
+		scl = true;
+		if (m_ck_scl) {
+			scl = sda = false;
+			if (m_dir == D_WR && m_ck_sda)
+				state = I2CISS_RXNAK;
+			else
+				state = I2CISS_IDLE_ACTIVE;
+		} break;
+	case I2CISS_RXNAK:
+		// A NAK'd write: send a STOP, and return to idle
+		scl = sda = false;
+		if (!m_ck_scl && !m_ck_sda) {
+			scl = true;
+			state = I2CISS_BUS_STOP;
+		} break;
+	default:
+		// A collision.  Wait for the bus to go idle.  (The watchdog,
+		// OPT_WATCHDOG, isn't modeled.)
+		scl = sda = true;
+		if (!m_channel_busy && m_ck_scl && m_ck_sda)
+			state = I2CISS_IDLE_STOPPED;
+		break;
+	}
+
+	m_state = state;
+	m_nbits = nbits;
+	m_sreg  = sreg;
+	m_dir   = dir;
+	m_will_ack  = will_ack;
+	m_last_byte = last_byte;
+	m_scl = scl;
+	m_sda = sda;
+}
+// }}}
+
+unsigned long	I2CISS::clock(bool sync) {
+	// {{{
+	I2CBUS		drv(m_o_scl, m_o_sda), ib;
+	const unsigned	op = (m_insn >> 8) & 0x0f;
+	const bool	idle = (m_state == I2CISS_IDLE_STOPPED
+					|| m_state == I2CISS_IDLE_ACTIVE);
+	bool		tvalid, i2c_ready, tready, stretch, issued,
+			axis_ready, ptvalid, ptlast, abort, wait,
+			stop_bit, busy;
+	unsigned	ptdata, ptid;
+	unsigned long	nticks;
+
+	if (m_fast_forward && !m_halted && (nticks = idle_ticks()) > 0) {
+		skip_ticks(nticks);
+		return nticks;
+	}
+
+	// The I2C bus, as the CPU's (registered) outputs drive it
+	// {{{
+	ib = m_i2c(drv);
+	if (m_mon)
+		(*m_mon)(drv, ib);
+	if (ib.m_scl) {
+		if (!ib.m_sda && m_last_bus.m_sda)
+			m_i2c_active = true;
+		else if (ib.m_sda && !m_last_bus.m_sda)
+			m_i2c_active = false;
+	}
+	if (m_i2c_active)
+		m_i2c_busy++;
+	m_last_bus = ib;
+	m_last_drv = drv;
+	// }}}
+
+	// The CPU's handshake with the I2C engine
+	// {{{
+	tvalid    = m_insn_valid && !(op & 8) && !m_wait;
+	i2c_ready = m_ckedge && idle;
+	tready    = (i2c_ready || (op & 8)) && !m_wait;
+	stretch   = (m_scl && !m_ck_scl) || (!tvalid && idle);
+	issued    = m_insn_valid && tready && !m_halted;
+	// }}}
+
+	// The outgoing stream, its channel ID, and the abort
+	// {{{
+	axis_ready = m_sink.tready();
+	ptvalid = m_tvalid; ptdata = m_tdata; ptlast = m_tlast; ptid = m_tid;
+
+	if (!ptvalid || axis_ready) {
+		m_tdata = m_sreg;
+		m_tlast = m_last_byte;
+
+		// A new channel applies at once, unless a packet is under way
+		if (issued && op == I2CISS_CHANNEL && !m_mid_pkt)
+			m_tid = m_insn & TIDMASK;
+		else if (ptvalid && axis_ready && ptlast)
+			m_tid = m_channel;
+		else if (!m_mid_pkt)
+			m_tid = m_channel;
+	}
+
+	if (tvalid && i2c_ready && (op & 0x0c) == 0x04)
+		m_mid_pkt = true;
+	else if (ptvalid && axis_ready)
+		m_mid_pkt = !ptlast;
+
+	if (m_ckedge && !stretch && m_state == I2CISS_CKACKHI && m_dir == D_RD)
+		m_tvalid = true;
+	else if (axis_ready)
+		m_tvalid = false;
+
+	abort = false;
+	if (m_ckedge && (!stretch || i2c_ready)) {
+		if (m_ck_scl && m_dir == D_WR && m_state == I2CISS_CKACKHI
+				&& m_ck_sda)
+			abort = true;
+		if (m_ck_scl && m_dir == D_WR && m_state == I2CISS_CLOCK
+				&& m_ck_sda != ((m_sreg & 0x80) != 0))
+			abort = true;
+		if (m_state == I2CISS_REPEAT_START && !stretch
+				&& m_sda != m_ck_sda)
+			abort = true;
+		if (m_state == I2CISS_REPEAT_START2 && !stretch
+				&& (!m_ck_scl || !m_ck_sda))
+			abort = true;
+	}
+	// }}}
+
+	// The I2C engine, and its registered outputs
+	// {{{
+	m_o_scl = m_scl;
+	m_o_sda = m_sda;
+	engine(tvalid, stretch);
+	// }}}
+
+	// The clock divider
+	// {{{
+	if (!m_ckedge || !stretch) {
+		if (m_ckedge)
+			m_ckedge = (m_ckcount == 0);
+		else
+			m_ckedge = (m_ckdiv <= 1);
+		m_ckdiv = (m_ckdiv > 0) ? m_ckdiv - 1 : m_ckcount;
+	}
+	// }}}
+
+	// Synchronizers, and whether the bus is busy
+	// {{{
+	stop_bit = m_ck_scl && m_lst_scl && m_ck_sda && !m_lst_sda;
+	busy = m_channel_busy;
+	if (!m_ck_scl || !m_ck_sda)
+		busy = true;
+	else if (m_stop_bit)
+		busy = false;
+	m_stop_bit = stop_bit;
+	m_channel_busy = busy;
+
+	m_lst_scl = m_ck_scl; m_ck_scl = m_q_scl; m_q_scl = ib.m_scl;
+	m_lst_sda = m_ck_sda; m_ck_sda = m_q_sda; m_q_sda = ib.m_sda;
+	// }}}
+
+	// The CPU
+	// {{{
+	wait = m_wait;
+	if (sync)
+		wait = false;
+	else if (m_insn_valid && op == I2CISS_WAIT)
+		wait = true;
+
+	if (issued)
+		execute(m_insn, sync);
+
+	if (m_abort) {
+		m_aborts++;
+		m_insn_valid = m_half_valid = false;
+		m_pc = m_abort_address;
+		m_fetch_wait = m_fetch_latency;
+	} else if (!m_halted) {
+		if (issued)
+			m_insn_valid = false;
+		if (!m_insn_valid && !m_wait) {
+			if (!m_half_valid && m_fetch_wait > 0)
+				m_fetch_wait--;
+			else
+				fetch();
+		}
+	}
+	m_wait  = wait;
+	m_abort = abort;
+	// }}}
+
+	m_sink.clock(ptvalid, ptdata, ptlast, ptid);
+	m_tick++;
+	return 1;
+}
+// }}}
+
+// Fast-forward
+// {{{
+// Between I2C clock edges, an I2C instruction waiting on the engine does no
+// more than wait on the divider for its next edge.  Once the bus has settled
+// through the synchronizers, and the stream has nothing to send, nothing
+// else changes until the divider runs out.  Stop one clock short of that,
+// so the clock that raises the edge is simulated.
+unsigned long	I2CISS::idle_ticks(void) {
+	unsigned long	nticks;
+	bool		busy;
+
+	if (!m_insn_valid || (m_insn & 0x0800) || m_wait || m_halted)
+		return 0;
+	if (m_ckedge || m_ckdiv < 2 || m_abort || m_tvalid)
+		return 0;
+	if (m_tdata != m_sreg || m_tlast != m_last_byte
+			|| (!m_mid_pkt && m_tid != m_channel))
+		return 0;
+
+	// The outputs, and the bus through the synchronizers
+	if (m_o_scl != m_scl || m_o_sda != m_sda
+			|| m_o_scl != m_last_drv.m_scl
+			|| m_o_sda != m_last_drv.m_sda)
+		return 0;
+	if (m_q_scl != m_last_bus.m_scl || m_ck_scl != m_q_scl
+			|| m_lst_scl != m_ck_scl
+			|| m_q_sda != m_last_bus.m_sda || m_ck_sda != m_q_sda
+			|| m_lst_sda != m_ck_sda || m_stop_bit)
+		return 0;
+	busy = m_channel_busy || !m_ck_scl || !m_ck_sda;
+	if (busy != m_channel_busy)
+		return 0;
+
+	nticks = m_ckdiv - 1;
+	if (nticks > m_i2c.idle_ticks())
+		nticks = m_i2c.idle_ticks();
+	return nticks;
+}
+
+void	I2CISS::skip_ticks(unsigned long nticks) {
+	I2CBUS	ib;
+
+	m_ckdiv -= nticks;
+
+	ib = m_i2c.skip(nticks);
+	assert(ib.m_scl == m_last_bus.m_scl && ib.m_sda == m_last_bus.m_sda);
+	if (m_i2c_active)
+		m_i2c_busy += nticks;
+
+	// The cheaper models are stepped, clock by clock, to keep their
+	// counters and random streams exactly where they'd be
+	for(unsigned long k=0; k<nticks; k++) {
+		if (m_mon)
+			(*m_mon)(m_last_drv, m_last_bus);
+		m_sink.clock(false, 0, false, 0);
+	}
+
+	m_tick    += nticks;
+	m_skipped += nticks;
+}
+// }}}
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2ciss.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A native instruction set simulator for the I2C CPU, wbi2ccpu.
+//		It runs i2casm scripts, nibble by nibble, with the same
+//	instruction sequencing as the RTL--including the way TARGET, ABORT,
+//	and JUMP only take effect from the high nibble of a byte--and drives
+//	an I2CSIMBUS of slave models through a clock by clock model of the
+//	axisi2c engine behind it.  The clocks between I2C clock edges, which
+//	the CPU spends doing nothing but counting down its divider, are
+//	jumped over rather than simulated.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CISS_H
+#define	I2CISS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "tbmem.h"
+#include "i2csim.h"
+#include "i2cmonitor.h"
+#include "axissink.h"
+
+// The instruction set, as i2casm assembles it
+#define	I2CISS_NOOP	0x0
+#define	I2CISS_START	0x1
+#define	I2CISS_STOP	0x2
+#define	I2CISS_SEND	0x3
+#define	I2CISS_RXK	0x4
+#define	I2CISS_RXN	0x5
+#define	I2CISS_RXLK	0x6
+#define	I2CISS_RXLN	0x7
+#define	I2CISS_WAIT	0x8
+#define	I2CISS_HALT	0x9
+#define	I2CISS_ABORT	0xa
+#define	I2CISS_TARGET	0xb
+#define	I2CISS_JUMP	0xc
+#define	I2CISS_CHANNEL	0xd
+
+// The states of the I2C engine, as in axisi2c
+typedef	enum { I2CISS_IDLE_STOPPED=0, I2CISS_BUS_START, I2CISS_IDLE_ACTIVE,
+	I2CISS_BUS_STOP, I2CISS_DATA, I2CISS_CLOCK, I2CISS_ACK,
+	I2CISS_CKACKLO, I2CISS_CKACKHI, I2CISS_RXNAK, I2CISS_BUS_ABORT,
+	I2CISS_REPEAT_START, I2CISS_REPEAT_START2
+} I2CISSSTATE;
+
+// One instruction, as issued.  m_insn is laid out as the CPU's own insn
+// register, and so as bits [11:0] of its o_debug output: the opcode in bits
+// [11:8], and any immediate (for SEND and CHANNEL) in bits [7:0].
+typedef	struct {
+	unsigned	m_addr;		// The byte the opcode came from
+	unsigned	m_insn;
+} I2CISSINSN;
+
+class	I2CISS {
+	TBMEM		m_mem;
+	I2CSIMBUS	m_i2c;
+	I2CMONITOR	*m_mon;
+	AXISSINK	m_sink;
+	FILE		*m_trace;
+
+	// The decoder: the instruction register, any half of a byte yet to
+	// be issued, and the addresses the script has set up
+	// {{{
+	unsigned	m_pc, m_jump_target, m_abort_address, m_insn,
+			m_insn_addr, m_half, m_channel;
+	bool		m_insn_valid, m_half_valid, m_halted, m_wait;
+	unsigned	m_fetch_latency, m_fetch_wait;
+	// }}}
+
+	// The I2C engine, its clock divider, and its synchronizers
+	// {{{
+	I2CISSSTATE	m_state;
+	unsigned	m_nbits, m_sreg, m_ckcount, m_ckdiv;
+	bool		m_dir, m_will_ack, m_last_byte, m_scl, m_sda,
+			m_o_scl, m_o_sda, m_abort, m_ckedge,
+			m_q_scl, m_q_sda, m_ck_scl, m_ck_sda,
+			m_lst_scl, m_lst_sda, m_stop_bit, m_channel_busy;
+	// }}}
+
+	// The outgoing stream
+	// {{{
+	bool		m_tvalid, m_tlast, m_mid_pkt;
+	unsigned	m_tdata, m_tid;
+	// }}}
+
+	// Statistics
+	// {{{
+	unsigned long	m_tick, m_insns, m_rx_insns, m_aborts, m_i2c_busy,
+			m_skipped;
+	bool		m_i2c_active, m_fast_forward;
+	I2CBUS		m_last_bus, m_last_drv;
+	// }}}
+
+	// Load the instruction register, from the half of a byte waiting to
+	// be issued or else from the next byte of the script
+	void	fetch(void);
+
+	// Carry out an issued instruction's effects on the CPU itself
+	void	execute(unsigned insn, bool sync);
+
+	// One clock of the I2C engine
+	void	engine(bool tvalid, bool stretch);
+
+	// The clocks that may be jumped over, while the next instruction
+	// waits on the clock divider and nothing else can change
+	unsigned long	idle_ticks(void);
+	void		skip_ticks(unsigned long nticks);
+
+public:
+	I2CISS(const int lgmemsz = 16);
+	~I2CISS(void);
+
+	// Load an i2casm script, in either the binary or hex output format,
+	// into memory at the byte address given.  Returns the number of bytes
+	// loaded.
+	unsigned	load(const char *fname, unsigned addr) {
+		return m_mem.load(fname, addr);
+	}
+
+	unsigned char	&operator[](unsigned addr) { return m_mem[addr]; }
+
+	// The slaves, the stream sink, and (optionally) a bus log, as in
+	// wbi2ccpu_tb
+	I2CSIMBUS	&i2cbus(void) { return m_i2c; }
+	AXISSINK	&sink(void) { return m_sink; }
+	void		monitor(const char *fname);
+
+	// Log every instruction issued to the given file, with the clock it
+	// was issued on
+	void		trace(const char *fname);
+
+	// The clock divider, as the CPU's ADR_CKCOUNT register.  One I2C
+	// clock edge takes place every ckcount+1 clocks.
+	void		ckcount(unsigned ckcount) { m_ckcount = ckcount & 0x0fff; }
+
+	// The clocks it takes to fetch the first instruction, following a
+	// jump or an abort.  Instructions are otherwise taken to be fetched
+	// as fast as they can be issued.  Defaults to zero.
+	void		fetch_latency(unsigned clocks) { m_fetch_latency = clocks; }
+
+	// Jump over the clocks spent waiting on the divider (the default),
+	// or simulate every one of them
+	void		fast_forward(bool ff) { m_fast_forward = ff; }
+
+	// Start the script running from the given address, as writing it to
+	// the CPU's ADR_ADDRESS register would
+	void		jump(unsigned addr);
+
+	// Lockstep interface
+	// {{{
+	// Without any clock, the decoder alone may follow another CPU's
+	// instruction stream.  issue() returns the next instruction the
+	// CPU should issue, and carries it out.  If refill is false, as on
+	// the clock the CPU aborts, the instruction register is left empty
+	// afterwards.  abort() then follows an I2C abort to the script's
+	// abort address.  Returns false if the script has halted.
+	bool		issue(I2CISSINSN &in, bool refill = true);
+	void		abort(void);
+	// }}}
+
+	// Advance the whole CPU by one clock, with the given sync input, or
+	// by however many clocks may be jumped over.  Returns the clocks
+	// taken.
+	unsigned long	clock(bool sync = true);
+
+	bool		halted(void) const { return m_halted; }
+	unsigned	pc(void) const { return m_pc; }
+	// The address of the last instruction issued
+	unsigned	insn_addr(void) const { return m_insn_addr; }
+
+	unsigned long	tickcount(void) const { return m_tick; }
+	unsigned long	insns(void) const { return m_insns; }
+	unsigned long	rx_insns(void) const { return m_rx_insns; }
+	unsigned long	aborts(void) const { return m_aborts; }
+	unsigned long	i2c_busy(void) const { return m_i2c_busy; }
+	unsigned long	skipped(void) const { return m_skipped; }
+	unsigned long	stream_bytes(void) const { return m_sink.beats(); }
+
+	// The bytes RX instructions received that never made it into the
+	// stream, as wbi2ccpu_tb counts them
+	unsigned long	stream_lost(void) const {
+		unsigned long	got = m_sink.beats() + (m_tvalid ? 1:0);
+
+		return (m_rx_insns > got) ? m_rx_insns - got : 0;
+	}
+
+	// The name of an opcode, as i2casm spells it
+	static const char	*mnemonic(unsigned op);
+
+	// Write an instruction, as the trace does, to fp
+	static void	dump(FILE *fp, const I2CISSINSN &in);
+};
+
+#endif
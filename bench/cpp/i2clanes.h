@@ -0,0 +1,502 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2clanes.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Up to 64 independent copies of the I2CSIMSLAVE model, each on its
+//		own bus, advanced together one tick per call.  The model is
+//	bit-sliced: lane k's value of any one bit signal is bit k of a 64-bit
+//	word, and multi-bit values (counters, addresses, and shift registers)
+//	are held as one such word per bit.  Each tick is then a few hundred
+//	logical operations on words, shared by every lane, with no branches on
+//	any one lane's state.  The buses themselves are given the same way, so
+//	a wired-AND across every lane is a single AND.  The rare events that
+//	touch a lane's memory (a byte received, or one about to be sent) are
+//	handled afterwards, one lane at a time.
+//	
+//	Each lane follows the same states, drives the same bus, and fills
+//	its memory in the same way that an I2CSIMSLAVE does when evaluated
+//	every tick (event_driven(false)), in bit level mode, and with its
+//	protocol() set to I2CSIM_WARN or I2CSIM_IGNORE.  Protocol errors are
+//	counted, and abandon the transaction, but are never reported.  The
+//	timing profile checks aren't made at all.  Only the default device
+//	behavior is modeled: every device word to our address is ACKd.
+//	
+//	i2csim_lanes checks this model against I2CSIMSLAVE, lane by lane.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CLANES_H
+#define	I2CLANES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "i2csim.h"
+
+// I2CLANEBUS
+// {{{
+// Up to 64 independent buses, one per bit
+class	I2CLANEBUS {
+public:
+	uint64_t	m_scl, m_sda;
+	I2CLANEBUS(uint64_t scl = ~0ul, uint64_t sda = ~0ul)
+		: m_scl(scl), m_sda(sda) {}
+	I2CLANEBUS	operator+(const I2CLANEBUS b) const {
+		return I2CLANEBUS(m_scl & b.m_scl, m_sda & b.m_sda); }
+	I2CLANEBUS	operator+=(const I2CLANEBUS b) {
+		m_scl &= b.m_scl; m_sda &= b.m_sda;
+		return *this;
+	}
+
+	I2CBUS	lane(int k) const {
+		return I2CBUS((m_scl >> k)&1, (m_sda >> k)&1);
+	}
+
+	void	lane(int k, const I2CBUS b) {
+		m_scl = (m_scl & ~(1ul << k)) | ((uint64_t)b.m_scl << k);
+		m_sda = (m_sda & ~(1ul << k)) | ((uint64_t)b.m_sda << k);
+	}
+};
+// }}}
+
+// Bits per bit-sliced value
+#define	I2CLANE_STBITS	4	// State, an I2CSTATE
+#define	I2CLANE_ADRBITS	16	// Address shift register
+#define	I2CLANE_ABITS	5	// Address bits received, 0-16
+#define	I2CLANE_DBITS	4	// Data bits received or sent, 0-8
+#define	I2CLANE_CTRBITS	16	// Stretch and hold counters, which saturate
+
+template <int N>	class	I2CSIMLANES {
+	static_assert((N > 0)&&(N <= 64), "I2CSIMLANES supports 1-64 lanes");
+
+	// Bit-sliced state
+	// {{{
+	uint64_t	m_state[I2CLANE_STBITS], m_addr[I2CLANE_ADRBITS],
+			m_abits[I2CLANE_ABITS], m_dbits[I2CLANE_DBITS],
+			m_dreg[8], m_counter[I2CLANE_CTRBITS],
+			m_stretch[I2CLANE_CTRBITS], m_hold[I2CLANE_CTRBITS],
+			m_devaddr[7];
+	uint64_t	m_ack, m_rd, m_last_scl, m_last_sda, m_bus_scl,
+			m_bus_sda;
+	// }}}
+
+	// Per lane state, only needed when accessing memory
+	int		m_daddr[N];
+	unsigned long	m_protocol_errs[N];
+
+	char		*m_data;
+	int		m_nbits, m_adrmsk, m_abytes;
+	unsigned long	m_tick;
+
+	// Bit-sliced arithmetic
+	// {{{
+	// Each acts upon every lane at once.  p is an array of n words, the
+	// first holding the LSB of every lane.
+
+	// The lanes where p == v
+	static	uint64_t	eq(const uint64_t *p, int n, unsigned v) {
+		uint64_t	r = ~0ul;
+
+		for(int i=0; i<n; i++)
+			r &= ((v >> i)&1) ? p[i] : ~p[i];
+		return r;
+	}
+
+	// The lanes where a < b, both unsigned
+	static	uint64_t	lt(const uint64_t *a, const uint64_t *b, int n) {
+		uint64_t	r = 0, same = ~0ul;
+
+		for(int i=n-1; i>=0; i--) {
+			r    |= same & ~a[i] & b[i];
+			same &= ~(a[i] ^ b[i]);
+		}
+		return r;
+	}
+
+	// Add one to p in the lanes of m, saturating at all ones
+	static	void	inc(uint64_t *p, int n, uint64_t m) {
+		uint64_t	full = ~0ul;
+
+		for(int i=0; i<n; i++)
+			full &= p[i];
+		m &= ~full;
+		for(int i=0; i<n && m; i++) {
+			uint64_t	c = p[i] & m;
+
+			p[i] ^= m;
+			m = c;
+		}
+	}
+
+	static	void	clear(uint64_t *p, int n, uint64_t m) {
+		for(int i=0; i<n; i++)
+			p[i] &= ~m;
+	}
+
+	// Shift b into the bottom of p, in the lanes of m
+	static	void	shift(uint64_t *p, int n, uint64_t m, uint64_t b) {
+		for(int i=n-1; i>0; i--)
+			p[i] ^= (p[i] ^ p[i-1]) & m;
+		p[0] ^= (p[0] ^ b) & m;
+	}
+
+	// Set p to the constant v, in the lanes of m
+	static	void	set(uint64_t *p, int n, uint64_t m, unsigned v) {
+		for(int i=0; i<n; i++)
+			p[i] = ((v >> i)&1) ? (p[i] | m) : (p[i] & ~m);
+	}
+
+	// Get or set the value of one lane
+	static	unsigned	lane(const uint64_t *p, int n, int k) {
+		unsigned	v = 0;
+
+		for(int i=0; i<n; i++)
+			v |= ((p[i] >> k)&1) << i;
+		return v;
+	}
+
+	static	void	lane(uint64_t *p, int n, int k, unsigned v) {
+		for(int i=0; i<n; i++)
+			p[i] = (p[i] & ~(1ul << k)) | ((uint64_t)((v >> i)&1) << k);
+	}
+	// }}}
+
+	// The lanes having received every address byte, abits >= 8*m_abytes
+	uint64_t	abits_done(void) const {
+		// As 8*m_abytes is a power of two, this is any bit at or above
+		// it being set
+		uint64_t	r = 0;
+
+		for(int i=0; i<I2CLANE_ABITS; i++)
+			if ((1<<i) >= 8*m_abytes)
+				r |= m_abits[i];
+		return r;
+	}
+public:
+	I2CSIMLANES(const int ADDRESS = 0x050, const int nbits = 7)
+			: m_nbits(nbits), m_adrmsk((1<<nbits)-1), m_abytes(1),
+			m_tick(0) {
+		m_data = new char[N << nbits];
+		memset(m_data, 0, N << nbits);
+
+		memset(m_state, 0, sizeof(m_state));	// I2CIDLE
+		memset(m_addr,  0, sizeof(m_addr));
+		memset(m_abits, 0, sizeof(m_abits));
+		memset(m_dbits, 0, sizeof(m_dbits));
+		memset(m_dreg,  0, sizeof(m_dreg));
+		memset(m_counter, 0, sizeof(m_counter));
+		m_ack = ~0ul;
+		m_rd  = 0;
+		m_last_scl = m_last_sda = ~0ul;
+		m_bus_scl  = m_bus_sda  = ~0ul;
+
+		for(int k=0; k<N; k++) {
+			address(k, ADDRESS);
+			timing(k, I2CSIMTIMING());
+			m_daddr[k] = 0;
+			m_protocol_errs[k] = 0;
+		}
+	}
+
+	~I2CSIMLANES(void) {
+		delete[] m_data;
+	}
+
+	int	lanes(void) const { return N; }
+
+	// Advance every lane by one tick, given what everyone else is
+	// driving onto each lane's bus.  Returns the resolved buses.
+	I2CLANEBUS	operator()(const I2CLANEBUS in);
+
+	// Per lane configuration
+	// {{{
+	int	address(int k) const { return lane(m_devaddr, 7, k); }
+	void	address(int k, int devaddr) { lane(m_devaddr, 7, k, devaddr); }
+
+	// Ticks to stretch SCL at every ACK, and to hold SDA after SCL falls,
+	// as in I2CSIMTIMING.  The counters saturate, so these must be less
+	// than 2^I2CLANE_CTRBITS-1 for every lane to match I2CSIMSLAVE.
+	void	stretch(int k, int ticks) {
+		assert(ticks >= 0 && ticks < (1<<I2CLANE_CTRBITS)-1);
+		lane(m_stretch, I2CLANE_CTRBITS, k, ticks);
+	}
+
+	void	hold(int k, int ticks) {
+		assert(ticks >= 0 && ticks < (1<<I2CLANE_CTRBITS)-1);
+		lane(m_hold, I2CLANE_CTRBITS, k, ticks);
+	}
+
+	void	timing(int k, const I2CSIMTIMING &t) {
+		stretch(k, t.m_stretch);
+		hold(k, t.m_hold);
+	}
+	// }}}
+
+	// The number of register address bytes on a write, for every lane
+	int	address_bytes(void) const { return m_abytes; }
+	void	address_bytes(int n) { assert(n >= 1 && n <= 2); m_abytes = n; }
+
+	// Lane k's memory, of (1<<nbits) bytes
+	char	*memory(int k) { return &m_data[k << m_nbits]; }
+	const char *memory(int k) const { return &m_data[k << m_nbits]; }
+
+	unsigned	vstate(int k) const {
+		return lane(m_state, I2CLANE_STBITS, k); }
+	I2CBUS	bus(int k) const {
+		return I2CBUS((m_last_scl >> k)&1, (m_last_sda >> k)&1); }
+	unsigned long	protocol_errors(int k) const { return m_protocol_errs[k]; }
+	unsigned long	tickcount(void) const { return m_tick; }
+};
+
+template <int N> I2CLANEBUS	I2CSIMLANES<N>::operator()(const I2CLANEBUS in) {
+	// {{{
+	const uint64_t	scl = in.m_scl, sda = in.m_sda,
+			lscl = m_last_scl, lsda = m_last_sda,
+			rise  = scl & ~lscl,
+			fall  = ~scl & lscl,
+			shigh = scl & (sda ^ lsda),
+			// A STOP overrides everything else, so every other
+			// lane is live
+			stop = scl & m_bus_scl & lscl & sda & m_bus_sda & ~lsda,
+			live = ~stop,
+			ctr0 = eq(m_counter, I2CLANE_CTRBITS, 0),
+			dbits7 = eq(m_dbits, I2CLANE_DBITS, 7);
+	uint64_t	nst[I2CLANE_STBITS], bscl = ~0ul, bsda = ~0ul,
+			viol = 0, ctrclr = 0, rdop = 0, wrop = 0, daop = 0;
+
+	// Every condition below is restricted, through these, to the lanes in
+	// the state it applies to.  The order of the tests, and of any
+	// changes, follows that of I2CSIMSLAVE::operator().
+	const uint64_t	is_idle = live & eq(m_state, I2CLANE_STBITS, I2CIDLE),
+			is_dev  = live & eq(m_state, I2CLANE_STBITS, I2CDEVADDR),
+			is_dack = live & eq(m_state, I2CLANE_STBITS, I2CDEVACK),
+			is_adr  = live & eq(m_state, I2CLANE_STBITS, I2CADDR),
+			is_sack = live & eq(m_state, I2CLANE_STBITS, I2CSACK),
+			is_srx  = live & eq(m_state, I2CLANE_STBITS, I2CSRX),
+			is_stx  = live & eq(m_state, I2CLANE_STBITS, I2CSTX),
+			is_mack = live & eq(m_state, I2CLANE_STBITS, I2CMACK);
+
+	memcpy(nst, m_state, sizeof(nst));
+
+	// I2CIDLE
+	// {{{
+	{
+		const uint64_t	go = is_idle & scl & ~sda;
+
+		viol |= is_idle & ~scl;
+		set(nst, I2CLANE_STBITS, go, I2CDEVADDR);
+		clear(m_addr,  I2CLANE_ADRBITS, go);
+		clear(m_abits, I2CLANE_ABITS, go);
+		clear(m_dbits, I2CLANE_DBITS, go);
+		m_ack |= go;
+	}
+	// }}}
+
+	// I2CDEVADDR, and I2CADDR
+	// {{{
+	{
+		const uint64_t	is_da = is_dev | is_adr, shifting = is_da & rise;
+		uint64_t	adone, abyte, dev_done, dev_ours;
+
+		viol |= is_da & ~rise & shigh;
+		shift(m_addr, I2CLANE_ADRBITS, shifting, sda);
+		inc(m_abits, I2CLANE_ABITS, shifting);
+		ctrclr |= shifting;
+
+		// The device word is complete
+		dev_done = is_dev & rise & eq(m_abits, I2CLANE_ABITS, 8);
+		dev_ours = dev_done;
+		for(int i=0; i<7; i++)
+			dev_ours &= ~(m_addr[i+1] ^ m_devaddr[i]);
+		clear(&m_addr[8], I2CLANE_ADRBITS-8, dev_done);
+		set(nst, I2CLANE_STBITS, dev_done, I2CLOSTBUS);
+		set(nst, I2CLANE_STBITS, dev_ours, I2CDEVACK);
+		m_ack &= ~dev_ours;
+		m_rd  ^= (m_rd ^ m_addr[0]) & dev_ours;
+
+		// An address byte is complete, and possibly the address
+		adone = is_adr & rise & abits_done();
+		abyte = is_adr & rise & ~adone & eq(m_abits, 3, 0);
+		set(nst, I2CLANE_STBITS, adone | abyte, I2CSACK);
+		daop  |= adone;
+		m_ack &= ~(adone | abyte);
+	}
+	// }}}
+
+	// I2CDEVACK, and I2CSACK
+	// {{{
+	{
+		const uint64_t	is_ack  = is_dack | is_sack,
+				acking  = is_ack & ~(ctr0 & scl),
+				ackviol = acking & scl & ~sda,
+				ackrun  = acking & ~ackviol,
+				stretching = ackrun
+					& lt(m_counter, m_stretch, I2CLANE_CTRBITS)
+					& (is_sack | ~m_ack),
+				ackdone = ackrun & ~stretching & ~ctr0 & fall;
+		const uint64_t	more = ~abits_done();
+		uint64_t	dack_nak, dack_rd, dack_wr, sack_adr, sack_rx;
+
+		viol |= ackviol;
+		bsda  = (bsda & ~acking) | (m_ack & acking);
+		inc(m_counter, I2CLANE_CTRBITS, ackrun);
+		bscl &= ~stretching;
+		clear(m_dbits, I2CLANE_DBITS, is_ack & ~ackviol);
+
+		dack_nak = is_dack & ackdone &  m_ack;
+		dack_rd  = is_dack & ackdone & ~m_ack &  m_rd;
+		dack_wr  = is_dack & ackdone & ~m_ack & ~m_rd;
+		sack_adr = is_sack & ackdone &  more;
+		sack_rx  = is_sack & ackdone & ~more;
+
+		set(nst, I2CLANE_STBITS, dack_nak, I2CLOSTBUS);
+		set(nst, I2CLANE_STBITS, dack_rd, I2CSTX);
+		ctrclr |= dack_rd;
+		rdop   |= dack_rd;
+		set(nst, I2CLANE_STBITS, dack_wr | sack_adr, I2CADDR);
+		clear(m_abits, I2CLANE_ABITS, dack_wr);
+		clear(m_addr, I2CLANE_ADRBITS, dack_wr);
+		set(nst, I2CLANE_STBITS, sack_rx, I2CSRX);
+	}
+	// }}}
+
+	// I2CSRX
+	// {{{
+	{
+		const uint64_t	high = is_srx & scl,
+				srxviol = high & lscl & (sda ^ lsda),
+				srxbit  = high & ~lscl,
+				srxdone = srxbit & dbits7;
+
+		viol |= srxviol;
+		shift(m_dreg, 8, srxbit, sda);
+		inc(m_dbits, I2CLANE_DBITS, srxbit);
+		set(nst, I2CLANE_STBITS, srxdone, I2CSACK);
+		wrop   |= srxdone;
+		ctrclr |= high & ~srxviol;
+	}
+	// }}}
+
+	// I2CSTX
+	// {{{
+	{
+		const uint64_t	stxlow  = is_stx & ~scl & ~lscl,
+				stxfall = is_stx & fall,
+				stxdone = stxfall & dbits7;
+		uint64_t	held;
+
+		// Count out our hold time, then send the next bit.  Rather
+		// than selecting bit 7-dbits of the byte being sent, the
+		// byte is shifted one bit per bit sent.
+		inc(m_counter, I2CLANE_CTRBITS, stxlow
+				& lt(m_counter, m_hold, I2CLANE_CTRBITS));
+		held = lt(m_counter, m_hold, I2CLANE_CTRBITS);
+
+		bsda = (bsda & ~(is_stx & scl)) | (lsda & is_stx & scl);
+		bsda = (bsda & ~stxlow) | (stxlow & ((held & lsda)
+						| (~held & m_dreg[7])));
+		bsda = (bsda & ~stxfall) | (lsda & stxfall);
+		ctrclr |= stxfall;
+		inc(m_dbits, I2CLANE_DBITS, stxfall);
+		shift(m_dreg, 8, stxfall, 0);
+		set(nst, I2CLANE_STBITS, stxdone, I2CMACK);
+		clear(m_dbits, I2CLANE_DBITS, stxdone);
+	}
+	// }}}
+
+	// I2CMACK
+	// {{{
+	{
+		const uint64_t	mackack = is_mack & fall & ~sda,
+				macknak = is_mack & fall &  sda;
+
+		set(nst, I2CLANE_STBITS, mackack, I2CSTX);
+		ctrclr |= mackack;
+		rdop   |= mackack;
+		set(nst, I2CLANE_STBITS, macknak, I2CLOSTBUS);
+		clear(m_dbits, I2CLANE_DBITS, is_mack);
+	}
+	// }}}
+
+	clear(m_counter, I2CLANE_CTRBITS, ctrclr);
+
+	// A protocol violation abandons the transaction, releasing the bus
+	set(nst, I2CLANE_STBITS, viol, I2CLOSTBUS);
+	bscl |= viol;
+	bsda |= viol;
+
+	// A STOP returns us to idle
+	set(nst, I2CLANE_STBITS, stop, I2CIDLE);
+	bscl |= stop;
+	bsda |= stop;
+
+	memcpy(m_state, nst, sizeof(nst));
+	m_bus_scl  = bscl;
+	m_bus_sda  = bsda;
+	m_last_scl = scl & bscl;
+	m_last_sda = sda & bsda;
+
+	// Second pass: the rare events, one lane at a time
+	// {{{
+	for(uint64_t v = viol & ((N < 64) ? ((1ul << N)-1) : ~0ul); v;
+			v &= v-1)
+		m_protocol_errs[__builtin_ctzl(v)]++;
+
+	for(uint64_t v = (rdop | wrop | daop) & ((N < 64) ? ((1ul<<N)-1) : ~0ul);
+			v; v &= v-1) {
+		const int	k = __builtin_ctzl(v);
+		const uint64_t	b = 1ul << k;
+		char		*mem = memory(k);
+
+		if (daop & b) {
+			m_daddr[k] = lane(m_addr, I2CLANE_ADRBITS, k) & m_adrmsk;
+		} else if (wrop & b) {
+			int	a = lane(m_addr, I2CLANE_ADRBITS, k);
+
+			m_daddr[k] = a & m_adrmsk;
+			mem[m_daddr[k]] = lane(m_dreg, 8, k);
+			lane(m_addr, I2CLANE_ADRBITS, k, (a + 1) & m_adrmsk);
+		} else if (rdop & b) {
+			lane(m_dreg, 8, k, mem[m_daddr[k]] & 0x0ff);
+			m_daddr[k] = (m_daddr[k] + 1) & m_adrmsk;
+		}
+	}
+	// }}}
+
+	m_tick++;
+	return I2CLANEBUS(m_last_scl, m_last_sda);
+}
+// }}}
+
+#endif
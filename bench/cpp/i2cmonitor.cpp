@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2cmonitor.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The non-inline portions of the passive I2C bus monitor.  See
+//		i2cmonitor.h for details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "i2cmonitor.h"
+
+static	const char	*type_name[] = {
+	"START", "ADDR", "DATA", "ACK", "NAK", "STOP" };
+
+I2CMONITOR::I2CMONITOR(const int lgring) {
+	// {{{
+	assert(lgring > 0 && lgring < 32);
+	m_ring = new I2CMONREC[1ul<<lgring];
+	m_mask = (1ul<<lgring)-1;
+	m_rdptr = m_wrptr = 0;
+	m_dropped = 0;
+	m_tick = 0;
+	m_last_rec = 0;
+
+	m_stretch = 0;
+	m_nbits = 0;
+	m_byte  = 0;
+	m_active = false;
+	m_addressing = false;
+	m_binary = false;
+	m_fp = NULL;
+}
+// }}}
+
+I2CMONITOR::~I2CMONITOR(void) {
+	close();
+	delete[] m_ring;
+}
+
+void	I2CMONITOR::open(const char *fname) {
+	// {{{
+	const char	*ext = strrchr(fname, '.');
+
+	close();
+	m_binary = (ext && strcmp(ext, ".bin")==0);
+	m_fp = fopen(fname, (m_binary) ? "wb" : "w");
+	if (NULL == m_fp) {
+		fprintf(stderr, "ERR: Cannot open %s\n", fname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+}
+// }}}
+
+void	I2CMONITOR::close(void) {
+	if (m_fp) {
+		flush();
+		fclose(m_fp);
+		m_fp = NULL;
+	}
+}
+
+void	I2CMONITOR::push(I2CMONTYPE type, unsigned data) {
+	// {{{
+	I2CMONREC	*rec;
+
+	if (m_wrptr - m_rdptr > m_mask) {
+		// The ring is full.  Write it out if we can, otherwise
+		// lose the oldest record.
+		if (m_fp)
+			flush();
+		else {
+			m_rdptr++;
+			m_dropped++;
+		}
+	}
+
+	rec = &m_ring[m_wrptr & m_mask];
+	rec->m_tick    = m_tick;
+	rec->m_stretch = m_stretch;
+	rec->m_type    = type;
+	rec->m_data    = data;
+	rec->m_unused[0] = rec->m_unused[1] = 0;
+	m_wrptr++;
+
+	m_stretch = 0;
+}
+// }}}
+
+void	I2CMONITOR::operator()(const I2CBUS master, const I2CBUS bus) {
+	// {{{
+	m_tick++;
+
+	// A slave is stretching the clock if the master has released SCL,
+	// yet it remains low
+	if (m_active && master.m_scl && !bus.m_scl)
+		m_stretch++;
+
+	if (bus.m_scl && m_last.m_scl && bus.m_sda != m_last.m_sda) {
+		if (!bus.m_sda) {
+			// START, or repeated START
+			push(I2CMON_START);
+			m_active = true;
+			m_addressing = true;
+			m_nbits = 0;
+			m_byte  = 0;
+		} else if (m_active) {
+			push(I2CMON_STOP);
+			m_active = false;
+		}
+	} else if (m_active && bus.m_scl && !m_last.m_scl) {
+		// Sample SDA on the rising edge of SCL
+		if (m_nbits < 8) {
+			m_byte = ((m_byte << 1) | bus.m_sda) & 0x0ff;
+			if (++m_nbits == 8)
+				push((m_addressing) ? I2CMON_ADDR : I2CMON_DATA,
+					m_byte);
+		} else {
+			push((bus.m_sda) ? I2CMON_NAK : I2CMON_ACK);
+			m_addressing = false;
+			m_nbits = 0;
+		}
+	}
+
+	m_last = bus;
+}
+// }}}
+
+void	I2CMONITOR::write(FILE *fp, bool binary) {
+	// {{{
+	if (binary) {
+		// Write the ring out in (at most) two contiguous pieces
+		while(m_rdptr < m_wrptr) {
+			unsigned long	first = m_rdptr & m_mask,
+					ln = m_wrptr - m_rdptr;
+
+			if (first + ln > m_mask+1)
+				ln = m_mask+1 - first;
+			fwrite(&m_ring[first], sizeof(I2CMONREC), ln, fp);
+			m_rdptr += ln;
+		}
+		return;
+	}
+
+	for(; m_rdptr < m_wrptr; m_rdptr++) {
+		const I2CMONREC	*rec = &m_ring[m_rdptr & m_mask];
+
+		// Tick, ticks since the last record, and what was seen
+		fprintf(fp, "%12lu %+8ld %s", (unsigned long)rec->m_tick,
+			(long)(rec->m_tick - m_last_rec),
+			type_name[rec->m_type]);
+		if (rec->m_type == I2CMON_ADDR)
+			fprintf(fp, "  0x%02x %s", rec->m_data >> 1,
+				(rec->m_data & 1) ? "RD" : "WR");
+		else if (rec->m_type == I2CMON_DATA)
+			fprintf(fp, "  0x%02x", rec->m_data);
+		if (rec->m_stretch)
+			fprintf(fp, " (STRETCHED %u)", rec->m_stretch);
+		fprintf(fp, "\n");
+		m_last_rec = rec->m_tick;
+	}
+}
+// }}}
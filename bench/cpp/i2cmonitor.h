@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2cmonitor.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A passive I2C bus monitor.  Given the resolved bus on every tick,
+//		the monitor decodes START, address, data, ACK/NAK, and STOP
+//	conditions into a stream of records, each stamped with the tick it was
+//	seen on.  Records are kept in a preallocated ring buffer, from which
+//	they may be written out as either text or binary.
+//
+//	If the master's own outputs are also given, the monitor can tell when
+//	a slave is stretching the clock, and reports the number of stretched
+//	ticks with each record.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CMONITOR_H
+#define	I2CMONITOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "i2csim.h"
+
+// The default ring buffer size, in records.  Must be a power of two.
+#define	I2CMON_LGRING	16
+
+typedef	enum {
+	I2CMON_START=0,	// A START, or repeated START, condition
+	I2CMON_ADDR,	// The device word: address and R/W bit, following START
+	I2CMON_DATA,	// A data byte
+	I2CMON_ACK,	// The ninth bit of a byte, when low
+	I2CMON_NAK,	// The ninth bit of a byte, when high
+	I2CMON_STOP
+} I2CMONTYPE;
+
+// One record, as written to a binary log
+typedef	struct {
+	uint64_t	m_tick;		// When the event was seen
+	uint32_t	m_stretch;	// Ticks SCL was stretched since the
+					// last record
+	uint8_t		m_type;		// An I2CMONTYPE
+	uint8_t		m_data;		// The byte, for ADDR and DATA records
+	uint8_t		m_unused[2];
+} I2CMONREC;
+
+class	I2CMONITOR {
+	I2CMONREC	*m_ring;
+	unsigned long	m_rdptr, m_wrptr, m_mask, m_dropped, m_tick,
+			m_last_rec;
+	unsigned	m_stretch, m_nbits, m_byte;
+	bool		m_active, m_addressing, m_binary;
+	I2CBUS		m_last;
+	FILE		*m_fp;
+
+	void	push(I2CMONTYPE type, unsigned data = 0);
+
+public:
+	I2CMONITOR(const int lgring = I2CMON_LGRING);
+	~I2CMONITOR(void);
+
+	// Call once per tick with the resolved bus and, optionally, what the
+	// master is driving
+	void	operator()(const I2CBUS bus) { (*this)(bus, bus); }
+	void	operator()(const I2CBUS master, const I2CBUS bus);
+
+	// Write records to fname as they are decoded, as text--or in binary,
+	// as a sequence of I2CMONRECs, if the file name ends in .bin
+	void	open(const char *fname);
+	void	close(void);
+
+	// Write out (and remove) all the records in the ring buffer
+	void	write(FILE *fp, bool binary = false);
+	void	flush(void) {
+		if (m_fp) {
+			write(m_fp, m_binary);
+			fflush(m_fp);
+		}
+	}
+
+	// The number of records currently waiting in the ring buffer
+	unsigned long	size(void) const { return m_wrptr - m_rdptr; }
+	// The k'th oldest record in the ring
+	const I2CMONREC	&operator[](unsigned long k) const {
+		return m_ring[(m_rdptr + k) & m_mask];
+	}
+
+	// Records lost because the ring filled with nowhere to write them
+	unsigned long	dropped(void) const { return m_dropped; }
+
+	unsigned long	tickcount(void) const { return m_tick; }
+};
+
+#endif
@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2creplay.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Reads logic analyzer captures of an I2C bus, a chunk at a time,
+//		and plays them back one simulation tick at a time.  See
+//	i2creplay.h for the details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "i2creplay.h"
+
+I2CREPLAY::I2CREPLAY(const char *fname, double clkhz)
+		: m_maplen(0), m_mapoff(0), m_pos(0), m_map(NULL),
+		m_clkhz(clkhz), m_rate(0),
+		m_tcol(0), m_sclcol(1), m_sdacol(2),
+		m_sclbit(0), m_sdabit(1), m_unit(1),
+		m_t0(0), m_nxt_time(0), m_started(false), m_have_nxt(false),
+		m_tick(0), m_samples(0), m_lines(0) {
+	// {{{
+	struct stat	sb;
+	const char	*ext;
+
+	m_fd = open(fname, O_RDONLY);
+	if (m_fd < 0 || fstat(m_fd, &sb) != 0) {
+		fprintf(stderr, "ERR: Cannot open capture, %s\n", fname);
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+	m_fsize = sb.st_size;
+
+	ext = strrchr(fname, '.');
+	m_csv = (ext && strcasecmp(ext, ".csv") == 0);
+	assert(clkhz > 0);
+}
+// }}}
+
+I2CREPLAY::~I2CREPLAY(void) {
+	if (m_map)
+		munmap(m_map, m_maplen);
+	close(m_fd);
+}
+
+size_t	I2CREPLAY::window(size_t need) {
+	// {{{
+	size_t	pgsz = sysconf(_SC_PAGESIZE);
+
+	if (m_map && (size_t)(m_pos + need) <= m_mapoff + m_maplen)
+		return need;
+	if (m_map && m_mapoff + m_maplen >= m_fsize)
+		return m_mapoff + m_maplen - m_pos;
+
+	// Slide the window forward, so that it starts at (the page holding)
+	// our current position
+	if (m_map)
+		munmap(m_map, m_maplen);
+	m_map = NULL;
+	if ((size_t)m_pos >= m_fsize)
+		return 0;
+
+	m_mapoff = m_pos & ~(off_t)(pgsz-1);
+	m_maplen = m_fsize - m_mapoff;
+	if (m_maplen > I2CREPLAY_CHUNK)
+		m_maplen = I2CREPLAY_CHUNK;
+	m_map = (char *)mmap(NULL, m_maplen, PROT_READ, MAP_PRIVATE,
+				m_fd, m_mapoff);
+	if (m_map == MAP_FAILED) {
+		fprintf(stderr, "ERR: Cannot map capture\n");
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+	madvise(m_map, m_maplen, MADV_SEQUENTIAL);
+
+	if ((size_t)(m_pos + need) <= m_mapoff + m_maplen)
+		return need;
+	return m_mapoff + m_maplen - m_pos;
+}
+// }}}
+
+bool	I2CREPLAY::csvsample(double &t, I2CBUS &b) {
+	// {{{
+	char	line[I2CREPLAY_MAXLINE+1], *ptr, *end;
+	int	col, scl = -1, sda = -1;
+	bool	have_t = false;
+
+	do {
+		size_t	avail = window(I2CREPLAY_MAXLINE);
+		char	*src, *nl;
+		size_t	ln;
+
+		if (avail == 0)
+			return false;
+
+		src = m_map + (m_pos - m_mapoff);
+		nl  = (char *)memchr(src, '\n', avail);
+		if (nl)
+			ln = nl - src;
+		else if (avail < I2CREPLAY_MAXLINE)
+			ln = avail;	// The last line, without a newline
+		else {
+			fprintf(stderr, "ERR: Capture line %ld is too long\n",
+				m_lines+1);
+			exit(EXIT_FAILURE);
+		}
+		m_pos += ln + ((nl) ? 1 : 0);
+		m_lines++;
+
+		memcpy(line, src, ln);
+		line[ln] = '\0';
+
+		// Skip comments (sigrok starts them with a ';'), blank
+		// lines, and any header naming the columns
+		ptr = line;
+		while(isspace(*ptr))
+			ptr++;
+	} while(*ptr != '-' && *ptr != '.' && !isdigit(*ptr));
+
+	for(col=0; *ptr; col++) {
+		double	v = strtod(ptr, &end);
+
+		if (end == ptr) {
+			fprintf(stderr, "ERR: Bad capture line %ld, %s\n",
+				m_lines, line);
+			exit(EXIT_FAILURE);
+		}
+
+		if (col == m_tcol) {
+			// Pre-trigger samples may have negative times
+			t = v;
+			have_t = true;
+		}
+		if (col == m_sclcol)
+			scl = (v != 0);
+		if (col == m_sdacol)
+			sda = (v != 0);
+
+		ptr = end;
+		while(isspace(*ptr))
+			ptr++;
+		if (*ptr == ',')
+			ptr++;
+	}
+
+	if (scl < 0 || sda < 0 || (m_tcol >= 0 && !have_t)) {
+		fprintf(stderr, "ERR: Capture line %ld is missing columns\n",
+			m_lines);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!have_t)
+		t = m_samples / m_rate;
+	b = I2CBUS(scl, sda);
+	return true;
+}
+// }}}
+
+void	I2CREPLAY::bits(int sclbit, int sdabit, int unitsize) {
+	// {{{
+	if (unitsize < 1 || unitsize > (int)sizeof(uint64_t)) {
+		fprintf(stderr, "ERR: Binary samples must be 1-%d bytes wide, "
+			"not %d\n", (int)sizeof(uint64_t), unitsize);
+		exit(EXIT_FAILURE);
+	} if (sclbit < 0 || sclbit >= 8*unitsize
+			|| sdabit < 0 || sdabit >= 8*unitsize) {
+		fprintf(stderr, "ERR: SCL and SDA bits (%d,%d) must be within "
+			"a %d byte sample\n", sclbit, sdabit, unitsize);
+		exit(EXIT_FAILURE);
+	}
+
+	m_sclbit = sclbit; m_sdabit = sdabit; m_unit = unitsize;
+}
+// }}}
+
+bool	I2CREPLAY::binsample(double &t, I2CBUS &b) {
+	// {{{
+	unsigned char	*src;
+	uint64_t	v = 0;
+
+	if (window(m_unit) < (size_t)m_unit)
+		return false;
+
+	src = (unsigned char *)m_map + (m_pos - m_mapoff);
+	for(int k=m_unit-1; k>=0; k--)
+		v = (v << 8) | src[k];
+	m_pos += m_unit;
+
+	t = m_samples / m_rate;
+	b = I2CBUS((v >> m_sclbit)&1, (v >> m_sdabit)&1);
+	return true;
+}
+// }}}
+
+bool	I2CREPLAY::sample(double &t, I2CBUS &b) {
+	// {{{
+	bool	r;
+
+	if ((!m_csv || m_tcol < 0) && m_rate <= 0) {
+		fprintf(stderr, "ERR: A sample rate is required for this capture\n");
+		exit(EXIT_FAILURE);
+	}
+
+	r = (m_csv) ? csvsample(t, b) : binsample(t, b);
+	if (r)
+		m_samples++;
+	return r;
+}
+// }}}
+
+bool	I2CREPLAY::operator()(I2CBUS &b) {
+	// {{{
+	double	now;
+
+	if (!m_started) {
+		// Time starts with the first sample
+		m_started = true;
+		if (!sample(m_t0, m_cur))
+			return false;
+		m_have_nxt = sample(m_nxt_time, m_nxt);
+	}
+
+	// Move on to the last sample starting at or before this tick
+	now = m_t0 + m_tick / m_clkhz;
+	while(m_have_nxt && m_nxt_time <= now) {
+		m_cur = m_nxt;
+		m_have_nxt = sample(m_nxt_time, m_nxt);
+	}
+
+	// The last sample lasts for one sample period, if we know it, or
+	// one tick otherwise
+	if (!m_have_nxt && now > m_nxt_time + ((m_rate > 0) ? 1/m_rate : 0))
+		return false;
+
+	m_tick++;
+	b = m_cur;
+	return true;
+}
+// }}}
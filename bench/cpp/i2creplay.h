@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2creplay.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Plays back SCL and SDA, as captured from real hardware by a
+//		logic analyzer, so that a slave under test can be driven with
+//	exactly the timing seen in the field.  Two capture formats are read:
+//	CSV, as written by sigrok-cli -O csv (or a spreadsheet), and raw
+//	binary samples, as written by sigrok-cli -O binary.  Captures may be
+//	far larger than memory, so the file is mapped a chunk at a time, and
+//	each chunk read straight through.  Samples are resampled onto the
+//	simulation clock by holding each sample until the tick on which the
+//	next one starts.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CREPLAY_H
+#define	I2CREPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "i2csim.h"
+
+// How much of the capture to map at one time
+#define	I2CREPLAY_CHUNK		(1ul<<26)
+
+// The longest CSV line we'll accept
+#define	I2CREPLAY_MAXLINE	256
+
+class	I2CREPLAY {
+	int		m_fd;
+	size_t		m_fsize, m_maplen;
+	off_t		m_mapoff, m_pos;
+	char		*m_map;
+
+	// Format
+	// {{{
+	bool		m_csv;
+	double		m_clkhz, m_rate;
+	int		m_tcol, m_sclcol, m_sdacol;	// CSV columns
+	int		m_sclbit, m_sdabit, m_unit;	// Binary sample format
+	// }}}
+
+	// Playback state
+	// {{{
+	I2CBUS		m_cur, m_nxt;
+	double		m_t0, m_nxt_time;
+	bool		m_started, m_have_nxt;
+	unsigned long	m_tick, m_samples, m_lines;
+	// }}}
+
+	// Make at least need bytes from m_pos on available in the map, or as
+	// many as are left in the file.  Returns the number available.
+	size_t	window(size_t need);
+	bool	sample(double &t, I2CBUS &b);
+	bool	csvsample(double &t, I2CBUS &b);
+	bool	binsample(double &t, I2CBUS &b);
+public:
+	// Open a capture to be played back onto a simulation clocked at
+	// clkhz.  Files ending in .csv are read as CSV, anything else as
+	// raw binary samples.
+	I2CREPLAY(const char *fname, double clkhz);
+	~I2CREPLAY(void);
+
+	// Format options.  All must be set before the first sample is read.
+	// {{{
+	// The capture's sample rate, in Hz.  Binary captures, and CSV
+	// captures without a time column, require this.
+	void	samplerate(double hz) { m_rate = hz; }
+
+	// The CSV columns holding the time (in seconds), SCL, and SDA,
+	// counting from zero.  A time column of -1 means there isn't one,
+	// and the samplerate() is used instead.  Defaults to 0, 1, and 2.
+	void	columns(int tcol, int sclcol, int sdacol) {
+		m_tcol = tcol; m_sclcol = sclcol; m_sdacol = sdacol;
+	}
+
+	// The bits holding SCL and SDA within each binary sample, and the
+	// number of bytes per sample (little endian).  Defaults to bits 0
+	// and 1, one byte per sample.  Samples may be 1-8 bytes wide, and
+	// both bits must fall within one.
+	void	bits(int sclbit, int sdabit, int unitsize = 1);
+	// }}}
+
+	// Return the bus for the next tick in b.  Returns false, once the
+	// capture has run out.
+	bool	operator()(I2CBUS &b);
+
+	// True if the capture is being read as CSV, rather than binary
+	bool		csv(void) const { return m_csv; }
+	unsigned long	ticks(void) const { return m_tick; }
+	unsigned long	samples(void) const { return m_samples; }
+	size_t		size(void) const { return m_fsize; }
+	// Bytes of the capture consumed so far
+	size_t		consumed(void) const { return (size_t)m_pos; }
+};
+
+#endif
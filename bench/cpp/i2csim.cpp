@@ -37,16 +37,308 @@
 // }}}
 #include "i2csim.h"
 
+void	I2CSIMSLAVE::init(const int ADDRESS, const int nbits, char *mem) {
+	m_memsz = (1<<nbits);
+	m_adrmsk = m_memsz-1;
+	m_owned = (mem == NULL);
+	if (m_owned) {
+		m_data = new char[m_memsz];
+		memset(m_data, 0, m_memsz);
+	} else
+		m_data = mem;
+	m_last_sda = 1;
+	m_last_scl = 1;
+	m_addr = 0;
+	m_abytes = 1;
+	m_illegal = false;
+	m_nak = false;
+	m_state = I2CIDLE;
+
+	m_tick = m_last_change_tick = 0;
+	m_in_change_tick = m_in_sda_tick = 0;
+	m_timing_errs = 0;
+	m_protocol_errs = 0;
+	m_protocol = I2CSIM_ASSERT;
+
+	m_in_scl = m_in_sda = 1;
+	m_settled = false;
+	m_event_driven = true;
+	m_tlm = false;
+	m_tlm_fallback = false;
+
+	m_devaddr = ADDRESS;
+	m_daddr = 0;
+}
+
+unsigned long	I2CSIMSLAVE::idle_ticks(void) const {
+	if (!m_settled)
+		return 0;
+
+	// The fast path never counts anything, but only reacts to its inputs
+	if (fastpath())
+		return I2CSIM_FOREVER;
+
+	if ((m_state == I2CDEVACK || m_state == I2CSACK) && counting()) {
+		// We are stretching the clock.  The bus will change when our
+		// counter reaches m_stretch.
+		if (m_counter <= m_timing.m_stretch)
+			return m_timing.m_stretch - m_counter;
+	} else if (counting()) {
+		// We are holding SDA, and will change it once our counter
+		// reaches m_hold
+		return m_timing.m_hold - 1 - m_counter;
+	}
+
+	// Otherwise, we're waiting on an edge from the master
+	return I2CSIM_FOREVER;
+}
+
+I2CBUS	I2CSIMSLAVE::skip(unsigned long nticks) {
+	unsigned long	idle = idle_ticks();
+
+	assert(nticks <= idle);
+
+	// Nothing changes while we skip, save our tick and stretch counters
+	if ((counting())&&(!fastpath()))
+		m_counter += nticks;
+	m_tick += nticks;
+
+	// If we've skipped all the way up to our next event, we'll need a full
+	// evaluation on the next tick to act upon it
+	if (nticks == idle)
+		m_settled = false;
+
+	return bus();
+}
+
+void	I2CSIMSLAVE::select(int devword, int scl, int sda) {
+	// Mirror what operator() does on the last bit of I2CDEVADDR
+	m_addr    = devword & 0x0ff;
+	m_abits   = 8;
+	m_dbits   = 0;
+	m_ack     = ackbit(devack());
+	m_counter = 0;
+	m_devword = m_addr;
+	m_illegal = false;
+	m_state   = I2CDEVACK;
+	m_tlm_fallback = false;
+
+	m_bus.m_scl = m_bus.m_sda = 1;
+	m_last_scl = m_in_scl = scl;
+	m_last_sda = m_in_sda = sda;
+	m_settled = false;
+}
+
+void	I2CSIMSLAVE::release(bool stop) {
+	if (m_state != I2CIDLE)
+		endxfer(stop);
+	m_state   = I2CIDLE;
+	m_illegal = false;
+	m_nak     = false;
+	m_bus.m_scl = m_bus.m_sda = 1;
+	m_last_scl = m_in_scl = 1;
+	m_last_sda = m_in_sda = 1;
+	m_settled = false;
+}
+
+void	I2CSIMSLAVE::timing_violation(const char *what, unsigned long ticks,
+			unsigned long minimum) {
+	m_timing_errs++;
+	if (m_timing.m_check == I2CSIM_IGNORE)
+		return;
+
+	fprintf(stderr, "I2C(%02x): ERR-%s: ONLY %ld CLOCKS, NEED %ld, AT TICK %ld\n",
+		m_devaddr, what, ticks, minimum, m_tick);
+	if (m_timing.m_check == I2CSIM_ASSERT)
+		assert(ticks >= minimum);
+}
+
+void	I2CSIMSLAVE::protocol_violation(const char *what) {
+	m_protocol_errs++;
+	if (m_protocol != I2CSIM_IGNORE)
+		fprintf(stderr, "I2C(%02x): ERR-PROTOCOL: %s, AT TICK %ld\n",
+			m_devaddr, what, m_tick);
+	assert(m_protocol != I2CSIM_ASSERT);
+
+	// Give up on this transaction, and release the bus until the next
+	// STOP (or START)
+	m_state = I2CLOSTBUS;
+	m_bus.m_scl = m_bus.m_sda = 1;
+}
+
+// fast
+// {{{
+// The transaction level fast path.  This follows the same states as the full
+// model below, and leaves them where the full model would, but only acts on
+// SCL edges--receiving a bit on each rising edge, and changing what we drive
+// on each falling edge.  Returns false, having changed nothing, if the bus
+// does anything this path doesn't handle.
+bool	I2CSIMSLAVE::fast(int scl, int sda) {
+	bool	rise = (scl)&&(!m_in_scl), fall = (!scl)&&(m_in_scl);
+	I2CBUS	r;
+
+	if ((scl)&&(m_in_scl)&&(sda != m_in_sda)) {
+		if (!sda)	// A repeated START: let the full model handle it
+			return false;
+
+		// A STOP
+		endxfer(true);
+		m_state = I2CIDLE;
+		m_illegal = false;
+		m_nak = false;
+		m_bus.m_scl = m_bus.m_sda = 1;
+	} else if (rise || fall) switch(m_state) {
+	case I2CDEVACK:
+	case I2CSACK:
+		// Count the falling edges: the first starts our ACK (or
+		// NAK), the second ends it
+		if (!fall)
+			break;
+		if (m_counter++ == 0) {
+			m_bus.m_sda = m_ack;
+			break;
+		}
+
+		m_bus.m_sda = 1;
+		m_counter = 0;
+		m_dbits = 0;
+		if (m_ack) {
+			m_state = I2CLOSTBUS;
+		} else if (m_state == I2CSACK) {
+			m_state = (m_abits < 8*m_abytes) ? I2CADDR : I2CSRX;
+		} else if (m_devword & 1) {
+			m_state = I2CSTX;
+			m_dreg = read();
+			m_bus.m_sda = (m_dreg >> 7)&1;
+		} else {
+			m_state = I2CADDR;
+			m_abits = 0;
+			m_addr  = 0;
+		} break;
+	case I2CADDR:
+		if (!rise)
+			break;
+		m_addr = (m_addr<<1)|sda;
+		m_abits++;
+		if (m_abits >= 8*m_abytes) {
+			m_state = I2CSACK;
+			m_daddr = m_addr & m_adrmsk;
+			m_ack = ackbit(getack(m_addr));
+		} else if ((m_abits & 7)==0) {
+			m_state = I2CSACK;
+			m_ack = ackbit(0);
+		} m_counter = 0;
+		break;
+	case I2CSRX:
+		if (!rise)
+			break;
+		m_dreg = ((m_dreg<<1) | sda)&0x0ff;
+		if (++m_dbits == 8) {
+			m_state = I2CSACK;
+			m_ack = ackbit(0);
+			m_counter = 0;
+			write(m_addr, m_dreg);
+			m_addr = nxtaddr(m_addr);
+		} break;
+	case I2CSTX:
+		if (!fall)
+			break;
+		if (++m_dbits == 8) {
+			// Release SDA for the master's ACK
+			m_state = I2CMACK;
+			m_bus.m_sda = 1;
+			m_counter = 0;
+		} else
+			m_bus.m_sda = (m_dreg >> (7-m_dbits))&1;
+		break;
+	case I2CMACK:
+		// Sample the master's ACK on the rising edge, act on it at
+		// the falling edge
+		if (rise)
+			m_counter = sda;
+		else if (m_counter) {
+			// NAK: the read is over
+			m_state = I2CLOSTBUS;
+			m_dbits = 0;
+		} else {
+			m_state = I2CSTX;
+			m_dbits = 0;
+			m_dreg = read();
+			m_bus.m_sda = (m_dreg >> 7)&1;
+		} break;
+	default:
+		return false;
+	}
+
+	m_in_scl = scl;
+	m_in_sda = sda;
+	m_tick++;
+
+	r = I2CBUS(scl, sda) + m_bus;
+	if ((r.m_scl != m_last_scl)||(r.m_sda != m_last_sda))
+		m_last_change_tick = m_tick;
+	m_last_scl = r.m_scl;
+	m_last_sda = r.m_sda;
+
+	// Nothing more will happen until our inputs change
+	m_settled = true;
+
+	return true;
+}
+// }}}
+
 I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 	I2CBUS	r(scl, sda); // Our default result
+	I2CSTATE	last_state = m_state;
+	int		last_dbits = m_dbits, last_abits = m_abits,
+			last_scl = m_last_scl, last_sda = m_last_sda;
+	I2CBUS		last_bus = m_bus;
+	bool		same_inputs;
+
+	same_inputs = (scl == m_in_scl)&&(sda == m_in_sda);
+	if ((m_event_driven)&&(same_inputs)&&(idle_ticks() > 0))
+		return skip(1);
+	if (fastpath()) {
+		if (fast(scl, sda))
+			return bus();
+		// Something unusual happened.  Let the bit accurate model
+		// handle it, and the rest of this transaction.
+		m_tlm_fallback = true;
+	}
+	if (!same_inputs) {
+		// Check the master's timing against our profile
+		if ((m_in_change_tick>0)
+			&&(m_tick - m_in_change_tick < m_timing.m_min_change)){
+			timing_violation("SHORT-CHANGE",
+				m_tick - m_in_change_tick,
+				m_timing.m_min_change);
+		}
+
+		// Data must be stable for m_setup ticks before SCL rises
+		if ((scl)&&(!m_in_scl)&&(m_state != I2CIDLE)
+			&&(m_tick - m_in_sda_tick < (unsigned)m_timing.m_setup)){
+			timing_violation("SETUP", m_tick - m_in_sda_tick,
+				m_timing.m_setup);
+		}
+
+		if (sda != m_in_sda)
+			m_in_sda_tick = m_tick;
+		m_in_change_tick = m_tick;
+	}
+
+	m_in_scl = scl;
+	m_in_sda = sda;
 
 	if ((scl & m_bus.m_scl)&&(m_last_scl)
 			&&(sda & m_bus.m_sda)&&(!m_last_sda)) {
 		// Stop bit: Low to high transition with scl high
 		// Leave the bus as is
 		// printf("START BIT: Setting state to idle\n");
+		if (m_state != I2CIDLE)
+			endxfer(true);
 		m_state = I2CIDLE;
 		m_illegal = false;
+		m_nak = false;
 
 		m_bus.m_scl = m_bus.m_sda = 1;
 	} else {
@@ -54,7 +346,10 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 		switch(m_state) {
 		case I2CIDLE:
 			if (!scl) {
-				m_state = I2CILLEGAL;
+				if (m_protocol == I2CSIM_ASSERT)
+					m_state = I2CILLEGAL;
+				else
+					protocol_violation("SCL LOW WHILE IDLE");
 			} else if (!sda) {
 				m_state = I2CDEVADDR;
 				m_addr  = 0;
@@ -71,14 +366,15 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 					m_addr &= 0x0ff;
 					if ((m_addr >> 1)==(m_devaddr)) {
 						m_state = I2CDEVACK;
-						m_ack = 0;
+						m_tlm_fallback = false;
+						m_ack = ackbit(devack());
 						m_devword = m_addr;
 					} else
 						m_state = I2CLOSTBUS;
 				} m_counter = 0;
-			} else if (scl) {
+			} else if ((scl)&&(sda != m_last_sda)) {
 				// Can't change when the clock is high
-				assert(sda == m_last_sda);
+				protocol_violation("SDA CHANGED WITH SCL HIGH");
 			} // The the bus as it was on entry
 			break;
 		case	I2CDEVACK:
@@ -96,14 +392,25 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 					// is allowed to pull the line low
 					// during our ack period
 					if (!r.m_sda) {
-						assert(r.m_sda);
+						protocol_violation("SDA PULLED LOW DURING OUR ACK");
+						break;
 					}
 				}
-				if (m_counter++ < 400) {
+				// Only stretch the clock if we are ACKing
+				if ((m_counter++ < m_timing.m_stretch)&&(!m_ack)) {
 					m_bus.m_scl = 0;
-				} else if ((r.m_scl==0)&&(m_last_scl)) {
-					if (m_devword&1) {
+				} else if ((m_counter > 1)
+						&&(r.m_scl==0)&&(m_last_scl)) {
+					// m_counter > 1 keeps us from mistaking
+					// the edge that brought us here for the
+					// end of the ACK, when not stretching
+					if (m_ack) {
+						// We NAK'd.  Ignore everything
+						// until the next STOP
+						m_state = I2CLOSTBUS;
+					} else if (m_devword&1) {
 						m_state = I2CSTX;
+						m_counter = 0;
 						m_dreg = read();
 						// printf("I2C: Sending %02x next\n", m_dreg & 0x0ff);
 					} else {
@@ -118,14 +425,18 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 			if ((scl)&&(!m_last_scl)) {
 				m_addr = (m_addr<<1)|sda;
 				m_abits++;
-				if (m_abits >= 8) {
+				if (m_abits >= 8*m_abytes) {
 					m_state = I2CSACK;
-					m_daddr = m_addr;
-					m_ack = getack(m_addr);
+					m_daddr = m_addr & m_adrmsk;
+					m_ack = ackbit(getack(m_addr));
+				} else if ((m_abits & 7)==0) {
+					// ACK the first of two address bytes
+					m_state = I2CSACK;
+					m_ack = ackbit(0);
 				} m_counter = 0;
-			} else if (scl) {
+			} else if ((scl)&&(sda != m_last_sda)) {
 				// Can't change when the clock is high
-				assert(sda == m_last_sda);
+				protocol_violation("SDA CHANGED WITH SCL HIGH");
 			} // The the bus as it was on entry
 			break;
 		case	I2CSACK:
@@ -135,47 +446,67 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 				// last bit.
 			} else {
 				m_bus.m_sda = m_ack;
-				if (r.m_scl)
+				if ((r.m_scl)&&(!r.m_sda)) {
 					// Master is not allowed to pull the
 					// line low, that's our task
-					assert(r.m_sda);
+					protocol_violation("SDA PULLED LOW DURING OUR ACK");
+					break;
+				}
 				m_bus.m_sda = m_ack;
-				// Let's stretch the clock a touch here
-				if (m_counter++ < 400) {
+				// Let's stretch the clock a touch here, unless
+				// we are NAKing
+				if ((m_counter++ < m_timing.m_stretch)&&(!m_ack)) {
 					m_bus.m_scl = 0;
-				} else if ((!r.m_scl)&&(m_last_scl)) {
-					m_state = I2CSRX;
+				} else if ((m_counter > 1)
+						&&(!r.m_scl)&&(m_last_scl)) {
+					// Either on to the next address byte,
+					// or on to the data--unless we NAK'd,
+					// and so will ignore everything until
+					// the next STOP
+					if (m_ack)
+						m_state = I2CLOSTBUS;
+					else if (m_abits < 8*m_abytes)
+						m_state = I2CADDR;
+					else
+						m_state = I2CSRX;
 				}
 			} m_dbits = 0;
 			break;
 		case	I2CSRX:	// Master is writing to us, we are receiving
 			if (r.m_scl) {
 				// Not allowed to change when clock is high
-				if (m_last_scl)
-					assert(sda == m_last_sda);
+				if ((m_last_scl)&&(sda != m_last_sda)) {
+					protocol_violation("SDA CHANGED WITH SCL HIGH");
+					break;
+				}
 				if (!m_last_scl) {
 					m_dreg = ((m_dreg<<1) | r.m_sda)&0x0ff;
 					m_dbits++;
 					if (m_dbits == 8) {
 						// Get an ack from the master
 						m_state = I2CSACK;
+						m_ack = ackbit(0);
 						write(m_addr, m_dreg);
-						m_addr = (m_addr + 1)&m_adrmsk;
+						m_addr = nxtaddr(m_addr);
 					}
 				} m_counter = 0;
 			} break;
 		case	I2CSTX: // Master is reading from us, we are txmitting
 			//if (!sda) { // assert(sda); }
-			if ((m_counter == 0)&&(r.m_scl)) {
-			} else if (m_counter++ < 20) {
-				// Wait some time before changing
-			} if (r.m_scl) {
+			if (r.m_scl) {
 				// Not allowed to change when clock is high
 				m_bus.m_sda = m_last_sda;
 			} else if (!m_last_scl) {
-				m_bus.m_sda = m_dreg>>(7-(m_dbits&0x07));
+				// Wait our hold time before changing
+				if (m_counter < m_timing.m_hold)
+					m_counter++;
+				if (m_counter < m_timing.m_hold)
+					m_bus.m_sda = m_last_sda;
+				else
+					m_bus.m_sda = m_dreg>>(7-(m_dbits&0x07));
 			} else if (m_last_scl) {
 				m_dbits++;
+				m_counter = 0;
 				m_bus.m_sda = m_last_sda;
 				if (m_dbits == 8) {
 					// Get an ack from the master
@@ -193,10 +524,14 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 				if (!sda) {
 					// master ACK'd.  Go on
 					m_state = I2CSTX;
+					m_counter = 0;
 					m_dreg = read();
 					// printf("I2C: Sending %02x next\n", m_dreg & 0x0ff);
 				} else {
-					m_state = I2CILLEGAL;
+					// The master NAK'd, marking the end
+					// of the read.  Release the bus until
+					// the following STOP (or START).
+					m_state = I2CLOSTBUS;
 				}
 			} m_dbits = 0;
 			break;
@@ -223,15 +558,6 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 	m_tick++;
 	r += m_bus;
 	if ((r.m_scl != m_last_scl)||(r.m_sda != m_last_sda)) {
-		/*
-		if ((m_last_change_tick>0)&&(m_tick - m_last_change_tick < m_speed)) {
-			fprintf(stderr, "ERR-SHORT-CHANGE: ONLY %ld CLOCKS BETWEN CHANGES\n",
-				m_tick-m_last_change_tick);
-			fprintf(stderr, "LAST CHANGE AT %ld TICKS, CHANGING AGAIN AT %ld TICKS\n", m_last_change_tick, m_tick);
-			fprintf(stderr, "LAST-STATE: %d,%d\n", m_last_scl, m_last_sda);
-			fprintf(stderr, "THIS-STATE: %d,%d\n", r.m_scl, r.m_sda);
-			// assert(m_tick - m_last_change_tick >= m_speed);
-		} */
 		m_last_change_tick = m_tick;
 	}
 
@@ -239,6 +565,233 @@ I2CBUS	I2CSIMSLAVE::operator()(int scl, int sda) {
 	m_last_sda = r.m_sda;
 	// printf("TICK: LAST SCL,SDA = %d,%d\n", m_last_scl, m_last_sda);
 
+	// If nothing changed, then nothing will change on the next tick
+	// either--unless either our inputs change or a counter expires
+	m_settled = (same_inputs)&&(m_state == last_state)
+		&&(m_dbits == last_dbits)&&(m_abits == last_abits)
+		&&(m_last_scl == last_scl)&&(m_last_sda == last_sda)
+		&&(m_bus.m_scl == last_bus.m_scl)
+		&&(m_bus.m_sda == last_bus.m_sda);
+
 	return r;
 }
 
+
+void	I2CSIMBUS::protocol_violation(const char *what) {
+	// As for I2CSIMSLAVE::protocol_violation()
+	m_protocol_errs++;
+	if (m_protocol != I2CSIM_IGNORE)
+		fprintf(stderr, "I2C: ERR-PROTOCOL: %s, AT TICK %ld\n",
+			what, m_tick);
+	assert(m_protocol != I2CSIM_ASSERT);
+}
+
+I2CBUS	I2CSIMBUS::operator()(int scl, int sda) {
+	I2CBUS	r(scl, sda);
+
+	m_tick++;
+
+	if (m_illegal) {
+		// As for a slave in I2CILLEGAL, stop a tick after we got here,
+		// so a trace trigger can see it first
+		fprintf(stderr, "I2C: Illegal state!!\n");
+		m_illegal = false;
+		assert(0);
+	}
+
+	// START and STOP conditions can only come from a master.  Check for
+	// them on the master's lines, before any slave gets a chance to
+	// respond.
+	if ((scl)&&(m_in_scl)&&(sda != m_in_sda)) {
+		bool	restart = (m_addressing)&&(!sda);
+
+		if (m_active)
+			m_active->release(sda != 0);
+		m_active = NULL;
+
+		// On a START, decode the device word.  On a STOP, go idle.
+		m_busy = (!sda);
+		m_addressing = (!sda);
+		m_nak = false;
+		m_devword = 0;
+		m_nbits   = 0;
+
+		// A slave doesn't allow a repeated START within the device
+		// word, and ignores the bus until the next STOP if it isn't
+		// stopped for one
+		if (restart) {
+			protocol_violation("SDA CHANGED WITH SCL HIGH");
+			m_addressing = false;
+		}
+	} else if (m_active) {
+		r = (*m_active)(scl, sda);
+		if (m_active->vstate() == I2CIDLE)
+			m_active = NULL;
+	} else if ((!m_busy)&&(!scl)) {
+		// No one may pull SCL low without a START first.  Treat the
+		// bus as busy until the next STOP, so as to only complain once.
+		m_busy = true;
+		if (m_protocol == I2CSIM_ASSERT)
+			m_illegal = true;
+		else
+			protocol_violation("SCL LOW WHILE IDLE");
+	} else if ((m_addressing)&&(scl)&&(!m_last_scl)) {
+		m_devword = ((m_devword << 1) | (sda&1)) & 0x0ff;
+		if (++m_nbits >= 8) {
+			I2CSIMSLAVE	*slv = m_devices[m_devword >> 1];
+
+			m_addressing = false;
+			if (slv) {
+				slv->tickcount(m_tick);
+				if (m_nak)
+					slv->nak();
+				slv->select(m_devword, scl, sda);
+				m_active = slv;
+			} // else no one is home.  The master will see a NAK.
+			m_nak = false;
+		}
+	}
+
+	m_in_scl = scl;
+	m_in_sda = sda;
+	m_last_scl = r.m_scl;
+	m_last_sda = r.m_sda;
+
+	return r;
+}
+
+void	I2CSIMMASTER::nxtbyte(void) {
+	// {{{
+	if (m_nbytes == 0)
+		m_sreg = (m_devaddr << 1) | ((m_read) ? 1:0);
+	else if (m_read)
+		m_sreg = 0x0ff;	// Release SDA, so the slave can drive it
+	else
+		m_sreg = m_rng() & 0x0ff;
+	m_nbits = 0;
+	m_state = I2CM_BITLO;
+	m_counter = 0;
+}
+// }}}
+
+I2CBUS	I2CSIMMASTER::operator()(const I2CBUS bus) {
+	// {{{
+	m_tick++;
+
+	// Keep track of whether anyone owns the bus
+	if (bus.m_scl && m_last.m_scl && bus.m_sda != m_last.m_sda)
+		m_busy = !bus.m_sda;
+
+	switch(m_state) {
+	case I2CM_IDLE:
+		m_out = I2CBUS(1,1);
+		if (m_tick >= m_next) {
+			m_state = I2CM_WAITFREE;
+			m_holdoff = m_minhold
+				+ m_rng.range(m_maxhold - m_minhold + 1);
+			m_counter = 0;
+		} break;
+	case I2CM_WAITFREE:
+		// The bus must be free for a while before we START
+		if (m_busy || !bus.m_scl || !bus.m_sda)
+			m_counter = 0;
+		else if (++m_counter >= m_holdoff) {
+			m_attempts++;
+			m_read  = m_rng.flip();
+			m_len   = 1 + m_rng.range(m_maxlen);
+			m_nbytes = 0;
+			m_nak   = false;
+			m_out   = I2CBUS(1,0);
+			m_state = I2CM_START;
+			m_counter = 0;
+		} break;
+	case I2CM_START:
+		if (++m_counter >= m_halfbit) {
+			m_out = I2CBUS(0,0);
+			nxtbyte();
+		} break;
+	case I2CM_BITLO: {
+		int	bit;
+
+		// Bits 0-7 are the byte, bit 8 the ACK
+		if (m_nbits < 8)
+			bit = (m_sreg >> (7-m_nbits))&1;
+		else if (m_nbytes > 0 && m_read)
+			// Our ACK, or a NAK on the last byte
+			bit = (m_nbytes >= m_len) ? 1 : 0;
+		else
+			bit = 1;	// Release SDA for the slave's ACK
+		m_out = I2CBUS(0, bit);
+		if (++m_counter >= m_halfbit) {
+			m_out.m_scl = 1;
+			m_state = I2CM_BITHI;
+			m_counter = 0;
+		} } break;
+	case I2CM_BITHI:
+		// Clock synchronization: the high period doesn't start until
+		// everyone has released SCL, and ends early if anyone else
+		// pulls it low
+		if (!bus.m_scl) {
+			if (m_counter == 0)
+				break;
+		} else if (m_out.m_sda && !bus.m_sda && transmitting()) {
+			// We released SDA, someone else pulled it low: we've
+			// lost arbitration.  Drop off the bus until the STOP.
+			m_lost++;
+			m_out = I2CBUS(1,1);
+			m_state = I2CM_LOST;
+			break;
+		} else if (++m_counter < m_halfbit)
+			break;
+
+		// End of this bit
+		if (m_nbits == 8 && (m_nbytes == 0 || !m_read)) {
+			// The slave's ACK
+			if (bus.m_sda) {
+				m_naks++;
+				m_nak = true;
+			}
+		}
+		m_out = I2CBUS(0, m_out.m_sda);
+		m_counter = 0;
+		if (++m_nbits < 9)
+			m_state = I2CM_BITLO;
+		else if (!m_nak && (m_nbytes++ < m_len))
+			nxtbyte();
+		else {
+			// Hold SDA until SCL has fallen, lest a slave see our
+			// NAK of its last byte as an ACK, and lower it for the
+			// STOP on the next tick
+			m_state = I2CM_STOPLO;
+		} break;
+	case I2CM_STOPLO:
+		if (m_counter > 0)
+			m_out = I2CBUS(0,0);
+		if (++m_counter > m_halfbit) {
+			m_out = I2CBUS(1,0);
+			m_state = I2CM_STOPHI;
+			m_counter = 0;
+		} break;
+	case I2CM_STOPHI:
+		if (!bus.m_scl)
+			break;
+		if (++m_counter >= m_halfbit) {
+			m_out = I2CBUS(1,1);
+			m_completed++;
+			m_state = I2CM_IDLE;
+			schedule();
+		} break;
+	case I2CM_LOST:
+	default:
+		m_out = I2CBUS(1,1);
+		if (!m_busy) {
+			m_state = I2CM_IDLE;
+			// Try again, as soon as the bus is free
+			m_next = m_tick;
+		} break;
+	}
+
+	m_last = bus;
+	return m_out;
+}
+// }}}
@@ -42,6 +42,13 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+
+#include "tbrand.h"
+
+// Returned by I2CSIMSLAVE::idle_ticks() when the model is waiting on the
+// bus alone, and so will never change on its own
+#define	I2CSIM_FOREVER	ULONG_MAX
 
 class	I2CBUS {
 public:
@@ -56,6 +63,32 @@ public:
 	}
 };
 
+// Enforcement modes: what to do when the bus violates a slave's timing
+// profile, or the I2C protocol itself
+typedef	enum { I2CSIM_IGNORE=0, I2CSIM_WARN, I2CSIM_ASSERT } I2CSIMCHECK;
+
+// I2CSIMTIMING
+// {{{
+// A per-slave timing profile, in simulation ticks.  The defaults are the
+// timing this model has always used.  Setting m_stretch to zero gives a slave
+// that never stretches the clock, for running throughput regressions at full
+// speed.
+class	I2CSIMTIMING {
+public:
+	int	m_stretch,	// Ticks to hold SCL low at every ACK
+		m_hold,		// Ticks after SCL falls before we change SDA
+		m_setup;	// Ticks SDA must be stable before SCL rises
+	unsigned long	m_min_change;	// Min ticks between master's changes
+	I2CSIMCHECK	m_check;	// How to handle the master's violations
+
+	I2CSIMTIMING(int stretch = 400, int hold = 1, int setup = 0,
+			unsigned long min_change = 20,
+			I2CSIMCHECK check = I2CSIM_IGNORE)
+		: m_stretch(stretch), m_hold(hold), m_setup(setup),
+		m_min_change(min_change), m_check(check) {}
+};
+// }}}
+
 typedef	enum { I2CIDLE=0, I2CDEVADDR, I2CDEVACK,
 	I2CADDR, I2CSACK, I2CSRX, I2CSTX, I2CMACK, I2CLOSTBUS, I2CILLEGAL
 } I2CSTATE;
@@ -65,17 +98,65 @@ class	I2CSIMSLAVE {
 	int	m_addr, m_daddr, m_abits, m_dbits, m_dreg, m_ack,
 			m_last_sda, m_last_scl, m_counter, m_devword,
 			m_memsz, m_adrmsk,
-		m_devaddr;
-	bool	m_illegal;
-	unsigned long	m_tick, m_last_change_tick, m_speed;
+		m_devaddr, m_abytes;
+	bool	m_illegal, m_owned, m_nak;
+	unsigned long	m_tick, m_last_change_tick, m_in_change_tick,
+			m_in_sda_tick, m_timing_errs, m_protocol_errs;
+	I2CSIMTIMING	m_timing;
+	I2CSIMCHECK	m_protocol;
 	I2CBUS	m_bus; // My inputs
 
+	// Event driven support.  m_in_scl and m_in_sda hold the inputs given
+	// to us on our last evaluation.  m_settled is true if that evaluation
+	// changed nothing--so that, until our inputs change, the only thing
+	// that can happen is that a clock stretch counter expires.
+	int	m_in_scl, m_in_sda;
+	bool	m_settled, m_event_driven;
+
+	// Transaction level support.  When m_tlm is set, the data phases of
+	// a transaction are handled by fast() below, until anything unusual
+	// sets m_tlm_fallback for the rest of that transaction.
+	bool	m_tlm, m_tlm_fallback;
+
 	I2CSTATE	m_state;
 
+	// Returns true if the current state is counting down a clock stretch,
+	// or counting out its hold time
+	bool	counting(void) const {
+		if (m_state == I2CSTX)
+			return (!m_in_scl)&&(m_counter < m_timing.m_hold);
+		if (m_state != I2CDEVACK && m_state != I2CSACK)
+			return false;
+		return (m_counter != 0)||(!m_in_scl);
+	}
+
+	void	timing_violation(const char *what, unsigned long ticks,
+			unsigned long minimum);
+	void	protocol_violation(const char *what);
+
+	void	init(const int ADDRESS, const int nbits, char *mem);
+
+	// True if this tick belongs to the transaction level fast path
+	bool	fastpath(void) const {
+		return (m_tlm)&&(!m_tlm_fallback)&&(m_state != I2CIDLE)
+			&&(m_state != I2CDEVADDR)&&(m_state != I2CLOSTBUS)
+			&&(m_state != I2CILLEGAL);
+	}
+	bool	fast(int scl, int sda);
+
 	volatile int	getack(int addr) {
 		m_ack = 0;
 		return m_ack;
 	}
+
+	// The ACK (zero) or NAK (one) we'll give, given the one we would have
+	// given, once any NAK forced on us via nak() is taken into account
+	int	ackbit(int ack) {
+		if (m_nak) {
+			m_nak = false;
+			return 1;
+		} return ack;
+	}
 	volatile char	read(int addr) {
 		// printf("SETTING READ ADDRESS TO %02x\n", m_daddr & m_adrmsk);
 		m_daddr = addr;
@@ -89,41 +170,508 @@ class	I2CSIMSLAVE {
 	}
 	volatile void	write(int addr, char data) {
 		m_daddr = addr & m_adrmsk;
-		m_data[m_daddr] = data;
+		store(m_daddr, data);
 	} volatile void	write(char data) {
 		m_daddr = (m_daddr+1) & m_adrmsk;
-		m_data[m_daddr] = data;
+		store(m_daddr, data);
+	}
+
+protected:
+	// Device model hooks
+	// {{{
+	// Slaves with more complex behavior, such as I2CEEPROM, override
+	// these.  The defaults give a simple register file, that always ACKs.
+
+	// Returns zero to ACK our device address, one to NAK it
+	virtual	int	devack(void) { return 0; }
+
+	// Write one byte received from the master into memory
+	virtual	void	store(int addr, char data) { m_data[addr] = data; }
+
+	// The address to write the next byte received to
+	virtual	int	nxtaddr(int addr) { return (addr + 1) & m_adrmsk; }
+
+	// Called at the end of every transaction addressed to us: stop is
+	// true for a STOP condition, false for a repeated START
+	virtual	void	endxfer(bool stop) {}
+	// }}}
+
+	// For slaves providing their own storage.  mem must hold (1<<nbits)
+	// bytes, and remains owned by the caller.
+	I2CSIMSLAVE(const int ADDRESS, const int nbits, char *mem) {
+		init(ADDRESS, nbits, mem);
 	}
 public:
 	I2CSIMSLAVE(const int ADDRESS = 0x050, const int nbits = 7) {
-		m_memsz = (1<<nbits);
-		m_adrmsk = m_memsz-1;
-		m_data = new char[m_memsz];
-		m_last_sda = 1;
-		m_last_scl = 1;
-		for(int i=0; i<m_memsz; i++)
-			m_data[i] = 0;
-		m_addr = 0;
-		m_illegal = false;
-		m_state = I2CIDLE;
-
-		m_tick = m_last_change_tick = 0;
-		m_speed= 20;
-		
-		m_devaddr = ADDRESS;
-		m_daddr = 0;
+		init(ADDRESS, nbits, NULL);
+	}
 
-		memset(m_data, 0, m_memsz);
+	virtual	~I2CSIMSLAVE(void) {
+		if (m_owned)
+			delete[] m_data;
 	}
 
 	I2CBUS	operator()(int scl, int sda);
 	I2CBUS	operator()(const I2CBUS b) { return (*this)(b.m_scl, b.m_sda); }
+
+	// Event driven interface
+	// {{{
+	// When event driven (the default), calls with the same inputs as the
+	// last call skip the state machine once it has settled.  Turning
+	// this off forces a full evaluation on every tick.
+	bool	event_driven(void) const { return m_event_driven; }
+	void	event_driven(bool ev) { m_event_driven = ev; }
+
+	// The number of ticks the model can be skipped over, with skip() below,
+	// assuming its inputs don't change.  Zero means the model must be
+	// called on the next tick.  I2CSIM_FOREVER means the model is waiting
+	// on a bus edge alone.
+	unsigned long	idle_ticks(void) const;
+
+	// The tick upon which the model next needs to be called, assuming
+	// its inputs don't change
+	unsigned long	next_event(void) const {
+		unsigned long	n = idle_ticks();
+
+		if (n == I2CSIM_FOREVER)
+			return I2CSIM_FOREVER;
+		return m_tick + n;
+	}
+
+	// Advance the model nticks, as though it had been called nticks times
+	// with the same inputs.  nticks must not exceed idle_ticks().
+	I2CBUS	skip(unsigned long nticks);
+
+	// Transaction level mode
+	// {{{
+	// Once a START and our address have been seen, handle the rest of
+	// the transaction a byte at a time, reacting only to SCL edges.  The
+	// slave never stretches the clock or waits its hold time, and none of
+	// the bit level protocol or timing checks are made.  Anything unusual,
+	// such as a repeated START, falls back to the full bit accurate model
+	// for the rest of the transaction.  Off by default.
+	bool	transaction_level(void) const { return m_tlm; }
+	void	transaction_level(bool tlm) { m_tlm = tlm; }
+	// }}}
+
+	// The current (resolved) state of the bus, as last seen by the model
+	I2CBUS	bus(void) const { return I2CBUS(m_last_scl, m_last_sda); }
+	unsigned long	tickcount(void) const { return m_tick; }
+
+	// Bring the model's tick count forward to tick.  Slaves on an
+	// I2CSIMBUS are only evaluated while they are addressed, so the bus
+	// uses this to keep their sense of time current.
+	void	tickcount(unsigned long tick) {
+		if (tick > m_tick)
+			m_tick = tick;
+	}
+	// }}}
 	char	&operator[](const int a) {
 		return m_data[a&m_adrmsk]; }
 
 	unsigned vstate(void) const {
 		return m_state;
 	}
+
+	// The number of register address bytes following the device address
+	// on a write, one (the default) or two
+	int	address_bytes(void) const { return m_abytes; }
+	void	address_bytes(int n) { assert(n >= 1 && n <= 2); m_abytes = n; }
+
+	// Timing profile
+	// {{{
+	const I2CSIMTIMING &timing(void) const { return m_timing; }
+	void	timing(const I2CSIMTIMING &t) { m_timing = t; }
+	void	stretch(int ticks) { m_timing.m_stretch = ticks; }
+	void	check(I2CSIMCHECK chk) { m_timing.m_check = chk; }
+
+	// The number of timing violations seen so far
+	unsigned long	timing_errors(void) const { return m_timing_errs; }
+	// }}}
+
+	// Protocol checks
+	// {{{
+	// By default, anything on the bus the I2C protocol doesn't allow,
+	// such as SDA changing while SCL is high mid-byte, stops the
+	// simulation.  When these are only warned about or ignored instead,
+	// the slave abandons the transaction and waits for the next STOP--as
+	// a real device would, when (for example) a fault is injected into
+	// the bus on purpose.
+	I2CSIMCHECK	protocol(void) const { return m_protocol; }
+	void	protocol(I2CSIMCHECK chk) { m_protocol = chk; }
+
+	// The number of protocol violations seen so far
+	unsigned long	protocol_errors(void) const { return m_protocol_errs; }
+	// }}}
+
+	// Bus dispatch support, for I2CSIMBUS
+	// {{{
+	// Our (7-bit) device address
+	int	address(void) const { return m_devaddr; }
+
+	// Place the slave into the state it would be in had it just received
+	// the device word devword (address and R/W bit) following a START.
+	// scl and sda are the bus values at the time.
+	void	select(int devword, int scl, int sda);
+
+	// Return the slave to idle and releasing the bus, as though it had
+	// just seen a STOP condition--or, if stop is false, a repeated START
+	void	release(bool stop = true);
+
+	// Fault injection: NAK the next byte we would otherwise ACK, be it
+	// the device word, a register address, or data written to us.  As
+	// with any other NAK, we then ignore the bus until the next STOP.
+	// Forgotten, if unused, by the end of the transaction.
+	void	nak(void) { m_nak = true; }
+	// }}}
+
+	// Checkpoints
+	// {{{
+	// Save, or restore, everything about this slave that changes as the
+	// simulation runs: its state, counters, error counts, and the contents
+	// of its memory.  Its configuration (address, memory size, timing, and
+	// so forth) is not saved, and must match between the two.  Any stream
+	// with write(const void *, size_t) and read(void *, size_t) methods,
+	// such as Verilator's VerilatedSerialize and VerilatedDeserialize, may
+	// be used.  Derived slaves' own state is not included.
+	template<class OS>	void	save(OS &os) const {
+		ckput(os, m_addr);   ckput(os, m_daddr);
+		ckput(os, m_abits);  ckput(os, m_dbits);
+		ckput(os, m_dreg);   ckput(os, m_ack);
+		ckput(os, m_last_sda); ckput(os, m_last_scl);
+		ckput(os, m_counter);  ckput(os, m_devword);
+		ckput(os, m_illegal); ckput(os, m_nak);
+		ckput(os, m_tick);
+		ckput(os, m_last_change_tick);
+		ckput(os, m_in_change_tick);
+		ckput(os, m_in_sda_tick);
+		ckput(os, m_timing_errs); ckput(os, m_protocol_errs);
+		ckput(os, m_bus);
+		ckput(os, m_in_scl);  ckput(os, m_in_sda);
+		ckput(os, m_settled); ckput(os, m_tlm_fallback);
+		ckput(os, m_state);
+		os.write(m_data, m_memsz);
+	}
+
+	template<class IS>	void	restore(IS &is) {
+		ckget(is, m_addr);   ckget(is, m_daddr);
+		ckget(is, m_abits);  ckget(is, m_dbits);
+		ckget(is, m_dreg);   ckget(is, m_ack);
+		ckget(is, m_last_sda); ckget(is, m_last_scl);
+		ckget(is, m_counter);  ckget(is, m_devword);
+		ckget(is, m_illegal); ckget(is, m_nak);
+		ckget(is, m_tick);
+		ckget(is, m_last_change_tick);
+		ckget(is, m_in_change_tick);
+		ckget(is, m_in_sda_tick);
+		ckget(is, m_timing_errs); ckget(is, m_protocol_errs);
+		ckget(is, m_bus);
+		ckget(is, m_in_scl);  ckget(is, m_in_sda);
+		ckget(is, m_settled); ckget(is, m_tlm_fallback);
+		ckget(is, m_state);
+		is.read(m_data, m_memsz);
+	}
+
+	template<class OS, class T>
+	static	void	ckput(OS &os, const T &v) { os.write(&v, sizeof(v)); }
+	template<class IS, class T>
+	static	void	ckget(IS &is, T &v) { is.read(&v, sizeof(v)); }
+	// }}}
 };
 
+// I2CSIMBUS
+// {{{
+// A collection of I2CSIMSLAVEs sharing one wired-AND bus.  The bus decodes
+// the device word following any START itself, and then dispatches the rest
+// of the transaction to the one slave it addresses (if any).  Only that slave
+// is evaluated until the next STOP or START, so the cost per tick doesn't
+// grow with the number of slaves on the bus.  Since no slave sees the bus
+// while it is idle, or during the device word, the bus makes the protocol
+// checks the slaves would have made there itself.
+class	I2CSIMBUS {
+	I2CSIMSLAVE	*m_devices[128], *m_active;
+	int	m_nslaves, m_devword, m_nbits,
+		m_in_scl, m_in_sda, m_last_scl, m_last_sda;
+	bool	m_addressing, m_tlm, m_busy, m_illegal, m_nak;
+	I2CSIMCHECK	m_protocol;
+	unsigned long	m_tick, m_protocol_errs;
+
+	void	protocol_violation(const char *what);
+
+public:
+	I2CSIMBUS(void) {
+		for(int k=0; k<128; k++)
+			m_devices[k] = NULL;
+		m_active = NULL;
+		m_nslaves = 0;
+		m_devword = 0;
+		m_nbits   = 0;
+		m_in_scl = m_in_sda = 1;
+		m_last_scl = m_last_sda = 1;
+		m_addressing = false;
+		m_tlm = false;
+		m_busy = false;
+		m_illegal = false;
+		m_nak = false;
+		m_protocol = I2CSIM_ASSERT;
+		m_tick = 0;
+		m_protocol_errs = 0;
+	}
+
+	~I2CSIMBUS(void) {
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				delete m_devices[k];
+	}
+
+	// Add a new slave to the bus.  The bus takes ownership of the slave,
+	// and will delete it when done.  Only one slave may be placed at any
+	// given address.
+	I2CSIMSLAVE	*add(I2CSIMSLAVE *slv) {
+		int	a = slv->address() & 0x07f;
+
+		assert(NULL == m_devices[a]);
+		m_devices[a] = slv;
+		m_nslaves++;
+		if (m_tlm)
+			slv->transaction_level(true);
+		slv->protocol(m_protocol);
+		return slv;
+	}
+
+	I2CSIMSLAVE	*add(const int ADDRESS, const int nbits = 7) {
+		return add(new I2CSIMSLAVE(ADDRESS, nbits));
+	}
+
+	// Return the slave at a given (7-bit) device address, or NULL if none
+	I2CSIMSLAVE	*slave(const int addr) const {
+		return m_devices[addr & 0x07f];
+	}
+
+	I2CSIMSLAVE	&operator[](const int addr) {
+		assert(m_devices[addr & 0x07f]);
+		return *m_devices[addr & 0x07f];
+	}
+
+	int	nslaves(void) const { return m_nslaves; }
+
+	// The slave currently engaged in a transaction, if any
+	I2CSIMSLAVE	*active(void) const { return m_active; }
+
+	// Fault injection: have the slave addressed by the transaction in
+	// progress NAK the next byte it would otherwise ACK, starting with
+	// the device word if that's still on its way.  See I2CSIMSLAVE::nak().
+	void	nak(void) {
+		if (m_active)
+			m_active->nak();
+		else if (m_addressing)
+			m_nak = true;
+	}
+
+	// Place every slave on the bus, both now and any added later, into
+	// (or out of) transaction level mode
+	bool	transaction_level(void) const { return m_tlm; }
+	void	transaction_level(bool tlm) {
+		m_tlm = tlm;
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				m_devices[k]->transaction_level(tlm);
+	}
+
+	// Set how the bus, and every slave on it both now and any added
+	// later, handles protocol violations
+	I2CSIMCHECK	protocol(void) const { return m_protocol; }
+	void	protocol(I2CSIMCHECK chk) {
+		m_protocol = chk;
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				m_devices[k]->protocol(chk);
+	}
+
+	// The number of protocol violations seen so far, by the bus itself
+	// and by all of its slaves
+	unsigned long	protocol_errors(void) const {
+		unsigned long	n = m_protocol_errs;
+
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				n += m_devices[k]->protocol_errors();
+		return n;
+	}
+
+	// True once the bus, or the slave engaged with it, has seen an
+	// illegal bus condition.  Under I2CSIM_ASSERT, the simulation stops
+	// on the following tick.
+	bool	illegal(void) const {
+		return (m_illegal)||((m_active)
+				&&(m_active->vstate() == I2CILLEGAL));
+	}
+
+	// Given the master's SCL and SDA outputs, return the resolved bus
+	I2CBUS	operator()(int scl, int sda);
+	I2CBUS	operator()(const I2CBUS b) { return (*this)(b.m_scl, b.m_sda); }
+
+	// Event driven interface, as for I2CSIMSLAVE
+	// {{{
+	unsigned long	idle_ticks(void) const {
+		if (m_illegal)
+			return 0;
+		if (m_active)
+			return m_active->idle_ticks();
+		return I2CSIM_FOREVER;
+	}
+
+	I2CBUS	skip(unsigned long nticks) {
+		m_tick += nticks;
+		if (m_active)
+			return m_active->skip(nticks);
+		return I2CBUS(m_last_scl, m_last_sda);
+	}
+
+	unsigned long	tickcount(void) const { return m_tick; }
+	// }}}
+
+	// Checkpoints, as for I2CSIMSLAVE.  The same slaves must have been
+	// added to the bus, in the same configuration, before restoring.
+	// {{{
+	template<class OS>	void	save(OS &os) const {
+		int	active = (m_active) ? m_active->address() : -1;
+
+		I2CSIMSLAVE::ckput(os, active);
+		I2CSIMSLAVE::ckput(os, m_devword);
+		I2CSIMSLAVE::ckput(os, m_nbits);
+		I2CSIMSLAVE::ckput(os, m_in_scl);
+		I2CSIMSLAVE::ckput(os, m_in_sda);
+		I2CSIMSLAVE::ckput(os, m_last_scl);
+		I2CSIMSLAVE::ckput(os, m_last_sda);
+		I2CSIMSLAVE::ckput(os, m_addressing);
+		I2CSIMSLAVE::ckput(os, m_busy);
+		I2CSIMSLAVE::ckput(os, m_illegal);
+		I2CSIMSLAVE::ckput(os, m_nak);
+		I2CSIMSLAVE::ckput(os, m_tick);
+		I2CSIMSLAVE::ckput(os, m_protocol_errs);
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				m_devices[k]->save(os);
+	}
+
+	template<class IS>	void	restore(IS &is) {
+		int	active;
+
+		I2CSIMSLAVE::ckget(is, active);
+		I2CSIMSLAVE::ckget(is, m_devword);
+		I2CSIMSLAVE::ckget(is, m_nbits);
+		I2CSIMSLAVE::ckget(is, m_in_scl);
+		I2CSIMSLAVE::ckget(is, m_in_sda);
+		I2CSIMSLAVE::ckget(is, m_last_scl);
+		I2CSIMSLAVE::ckget(is, m_last_sda);
+		I2CSIMSLAVE::ckget(is, m_addressing);
+		I2CSIMSLAVE::ckget(is, m_busy);
+		I2CSIMSLAVE::ckget(is, m_illegal);
+		I2CSIMSLAVE::ckget(is, m_nak);
+		I2CSIMSLAVE::ckget(is, m_tick);
+		I2CSIMSLAVE::ckget(is, m_protocol_errs);
+		m_active = (active >= 0) ? m_devices[active & 0x07f] : NULL;
+		for(int k=0; k<128; k++)
+			if (m_devices[k])
+				m_devices[k]->restore(is);
+	}
+	// }}}
+};
+// }}}
+
+// I2CSIMMASTER
+// {{{
+// A competing bus master, for exercising arbitration.  Placed on the same
+// wired-AND bus as the master under test, it starts transactions of its own
+// at (random) intervals: a device word, and then a random number of bytes
+// either written to, or read from, its target.  It waits for the bus to be
+// free before each START, synchronizes its clock with any other master, and
+// backs off until the next STOP whenever it loses arbitration.
+//
+// Each tick, call it with the resolved bus.  It returns what it will drive
+// on the next tick.
+typedef	enum { I2CM_IDLE=0, I2CM_WAITFREE, I2CM_START, I2CM_BITLO,
+	I2CM_BITHI, I2CM_STOPLO, I2CM_STOPHI, I2CM_LOST
+} I2CMSTATE;
+
+class	I2CSIMMASTER {
+	TBRAND		m_rng;
+	I2CMSTATE	m_state;
+	I2CBUS		m_out, m_last;
+	int		m_devaddr, m_maxlen, m_halfbit, m_counter,
+			m_nbits, m_nbytes, m_len, m_sreg, m_holdoff,
+			m_minhold, m_maxhold;
+	bool		m_read, m_busy, m_nak;
+	unsigned long	m_period, m_next, m_tick,
+			m_attempts, m_completed, m_lost, m_naks;
+
+	void	schedule(void) {
+		// Uniformly distributed, with a mean of m_period
+		m_next = m_tick + m_period/2 + m_rng.range(m_period+1);
+	}
+	// Load the next byte to go out, and start its first bit
+	void	nxtbyte(void);
+	// True if we are the one driving SDA during the current bit: the
+	// device word, written data, and our own ACKs of read data
+	bool	transmitting(void) const {
+		if (m_nbits < 8)
+			return (m_nbytes == 0)||(!m_read);
+		return (m_nbytes > 0)&&(m_read);
+	}
+public:
+	I2CSIMMASTER(const int devaddr = 0x50, unsigned long period = 100000,
+			const int halfbit = 50, uint64_t seed = 1)
+		: m_rng(seed), m_state(I2CM_IDLE), m_devaddr(devaddr & 0x07f),
+		m_maxlen(4), m_halfbit(halfbit), m_counter(0), m_nbits(0),
+		m_nbytes(0), m_len(0), m_sreg(0), m_holdoff(0),
+		m_minhold(2*halfbit), m_maxhold(2*halfbit), m_read(false),
+		m_busy(false), m_nak(false), m_period(period), m_tick(0),
+		m_attempts(0), m_completed(0), m_lost(0), m_naks(0) {
+		schedule();
+	}
+
+	I2CBUS	operator()(const I2CBUS bus);
+	I2CBUS	outputs(void) const { return m_out; }
+
+	// Configuration
+	// {{{
+	// The device to address, the mean number of ticks between the
+	// starts of our transactions, the ticks per half SCL period, and the
+	// largest number of data bytes per transaction
+	void	target(const int devaddr) { m_devaddr = devaddr & 0x07f; }
+	void	period(unsigned long ticks) {
+		m_period = ticks;
+		schedule();
+	}
+	void	halfbit(const int ticks) { m_halfbit = (ticks > 0) ? ticks:1; }
+	void	maxlen(const int ln) { m_maxlen = (ln > 0) ? ln : 1; }
+
+	// How long the bus must sit free before we'll START.  A polite master
+	// waits a full bit period.  Picking a (random) wait from a range
+	// instead, one reaching down towards zero, makes it much more likely
+	// that we'll START together with the master under test--and so must
+	// arbitrate for the bus.
+	void	holdoff(const int mn, const int mx) {
+		m_minhold = (mn > 0) ? mn : 1;
+		m_maxhold = (mx > m_minhold) ? mx : m_minhold;
+	}
+	// }}}
+
+	// True from our START until our STOP, or until we lose the bus
+	bool	active(void) const {
+		return (m_state != I2CM_IDLE)&&(m_state != I2CM_WAITFREE)
+			&&(m_state != I2CM_LOST);
+	}
+
+	// Statistics
+	// {{{
+	unsigned long	attempts(void) const { return m_attempts; }
+	unsigned long	completed(void) const { return m_completed; }
+	unsigned long	lost(void) const { return m_lost; }
+	unsigned long	naks(void) const { return m_naks; }
+	// }}}
+};
+// }}}
+
 #endif
@@ -0,0 +1,303 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2csim_lanes.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Checks the multi-lane slave model, I2CSIMLANES, against the
+//		scalar I2CSIMSLAVE, lane by lane, and then compares their
+//	speed.  Each lane is given its own randomized scenario: a device
+//	address, a clock stretch and hold time, and a competing master
+//	(I2CSIMMASTER) of its own speed, reading and writing random lengths
+//	to either the lane's slave or (sometimes) some other address.  With
+//	-g, single tick glitches are also injected into each lane, so that
+//	the protocol checks get exercised.  Every tick, the bus driven by
+//	and the state of every lane must match that of its scalar twin.
+//	
+//	Once checked, the stimulus is replayed into each model alone, to
+//	measure the slave ticks per second of each.
+//	
+//	No Verilator model is needed, so this may be built and run on its own.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#include "tbrand.h"
+#include "i2csim.h"
+#include "i2clanes.h"
+
+#define	DEFAULT_TICKS	1000000ul
+#define	DEFAULT_LANES	64
+
+void	usage(void) {
+	printf("USAGE: i2csim_lanes [-h] [-w <lanes>] [-n <ticks>] [-a <bytes>] [-g <prob>]\n"
+"\t\t[-s <seed>]\n"
+"\n"
+"\t-a <bytes>\tThe number of register address bytes each slave\n"
+"\t\texpects, 1 (the default) or 2\n"
+"\t-w <lanes>\tThe number of lanes, or independent buses, to simulate at\n"
+"\t\tonce: 8, 16, 32, or 64.  Defaults to %d\n"
+"\t-n <ticks>\tThe number of ticks to run for.  Defaults to %lu\n"
+"\t-g <prob>\tThe probability, per tick per lane, of a one tick glitch\n"
+"\t\ton SCL or SDA.  Defaults to zero\n"
+"\t-s <seed>\tSeed the random scenarios with <seed>.  If not given, a\n"
+"\t\tnew seed is chosen.  Either way, the seed is reported so that\n"
+"\t\tany failure can be repeated\n"
+"\n"
+"\tThe lane model costs the same for any number of lanes up to 64, so\n"
+"\tit only beats the scalar model with many lanes.\n"
+"\n"
+"\tIf the last line returns in SUCCESS, then every lane matched\n",
+		DEFAULT_LANES, DEFAULT_TICKS);
+}
+
+static	double	elapsed(const struct timespec &tstart) {
+	struct timespec	tend;
+
+	clock_gettime(CLOCK_MONOTONIC, &tend);
+	return (tend.tv_sec - tstart.tv_sec)
+			+ (tend.tv_nsec - tstart.tv_nsec) * 1e-9;
+}
+
+template <int N> int	run(TBRAND &rng, unsigned long nticks, int abytes,
+		double glitch) {
+	// {{{
+	const int	NBITS = 7;
+	I2CSIMLANES<N>	lanes(0x50, NBITS);
+	I2CSIMSLAVE	*slv[N];
+	I2CSIMMASTER	*mst[N];
+	I2CBUS		mout[N];
+	std::vector<I2CLANEBUS>	stim;
+	unsigned long	nerrs = 0, perrs = 0;
+	struct timespec	tstart;
+	double		tlanes, tscalar;
+
+	// Build each lane's scenario
+	// {{{
+	lanes.address_bytes(abytes);
+	for(int k=0; k<N; k++) {
+		int		devaddr = 0x08 + rng.range(0x70),
+				halfbit = 4 + rng.range(60);
+		I2CSIMTIMING	tm(rng.range(2*halfbit), rng.range(halfbit));
+
+		lanes.address(k, devaddr);
+		lanes.timing(k, tm);
+		slv[k] = new I2CSIMSLAVE(devaddr, NBITS);
+		slv[k]->event_driven(false);
+		slv[k]->protocol(I2CSIM_IGNORE);
+		slv[k]->timing(tm);
+		slv[k]->address_bytes(abytes);
+
+		// Start both memories out the same
+		for(int a=0; a<(1<<NBITS); a++)
+			lanes.memory(k)[a] = (*slv[k])[a] = rng() & 0x0ff;
+
+		mst[k] = new I2CSIMMASTER((rng.range(4) == 0)
+				? (devaddr ^ (1 + rng.range(0x7f))) : devaddr,
+			40*halfbit, halfbit, rng());
+		mst[k]->maxlen(8);
+	}
+	// }}}
+
+	// Run every lane against its scalar twin, tick by tick
+	// {{{
+	stim.reserve(nticks);
+	for(unsigned long t=0; t<nticks && nerrs == 0; t++) {
+		I2CLANEBUS	drv, res;
+
+		for(int k=0; k<N; k++) {
+			I2CBUS	b = mout[k];
+
+			if (glitch > 0 && rng.uniform() < glitch) {
+				if (rng.flip())
+					b.m_scl = 0;
+				else
+					b.m_sda = 0;
+			}
+			drv.lane(k, b);
+		}
+		stim.push_back(drv);
+
+		res = lanes(drv);
+		for(int k=0; k<N; k++) {
+			I2CBUS	r = (*slv[k])(drv.lane(k));
+
+			if (r.m_scl != res.lane(k).m_scl
+					|| r.m_sda != res.lane(k).m_sda
+					|| slv[k]->vstate() != lanes.vstate(k)) {
+				fprintf(stderr, "ERR: Lane %2d, tick %lu: "
+					"SCALAR %d%d (STATE %d) != LANE %d%d (STATE %d)\n",
+					k, t, r.m_scl, r.m_sda,
+					slv[k]->vstate(),
+					res.lane(k).m_scl, res.lane(k).m_sda,
+					lanes.vstate(k));
+				nerrs++;
+			}
+			mout[k] = (*mst[k])(r);
+		}
+	}
+	// }}}
+
+	// Then compare what each lane ended up with
+	// {{{
+	for(int k=0; k<N; k++) {
+		for(int a=0; a<(1<<NBITS); a++) {
+			if (lanes.memory(k)[a] != (*slv[k])[a]) {
+				fprintf(stderr, "ERR: Lane %2d, MEM[%02x]: "
+					"SCALAR %02x != LANE %02x\n", k, a,
+					(*slv[k])[a] & 0x0ff,
+					lanes.memory(k)[a] & 0x0ff);
+				nerrs++;
+			}
+		}
+
+		if (slv[k]->protocol_errors() != lanes.protocol_errors(k)) {
+			fprintf(stderr, "ERR: Lane %2d: SCALAR %lu != LANE %lu protocol errors\n",
+				k, slv[k]->protocol_errors(),
+				lanes.protocol_errors(k));
+			nerrs++;
+		}
+		perrs += lanes.protocol_errors(k);
+	}
+	// }}}
+
+	// Speed comparison: replay the same stimulus into each model alone
+	// {{{
+	{
+		I2CSIMLANES<N>	tl(0x50, NBITS);
+		I2CSIMSLAVE	*ts[N];
+		unsigned long	acc = 0;
+
+		// The scalar models are left event driven, their fastest
+		tl.address_bytes(abytes);
+		for(int k=0; k<N; k++) {
+			tl.address(k, lanes.address(k));
+			tl.timing(k, slv[k]->timing());
+			ts[k] = new I2CSIMSLAVE(lanes.address(k), NBITS);
+			ts[k]->protocol(I2CSIM_IGNORE);
+			ts[k]->timing(slv[k]->timing());
+			ts[k]->address_bytes(abytes);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &tstart);
+		for(unsigned long t=0; t<stim.size(); t++)
+			acc += tl(stim[t]).m_sda;
+		tlanes = elapsed(tstart);
+
+		clock_gettime(CLOCK_MONOTONIC, &tstart);
+		for(int k=0; k<N; k++) {
+			for(unsigned long t=0; t<stim.size(); t++)
+				acc += (*ts[k])(stim[t].lane(k)).m_sda;
+		}
+		tscalar = elapsed(tstart);
+
+		for(int k=0; k<N; k++)
+			delete ts[k];
+		// Keep the loops above from being optimized away
+		if (acc == 0)
+			printf("(No SDA activity)\n");
+	}
+	// }}}
+
+	printf("%d lanes, %lu ticks each\n", N, (unsigned long)stim.size());
+	for(int k=0; k<N; k++) {
+		printf("Lane %2d: DEV %02x, %5lu attempts, %5lu completed, %5lu NAKs\n",
+			k, lanes.address(k), mst[k]->attempts(),
+			mst[k]->completed(), mst[k]->naks());
+	}
+	printf("Protocol errors:    %lu\n", perrs);
+	printf("Scalar model:       %.3f s, %.3g lane ticks/s\n", tscalar,
+		N * stim.size() / tscalar);
+	printf("Lane model:         %.3f s, %.3g lane ticks/s (%.1fx)\n", tlanes,
+		N * stim.size() / tlanes, tscalar / tlanes);
+
+	for(int k=0; k<N; k++) {
+		delete slv[k];
+		delete mst[k];
+	}
+
+	return (nerrs == 0) ? 0 : 1;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	// {{{
+	unsigned long	nticks = DEFAULT_TICKS;
+	int		nlanes = DEFAULT_LANES, abytes = 1, opt, r;
+	double		glitch = 0.0;
+	const char	*seedstr = NULL;
+	TBRAND		rng;
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "hw:n:a:g:s:")) != -1) {
+		switch(opt) {
+		case 'w': nlanes = atoi(optarg); break;
+		case 'n': nticks = strtoul(optarg, NULL, 0); break;
+		case 'a': abytes = atoi(optarg);
+			if (abytes < 1 || abytes > 2) {
+				fprintf(stderr, "ERR: Invalid address width, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} break;
+		case 'g': glitch = atof(optarg); break;
+		case 's': seedstr = optarg; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	rng.reseed(tbrand_seed(seedstr));
+
+	switch(nlanes) {
+	case  8: r = run< 8>(rng, nticks, abytes, glitch); break;
+	case 16: r = run<16>(rng, nticks, abytes, glitch); break;
+	case 32: r = run<32>(rng, nticks, abytes, glitch); break;
+	case 64: r = run<64>(rng, nticks, abytes, glitch); break;
+	default:
+		fprintf(stderr, "ERR: Unsupported number of lanes, %d\n", nlanes);
+		exit(EXIT_FAILURE);
+	}
+
+	if (r) {
+		printf("FAIL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("SUCCESS!\n");
+	exit(EXIT_SUCCESS);
+}
+// }}}
@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	i2cstats.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Bus utilization and timing statistics for an I2C bus.  Like
+//		I2CMONITOR, I2CSTATS watches the resolved bus on every tick
+//	(and, optionally, what the master is driving), but rather than logging
+//	each event it collects log scale histograms of the SCL high and low
+//	times, the clock stretching on each ACK, and the idle time between a
+//	STOP and the next START.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	I2CSTATS_H
+#define	I2CSTATS_H
+
+#include <stdio.h>
+
+#include "i2csim.h"
+#include "tbhist.h"
+
+class	I2CSTATS {
+	TBHIST		m_scl_high, m_scl_low, m_stretch, m_idle;
+	unsigned long	m_tick, m_busy, m_edge, m_stop, m_stretched;
+	unsigned	m_nbits;
+	bool		m_active, m_stopped;
+	I2CBUS		m_last;
+
+public:
+	I2CSTATS(void) : m_tick(0), m_busy(0), m_edge(0), m_stop(0),
+			m_stretched(0), m_nbits(0), m_active(false),
+			m_stopped(false) {}
+
+	void	operator()(const I2CBUS bus) { (*this)(bus, bus); }
+	void	operator()(const I2CBUS master, const I2CBUS bus) {
+		m_tick++;
+		if (m_active)
+			m_busy++;
+
+		// Ticks the master wants SCL high, yet a slave holds it low
+		if (m_active && master.m_scl && !bus.m_scl)
+			m_stretched++;
+
+		if (bus.m_scl && m_last.m_scl && bus.m_sda != m_last.m_sda) {
+			if (!bus.m_sda) {
+				// START, or repeated START
+				if (!m_active && m_stopped)
+					m_idle.add(m_tick - m_stop);
+				m_active = true;
+				m_nbits = 0;
+			} else if (m_active) {
+				m_active = false;
+				m_stopped = true;
+				m_stop = m_tick;
+			}
+		} else if (m_active && bus.m_scl != m_last.m_scl) {
+			// Only time full clock periods, within a transaction
+			if (bus.m_scl) {
+				if (m_nbits > 0)
+					m_scl_low.add(m_tick - m_edge);
+				if (++m_nbits == 9) {
+					m_stretch.add(m_stretched);
+					m_nbits = 0;
+				}
+				m_stretched = 0;
+			} else if (m_nbits > 0)
+				m_scl_high.add(m_tick - m_edge);
+			m_edge = m_tick;
+		}
+
+		m_last = bus;
+	}
+
+	unsigned long	ticks(void) const { return m_tick; }
+	unsigned long	busy(void) const { return m_busy; }
+	const TBHIST	&scl_high(void) const { return m_scl_high; }
+	const TBHIST	&scl_low(void) const { return m_scl_low; }
+	const TBHIST	&stretch(void) const { return m_stretch; }
+	const TBHIST	&idle(void) const { return m_idle; }
+
+	void	dump(FILE *fp) const {
+		fprintf(fp, "I2C bus utilization: %lu of %lu ticks, %.2f%%\n",
+			m_busy, m_tick, (m_tick) ? 100.0 * m_busy / m_tick : 0);
+		m_scl_high.dump(fp, "SCL high time");
+		m_scl_low.dump(fp,  "SCL low time");
+		m_stretch.dump(fp,  "Clock stretch, per ACK");
+		m_idle.dump(fp,     "Idle, STOP to START");
+	}
+};
+
+#endif
@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	regress.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Declares the randomized scenarios run by the wbi2c_regress
+//		regression runner.  Each scenario builds its own test bench,
+//	runs a number of randomly chosen transfers from the given seed, and
+//	returns the number of errors found.  A given seed will always produce
+//	the same scenario.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	REGRESS_H
+#define	REGRESS_H
+
+typedef	struct {
+	unsigned	m_seed;		// Seed for this scenario
+	unsigned	m_transfers;	// Number of transfers to run
+	bool		m_verbose;	// Describe each transfer
+	bool		m_fast;		// Use transaction level slave models
+	const char	*m_trace;	// Trace file name, or NULL for none
+} REGRESS;
+
+// Exercise the I2C master, wbi2cmaster, against a slave model
+extern	int	i2cm_scenario(const REGRESS &rg);
+
+// Exercise the I2C slave, wbi2cslave, from a bit-banged master
+extern	int	i2cs_scenario(const REGRESS &rg);
+
+#endif
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	regress_i2cm.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A randomized regression scenario for the I2C master.  The bus
+//		speed is chosen from the seed, and then each transfer picks a
+//	random direction, starting address, and length.  Writes check that
+//	the slave model received what the master was given, and reads check
+//	that the master's memory matches what the slave model held.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "verilated.h"
+#include "Vwbi2cmaster.h"
+
+#include "testb.h"
+#include "tbrand.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "wbi2cm_tb.h"
+#include "regress.h"
+
+// Load the master's memory from a byte buffer.  The memory is big endian.
+static	void	load_mem(I2CM_TB *tb, const char *buf) {
+	unsigned	words[FULMEMSZ/4];
+
+	for(unsigned k=0; k<FULMEMSZ/4; k++)
+		words[k] = ((buf[4*k  ]&0x0ff)<<24)|((buf[4*k+1]&0x0ff)<<16)
+			  |((buf[4*k+2]&0x0ff)<< 8)| (buf[4*k+3]&0x0ff);
+	tb->wb_write(R_MEM, FULMEMSZ/4, words);
+}
+
+int	i2cm_scenario(const REGRESS &rg) {
+	// {{{
+	I2CM_TB		*tb;
+	unsigned	speed;
+	char		buf[FULMEMSZ];
+	int		nerrs = 0;
+	TBRAND		rng(rg.m_seed);
+
+	tb = new I2CM_TB();
+	tb->i2cbus().transaction_level(rg.m_fast);
+	tb->reset();
+	if (rg.m_trace)
+		tb->opentrace(rg.m_trace);
+
+	// Each scenario runs at its own speed, with or without clock
+	// stretching from the slave
+	speed = 8 + rng.range(93);
+	tb->wb_write(R_SPEED, speed);
+	if (rng.flip())
+		tb->slave().stretch(0);
+	if (rg.m_verbose)
+		printf("I2CM-SEED %u: SPEED = %d, STRETCH = %d\n", rg.m_seed,
+			speed, tb->slave().timing().m_stretch);
+
+	for(unsigned t=0; t<rg.m_transfers && nerrs == 0; t++) {
+		unsigned	addr, ln, status;
+		unsigned long	timeout;
+		bool		rd;
+
+		addr = rng() & CMEMMSK;
+		ln   = 1 + rng.range(CMEMMSK);
+		rd   = rng.flip();
+
+		rng.fill(FULMEMSZ, buf);
+
+		if (rg.m_verbose)
+			printf("I2CM-SEED %u, #%d: %s ADDR=0x%02x, LEN=%d\n",
+				rg.m_seed, t, (rd) ? "READ ":"WRITE", addr, ln);
+
+		if (rd) {
+			for(unsigned k=0; k<FULMEMSZ; k++)
+				tb->slave()[k] = buf[k];
+			tb->wb_write(R_CMD, READCMD(SLAVE_ADDRESS, addr, ln));
+		} else {
+			load_mem(tb, buf);
+			tb->wb_write(R_CMD, WRITECMD(SLAVE_ADDRESS, addr, ln));
+		}
+
+		// Roughly 40 quarter-bit periods per byte, plus the device
+		// and address bytes, plus any clock stretching
+		timeout = tb->m_tickcount + 100000
+				+ (unsigned long)speed * 40 * (ln + 4);
+		tb->tick();
+		tb->tick();
+		while(0 == tb->m_core->o_int && tb->m_tickcount < timeout)
+			tb->tick();
+
+		if (0 == tb->m_core->o_int) {
+			printf("I2CM-SEED %u, #%d: TIMEOUT\n", rg.m_seed, t);
+			nerrs++;
+			break;
+		}
+
+		status = tb->wb_read(R_CMD);
+		if (status != WRITECMD(SLAVE_ADDRESS, addr+ln, 0)) {
+			printf("I2CM-SEED %u, #%d: BAD STATUS, %08x != %08x\n",
+				rg.m_seed, t, status,
+				WRITECMD(SLAVE_ADDRESS, addr+ln, 0));
+			nerrs++;
+		}
+
+		for(unsigned k=0; k<ln; k++) {
+			unsigned a = (addr + k) & CMEMMSK;
+			unsigned char	exp = buf[a] & 0x0ff,
+					got = (rd) ? (*tb)[a]
+						: (tb->slave()[a] & 0x0ff);
+
+			if (exp != got) {
+				printf("I2CM-SEED %u, #%d: MISMATCH AT 0x%02x, %02x != %02x (expected)\n",
+					rg.m_seed, t, a, got, exp);
+				nerrs++;
+			}
+		}
+
+		// Leave the bus idle for a bit between transfers
+		for(unsigned k=0; k<speed * 8; k++)
+			tb->tick();
+	}
+
+	if (tb->bombed()) {
+		printf("I2CM-SEED %u: BUS BOMB\n", rg.m_seed);
+		nerrs++;
+	}
+
+	delete tb;
+	return nerrs;
+}
+// }}}
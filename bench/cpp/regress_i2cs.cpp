@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	regress_i2cs.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A randomized regression scenario for the I2C slave.  The bit
+//		rate of the test bench's master is chosen from the seed, and
+//	then each transfer picks a random direction, starting address, and
+//	length.  Writes check the slave's memory via its internal state, and
+//	reads check the bytes received against what was loaded over
+//	Wishbone.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "verilated.h"
+#include "Vwbi2cslave.h"
+
+#include "testb.h"
+#include "tbrand.h"
+#include "wb_tb.h"
+#include "wbi2cs_tb.h"
+#include "regress.h"
+
+int	i2cs_scenario(const REGRESS &rg) {
+	// {{{
+	I2CS_TB		*tb;
+	unsigned	halfwait;
+	char		buf[FULMEMSZ], rbuf[FULMEMSZ];
+	int		nerrs = 0;
+	TBRAND		rng(rg.m_seed);
+
+	tb = new I2CS_TB();
+	tb->reset();
+	if (rg.m_trace)
+		tb->opentrace(rg.m_trace);
+
+	halfwait = 8 + rng.range(17);
+	tb->i2c_speed(halfwait);
+	if (rg.m_verbose)
+		printf("I2CS-SEED %u: HALFWAIT = %d\n", rg.m_seed, halfwait);
+
+	tb->i2c_idle();
+
+	for(unsigned t=0; t<rg.m_transfers && nerrs == 0; t++) {
+		unsigned	addr, ln;
+		bool		rd;
+
+		addr = rng() & (FULMEMSZ-1);
+		ln   = 1 + rng.range(FULMEMSZ);
+		rd   = rng.flip();
+
+		rng.fill(FULMEMSZ, buf);
+
+		if (rg.m_verbose)
+			printf("I2CS-SEED %u, #%d: %s ADDR=0x%02x, LEN=%d\n",
+				rg.m_seed, t, (rd) ? "READ ":"WRITE", addr, ln);
+
+		if (rd) {
+			unsigned	words[FULMEMSZ/4];
+
+			// The memory is big endian
+			for(unsigned k=0; k<FULMEMSZ/4; k++)
+				words[k] = ((buf[4*k  ]&0x0ff)<<24)
+					|((buf[4*k+1]&0x0ff)<<16)
+					|((buf[4*k+2]&0x0ff)<< 8)
+					| (buf[4*k+3]&0x0ff);
+			tb->wb_write(0, FULMEMSZ/4, words);
+
+			tb->i2c_read(addr, ln, rbuf);
+			for(unsigned k=0; k<ln; k++) {
+				unsigned a = (addr + k) & (FULMEMSZ-1);
+
+				if ((rbuf[k] ^ buf[a]) & 0x0ff) {
+					printf("I2CS-SEED %u, #%d: MISMATCH AT 0x%02x, %02x != %02x (expected)\n",
+						rg.m_seed, t, a,
+						rbuf[k] & 0x0ff, buf[a] & 0x0ff);
+					nerrs++;
+				}
+			}
+		} else {
+			tb->i2c_write(addr, ln, buf);
+			for(unsigned k=0; k<ln; k++) {
+				unsigned a = (addr + k) & (FULMEMSZ-1);
+
+				if (((*tb)[a] ^ buf[k]) & 0x0ff) {
+					printf("I2CS-SEED %u, #%d: MISMATCH AT 0x%02x, %02x != %02x (expected)\n",
+						rg.m_seed, t, a,
+						(*tb)[a] & 0x0ff, buf[k] & 0x0ff);
+					nerrs++;
+				}
+			}
+		}
+
+		tb->i2c_idle();
+	}
+
+	if (tb->bombed()) {
+		printf("I2CS-SEED %u: BUS BOMB\n", rg.m_seed);
+		nerrs++;
+	}
+
+	delete tb;
+	return nerrs;
+}
+// }}}
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	tbhist.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A simple log scale histogram, for collecting the distributions of
+//		bus timings and latencies within the test benches.  Bin zero
+//	holds zero, and bin k holds values from 2^(k-1) through 2^k-1.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TBHIST_H
+#define	TBHIST_H
+
+#include <stdio.h>
+#include <limits.h>
+
+#define	TBHIST_BINS	65
+
+class	TBHIST {
+	unsigned long	m_bins[TBHIST_BINS], m_count, m_min, m_max;
+	double		m_sum;
+
+	static	int	bin(unsigned long v) {
+		return (v == 0) ? 0 : (int)(sizeof(long)*8) - __builtin_clzl(v);
+	}
+public:
+	TBHIST(void) { clear(); }
+
+	void	clear(void) {
+		for(int k=0; k<TBHIST_BINS; k++)
+			m_bins[k] = 0;
+		m_count = 0;
+		m_min = ULONG_MAX;
+		m_max = 0;
+		m_sum = 0;
+	}
+
+	void	add(unsigned long v) {
+		m_bins[bin(v)]++;
+		m_count++;
+		m_sum += v;
+		if (v < m_min)
+			m_min = v;
+		if (v > m_max)
+			m_max = v;
+	}
+
+	unsigned long	count(void) const { return m_count; }
+	unsigned long	min(void) const { return (m_count) ? m_min : 0; }
+	unsigned long	max(void) const { return m_max; }
+	double		sum(void) const { return m_sum; }
+	double		mean(void) const {
+		return (m_count) ? m_sum / m_count : 0.0;
+	}
+
+	// Print a summary line, followed by one line per (non-empty) bin
+	void	dump(FILE *fp, const char *name) const {
+		fprintf(fp, "%-28s %10lu samples, min %lu, mean %.1f, max %lu\n",
+			name, m_count, min(), mean(), m_max);
+		for(int k=0; k<TBHIST_BINS; k++) {
+			unsigned long	lo, hi;
+			int		bar;
+
+			if (!m_bins[k])
+				continue;
+			lo = (k == 0) ? 0 : (1ul << (k-1));
+			hi = (k == 0) ? 0 : (lo << 1) - 1;
+			bar = (int)(40.0 * m_bins[k] / m_count + 0.5);
+			fprintf(fp, "\t%10lu - %-10lu %10lu %6.2f%% %.*s\n",
+				lo, hi, m_bins[k], 100.0 * m_bins[k] / m_count,
+				bar, "########################################");
+		}
+	}
+};
+
+#endif
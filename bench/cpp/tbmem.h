@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	tbmem.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The storage behind the simulated bus memories, WBMEM and
+//		AXILMEM: a byte addressed memory, which scripts may be loaded
+//	into straight from i2casm, in either its binary (-b) or its (default)
+//	hex word output format, and read and written a bus word (big endian)
+//	at a time.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TBMEM_H
+#define	TBMEM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+class	TBMEM {
+protected:
+	unsigned char	*m_mem;
+	unsigned long	m_size;
+
+	// Bus words are big endian, the width of BW
+	template<class BW>	BW	rdword(unsigned long waddr) const {
+		const unsigned char	*ptr = &m_mem[waddr * sizeof(BW)];
+		BW	v = 0;
+
+		for(unsigned k=0; k<sizeof(BW); k++)
+			v = (v << 8) | ptr[k];
+		return v;
+	}
+
+	template<class BW>	void	wrword(unsigned long waddr, BW v,
+				unsigned sel) {
+		unsigned char	*ptr = &m_mem[waddr * sizeof(BW)];
+
+		// SEL's MSB selects the lowest byte address
+		for(int k=sizeof(BW)-1; k>=0; k--) {
+			if (sel & 1)
+				ptr[k] = v & 0x0ff;
+			sel >>= 1;
+			v >>= 8;
+		}
+	}
+
+public:
+	TBMEM(const int lgsize) {
+		m_size = 1ul << lgsize;
+		m_mem = new unsigned char[m_size];
+		memset(m_mem, 0, m_size);
+	}
+
+	virtual	~TBMEM(void) {
+		delete[] m_mem;
+	}
+
+	// load
+	// {{{
+	// Load an i2casm script into memory at the byte address given.  Both
+	// the binary (i2casm -b) and the hex word (default) output formats
+	// are accepted.  Returns the number of bytes loaded.
+	unsigned	load(const char *fname, unsigned addr) {
+		FILE		*fp;
+		unsigned char	*buf;
+		unsigned	nr, ln;
+		bool		hex = true;
+
+		fp = fopen(fname, "r");
+		if (NULL == fp) {
+			fprintf(stderr, "ERR: Cannot open %s\n", fname);
+			perror("O/S Err:");
+			exit(EXIT_FAILURE);
+		}
+
+		buf = new unsigned char[m_size];
+		nr = fread(buf, 1, m_size, fp);
+		fclose(fp);
+
+		for(unsigned k=0; k<nr && hex; k++)
+			if (!isxdigit(buf[k]) && !isspace(buf[k]))
+				hex = false;
+
+		if (hex) {
+			// Hex files consist of 32-bit words, big endian
+			char	*ptr, *end;
+
+			buf[(nr < m_size) ? nr : m_size-1] = '\0';
+			ln = 0;
+			ptr = (char *)buf;
+			do {
+				unsigned long	v = strtoul(ptr, &end, 16);
+
+				if (end == ptr)
+					break;
+				ptr = end;
+				for(int b=3; b>=0; b--)
+					buf[ln++] = (v >> (8*b)) & 0x0ff;
+			} while(*ptr);
+		} else
+			ln = nr;
+
+		if (addr + ln > m_size) {
+			fprintf(stderr, "ERR: %s doesn\'t fit in memory\n", fname);
+			exit(EXIT_FAILURE);
+		}
+
+		memcpy(&m_mem[addr], buf, ln);
+		delete[] buf;
+
+		return ln;
+	}
+	// }}}
+
+	unsigned char	&operator[](unsigned addr) {
+		return m_mem[addr & (m_size-1)];
+	}
+
+	unsigned long	size(void) const { return m_size; }
+};
+
+#endif
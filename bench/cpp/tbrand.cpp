@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	tbrand.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The out-of-line portions of the test bench pseudo-random number
+//		generator.  See tbrand.h for details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tbrand.h"
+
+void	TBRAND::reseed(uint64_t seed) {
+	// {{{
+	uint64_t	z = seed;
+
+	m_seed = seed;
+
+	// Expand the seed into the full state with splitmix64, so that even
+	// small or similar seeds produce unrelated streams
+	for(int k=0; k<4; k++) {
+		uint64_t	v;
+
+		z += 0x9e3779b97f4a7c15ull;
+		v = z;
+		v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ull;
+		v = (v ^ (v >> 27)) * 0x94d049bb133111ebull;
+		m_state[k] = v ^ (v >> 31);
+	}
+}
+// }}}
+
+void	TBRAND::fill(unsigned nc, char *buf) {
+	// {{{
+	unsigned	k = 0;
+
+	for(; k+8 <= nc; k += 8) {
+		uint64_t	v = next();
+
+		memcpy(&buf[k], &v, 8);
+	}
+
+	if (k < nc) {
+		uint64_t	v = next();
+
+		memcpy(&buf[k], &v, nc-k);
+	}
+}
+// }}}
+
+uint64_t	tbrand_seed(const char *str) {
+	// {{{
+	uint64_t	seed;
+
+	if (str) {
+		char	*end;
+
+		seed = strtoull(str, &end, 0);
+		if (end == str || *end != '\0') {
+			fprintf(stderr, "ERR: Invalid seed, %s\n", str);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		struct timespec	now;
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		seed = ((uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec)
+			^ ((uint64_t)getpid() << 32);
+	}
+
+	printf("SEED: 0x%016lx\n", (unsigned long)seed);
+	return seed;
+}
+// }}}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	tbrand.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A small, fast, seeded pseudo-random number generator shared by
+//		the test benches.  Given the same seed, it always produces the
+//	same stream, so that any randomized failure can be replayed by rerunning
+//	with the seed the test bench logged.  The generator is xoshiro256**,
+//	seeded via splitmix64.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TBRAND_H
+#define	TBRAND_H
+
+#include <stdint.h>
+
+class	TBRAND {
+	uint64_t	m_seed, m_state[4];
+public:
+	TBRAND(uint64_t seed = 1) { reseed(seed); }
+
+	// Restart the stream from the given seed
+	void		reseed(uint64_t seed);
+	uint64_t	seed(void) const { return m_seed; }
+
+	// The next 64 bits of the stream
+	uint64_t	next(void) {
+		const uint64_t	result = rotl(m_state[1] * 5, 7) * 9,
+				t = m_state[1] << 17;
+
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= t;
+		m_state[3] = rotl(m_state[3], 45);
+
+		return result;
+	}
+
+	// A 32-bit random number
+	uint32_t	operator()(void) { return (uint32_t)(next() >> 32); }
+
+	// A random number in the range 0 ... n-1
+	unsigned	range(unsigned n) {
+		return (unsigned)(((next() >> 32) * (uint64_t)n) >> 32);
+	}
+
+	bool		flip(void) { return (next() >> 63) != 0; }
+
+	// A random number uniformly distributed over [0,1)
+	double		uniform(void) { return (next() >> 11) * 0x1.0p-53; }
+
+	// Fill a buffer with random bytes, eight at a time
+	void		fill(unsigned nc, char *buf);
+
+	// Checkpoint the stream, so that it may later pick up where it left
+	// off, to any stream with write() and read() methods (see I2CSIMSLAVE)
+	template<class OS>	void	save(OS &os) const {
+		os.write(&m_seed, sizeof(m_seed));
+		os.write(m_state, sizeof(m_state));
+	}
+
+	template<class IS>	void	restore(IS &is) {
+		is.read(&m_seed, sizeof(m_seed));
+		is.read(m_state, sizeof(m_state));
+	}
+
+private:
+	static uint64_t	rotl(const uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+// Parse a seed given on the command line.  If no seed is given (str is NULL),
+// a new seed is made up from the time and the process ID.  Either way, the
+// seed is logged so the run may be repeated.
+extern	uint64_t	tbrand_seed(const char *str);
+
+#endif
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	tbsnapshot.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	In memory checkpoints of a Verilated model and its test bench.
+//		A TBSNAPSHOT is nothing more than a growable buffer of bytes.
+//	TBSNAPSAVE and TBSNAPLOAD adapt it to the serializer interfaces
+//	Verilator provides for save and restore, so that TESTB<>::snapshot()
+//	and resume() can checkpoint to memory rather than to a file.  Resuming
+//	from memory allows many scenarios to start from the same (warmed up)
+//	state, one after another, without touching the disk.
+//
+//	Requires a model built with --savable (SAVABLE=1 in the Makefiles).
+//	These rely upon the (protected) buffer pointers within Verilator's
+//	VerilatedSerialize and VerilatedDeserialize classes, just as Verilator's
+//	own VerilatedSave and VerilatedRestore file classes do.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TBSNAPSHOT_H
+#define	TBSNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <verilated_save.h>
+
+class	TBSNAPSHOT {
+	char	*m_buf;
+	size_t	m_len, m_size;
+
+	// Snapshots may be large, so they are never copied by accident
+	TBSNAPSHOT(const TBSNAPSHOT &);
+	TBSNAPSHOT &operator=(const TBSNAPSHOT &);
+public:
+	TBSNAPSHOT(void) : m_buf(NULL), m_len(0), m_size(0) {}
+	~TBSNAPSHOT(void) { free(m_buf); }
+
+	void	clear(void) { m_len = 0; }
+	size_t	size(void) const { return m_len; }
+	bool	empty(void) const { return m_len == 0; }
+	const char *data(void) const { return m_buf; }
+
+	void	append(const void *d, size_t ln) {
+		if (m_len + ln > m_size) {
+			m_size = (m_size) ? m_size : 65536;
+			while(m_len + ln > m_size)
+				m_size *= 2;
+			m_buf = (char *)realloc(m_buf, m_size);
+			if (!m_buf) {
+				fprintf(stderr, "ERR: Cannot allocate %lu bytes for a snapshot\n", (unsigned long)m_size);
+				exit(EXIT_FAILURE);
+			}
+		}
+		memcpy(m_buf+m_len, d, ln);
+		m_len += ln;
+	}
+};
+
+// Writes everything serialized to it into a (cleared) snapshot.  The last
+// of it is only written on flush(), or once this is destroyed.
+class	TBSNAPSAVE : public VerilatedSerialize {
+	TBSNAPSHOT	&m_snap;
+public:
+	TBSNAPSAVE(TBSNAPSHOT &snap) : m_snap(snap) { m_snap.clear(); }
+	virtual	~TBSNAPSAVE(void) { flush(); }
+
+	virtual	void	flush(void) {
+		m_snap.append(m_bufp, m_cp - m_bufp);
+		m_cp = m_bufp;
+	}
+};
+
+// Reads back from a snapshot, from its beginning
+class	TBSNAPLOAD : public VerilatedDeserialize {
+	const TBSNAPSHOT	&m_snap;
+	size_t			m_pos;
+public:
+	TBSNAPLOAD(const TBSNAPSHOT &snap) : m_snap(snap), m_pos(0) {
+		m_cp = m_endp = m_bufp;
+	}
+
+	// Bytes remaining, never having been read
+	size_t	remaining(void) const {
+		return (m_snap.size() - m_pos) + (m_endp - m_cp);
+	}
+
+protected:
+	virtual	void	fill(void) {
+		size_t	left = m_endp - m_cp, ln;
+
+		// Keep anything not yet read, and top up the buffer after it
+		memmove(m_bufp, m_cp, left);
+		m_cp   = m_bufp;
+		m_endp = m_bufp + left;
+
+		ln = m_snap.size() - m_pos;
+		if (ln > bufferSize() - left)
+			ln = bufferSize() - left;
+		memcpy(m_endp, m_snap.data() + m_pos, ln);
+		m_endp += ln;
+		m_pos  += ln;
+	}
+};
+
+#endif
@@ -7,6 +7,41 @@
 // Purpose:	A wrapper for a common interface to a clocked FPGA core
 //		begin exercised in Verilator.
 //
+//	Tracing is conditional.  Once opentrace() has been called, ticks are
+//	only written to the VCD file if they fall within the window set by
+//	trace_window(), and (if requested via trace_wait()) only after the
+//	trigger() method has first returned true.  If trace_ring() is given a
+//	non-zero depth, the trace alternates between two files, each holding
+//	at most that many ticks, so that the last ticks before a failure are
+//	always kept without the trace growing without bound.
+//
+//	The trace is flushed every trace_flush() ticks, as well as whenever
+//	the trigger fires or a new file (or ring segment) is opened.  Since
+//	most failures are assert()s that never call closetrace(), every open
+//	trace is also closed on exit(), and flushed on abort() (SIGABRT), so
+//	the ticks leading up to the failure are kept.
+//
+//	Traces may be written in either VCD or FST format, depending upon the
+//	trace_format() given or, by default, the extension of the file name.
+//	Verilator builds a model with support for one of these formats only,
+//	as selected by VM_TRACE_VCD and VM_TRACE_FST (see TRACE=fst in the
+//	Makefiles).  The depth of the trace, and the part of the hierarchy it
+//	covers, may be limited via trace_depth() and trace_scope().
+//
+//	When built with TESTB_SAVABLE defined (SAVABLE=1 in the Makefiles),
+//	the model, the tick count, and whatever state the derived test bench
+//	adds, may be checkpointed to a file or to memory, and later restored,
+//	so that scenarios may start from a warmed up state rather than from
+//	reset.  The trace is not part of the checkpoint.
+//
+//	Test benches whose cores spend long stretches doing nothing but
+//	counting down (a clock divider between I2C bus edges, say) may support
+//	fast-forward, by overriding idle_ticks() and skip_ticks() and calling
+//	skip_idle() at the end of their tick().  Once enabled, via
+//	fast_forward(), such stretches are then stepped over in one call
+//	rather than one clock at a time.  The tick count, and so trace time
+//	stamps, account for every clock skipped.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -41,41 +76,251 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifndef	VM_TRACE_VCD
+#define	VM_TRACE_VCD	1
+#endif
+#ifndef	VM_TRACE_FST
+#define	VM_TRACE_FST	0
+#endif
+
+#if	VM_TRACE_VCD
 #include <verilated_vcd_c.h>
+#endif
+#if	VM_TRACE_FST
+#include <verilated_fst_c.h>
+#endif
+
+#ifdef	TESTB_SAVABLE
+#include "tbsnapshot.h"
+#endif
+
+// The clock and reset inputs of the core.  Cores naming these differently,
+// such as AXI cores with S_AXI_ACLK and an active low S_AXI_ARESETN, may
+// define these before including this file.
+#ifndef	TESTB_CLK
+#define	TESTB_CLK		i_clk
+#endif
+#ifndef	TESTB_RESET
+#define	TESTB_RESET		i_reset
+#endif
+#ifndef	TESTB_RESET_ACTIVE
+#define	TESTB_RESET_ACTIVE	1
+#endif
 
 #define	TBASSERT(TB,A) do { if (!(A)) { (TB).closetrace(); } assert(A); } while(0);
 
-template <class VA>	class TESTB {
+// Number of ticks between flushes of the trace file
+#define	TESTB_FLUSH_TICKS	1024
+
+typedef	enum {
+	TBTRACE_AUTO=0,	// Choose based upon the file name's extension
+	TBTRACE_VCD,
+	TBTRACE_FST
+} TBTRACE;
+
+// TBABORT
+// {{{
+// One process-wide list of the test benches with a trace open, whatever
+// their type, behind a single atexit() hook and a single SIGABRT handler.
+// On exit(), each is closed as usual.  On abort(), as from a failed assert(),
+// each is only flushed: closing a trace means closing files, freeing memory
+// and printing, none of which may be done from within a signal handler.
+class	TBABORT {
+	TBABORT	*m_abort_next;
+
+	static	TBABORT	*&abort_list(void) {
+		static	TBABORT	*head = NULL;
+		return head;
+	}
+
+	static	void	on_exit(void) {
+		TBABORT	*tb;
+
+		while(NULL != (tb = abort_list())) {
+			abort_list() = tb->m_abort_next;
+			tb->abort_close();
+		}
+	}
+
+	static	void	on_abort(int sig) {
+		for(TBABORT *tb = abort_list(); tb; tb = tb->m_abort_next)
+			tb->abort_flush();
+		signal(sig, SIG_DFL);
+		raise(sig);
+	}
+protected:
+	// Add ourselves to the list, or take ourselves off of it
+	void	abort_hook(void) {
+		static	bool	hooked = false;
+
+		if (!hooked) {
+			atexit(on_exit);
+			signal(SIGABRT, on_abort);
+			hooked = true;
+		}
+
+		abort_unhook();
+		m_abort_next = abort_list();
+		abort_list() = this;
+	}
+
+	void	abort_unhook(void) {
+		TBABORT	**pp;
+
+		for(pp = &abort_list(); *pp; pp = &(*pp)->m_abort_next)
+			if (*pp == this) {
+				*pp = m_abort_next;
+				break;
+			}
+		m_abort_next = NULL;
+	}
+
+	// Close the trace on exit().  This runs as any other code would.
+	virtual	void	abort_close(void) = 0;
+
+	// Flush the trace on abort().  This runs within a signal handler.
+	virtual	void	abort_flush(void) = 0;
+public:
+	TBABORT(void) : m_abort_next(NULL) {}
+	virtual	~TBABORT(void) { abort_unhook(); }
+};
+// }}}
+
+template <class VA>	class TESTB : public TBABORT {
 public:
 	VA	*m_core;
-	VerilatedVcdC*	m_trace;
+#if	VM_TRACE_VCD
+	VerilatedVcdC*	m_vcd;
+#endif
+#if	VM_TRACE_FST
+	VerilatedFstC*	m_fst;
+#endif
 	unsigned long	m_tickcount;
 
-	TESTB(void) : m_trace(NULL), m_tickcount(0l) {
+	// Trace control
+	// {{{
+	char		*m_vcdname, *m_trace_scope;
+	unsigned long	m_trace_from, m_trace_until, m_trace_ring,
+			m_trace_flush, m_segment_start, m_last_flush;
+	int		m_segment, m_trace_depth;
+	TBTRACE		m_trace_format;
+	bool		m_triggered, m_flush_now;
+
+	// When keeping a ring, the message telling which segment holds the
+	// last ticks.  It is written up front, so it can be given on abort().
+	char		m_ringmsg[600];
+	// }}}
+
+	bool		m_fast_forward;
+	unsigned long	m_skipped;
+
+	TESTB(void) : m_tickcount(0l), m_vcdname(NULL), m_trace_scope(NULL),
+			m_trace_from(0), m_trace_until(ULONG_MAX),
+			m_trace_ring(0), m_trace_flush(TESTB_FLUSH_TICKS),
+			m_segment_start(0), m_last_flush(0), m_segment(0),
+			m_trace_depth(99), m_trace_format(TBTRACE_AUTO),
+			m_triggered(true), m_flush_now(false),
+			m_fast_forward(false),
+			m_skipped(0) {
+		m_ringmsg[0] = '\0';
+#if	VM_TRACE_VCD
+		m_vcd = NULL;
+#endif
+#if	VM_TRACE_FST
+		m_fst = NULL;
+#endif
 		m_core = new VA;
 		Verilated::traceEverOn(true);
-		m_core->i_clk = 0;
+		m_core->TESTB_CLK = 0;
 		eval(); // Get our initial values set properly.
 	}
 	virtual ~TESTB(void) {
-		if (m_trace) m_trace->close();
+		closetrace();
+		if (m_trace_scope)
+			free(m_trace_scope);
 		delete m_core;
 		m_core = NULL;
 	}
 
 	virtual	void	opentrace(const char *vcdname) {
-		if (!m_trace) {
-			m_trace = new VerilatedVcdC;
-			m_core->trace(m_trace, 99);
-			m_trace->open(vcdname);
+		if (!m_vcdname) {
+			abort_hook();
+			m_vcdname = strdup(vcdname);
+			// Open the file now, if we are already within the
+			// window, otherwise wait until we get there
+			tracing();
 		}
 	}
 
 	virtual	void	closetrace(void) {
-		if (m_trace) {
-			m_trace->close();
-			m_trace = NULL;
+		abort_unhook();
+
+		if (trace_open()) {
+			trace_close();
+#if	VM_TRACE_VCD
+			delete m_vcd;
+			m_vcd = NULL;
+#endif
+#if	VM_TRACE_FST
+			delete m_fst;
+			m_fst = NULL;
+#endif
+
+			if (m_trace_ring)
+				printf("%s", m_ringmsg);
 		}
+
+		if (m_vcdname) {
+			free(m_vcdname);
+			m_vcdname = NULL;
+		}
+	}
+
+	// Only trace ticks from <from> up to (but not including) <until>
+	void	trace_window(unsigned long from, unsigned long until=ULONG_MAX) {
+		m_trace_from  = from;
+		m_trace_until = until;
+	}
+
+	// If set, nothing will be traced until trigger() first returns true
+	void	trace_wait(bool wait) {
+		m_triggered = !wait;
+	}
+
+	// Keep (at least) the last <depth> ticks, rather than everything
+	void	trace_ring(unsigned long depth) {
+		m_trace_ring = depth;
+	}
+
+	// Flush the trace to disk every <nticks> ticks
+	void	trace_flush(unsigned long nticks) {
+		m_trace_flush = (nticks > 0) ? nticks : 1;
+	}
+
+	// The following only take effect when the trace file is (next) opened
+	// {{{
+	void	trace_format(TBTRACE fmt)	{ m_trace_format = fmt; }
+	void	trace_depth(int depth)		{ m_trace_depth = depth; }
+
+	// Only trace the part of the design hierarchy beneath <scope>, such
+	// as "TOP.wbi2cmaster.lowlvl"
+	void	trace_scope(const char *scope) {
+		if (m_trace_scope)
+			free(m_trace_scope);
+		m_trace_scope = (scope) ? strdup(scope) : NULL;
+	}
+	// }}}
+
+	// The trace trigger.  Override this to start tracing on some event
+	// within the design or the test bench.
+	virtual	bool	trigger(void) {
+		return false;
 	}
 
 	virtual	void	eval(void) {
@@ -83,6 +328,8 @@ public:
 	}
 
 	virtual	void	tick(void) {
+		bool	dump;
+
 		m_tickcount++;
 
 		// Make sure we have our evaluations straight before the top
@@ -91,24 +338,312 @@ public:
 		// logic depends.  This forces that logic to be recalculated
 		// before the top of the clock.
 		eval();
-		if (m_trace) m_trace->dump(10*m_tickcount-2);
-		m_core->i_clk = 1;
+		dump = tracing();
+		if (dump) trace_dump(10*m_tickcount-2);
+		m_core->TESTB_CLK = 1;
 		eval();
-		if (m_trace) m_trace->dump(10*m_tickcount);
-		m_core->i_clk = 0;
+		if (dump) trace_dump(10*m_tickcount);
+		m_core->TESTB_CLK = 0;
 		eval();
-		if (m_trace) {
-			m_trace->dump(10*m_tickcount+5);
-			m_trace->flush();
+		if (dump) {
+			trace_dump(10*m_tickcount+5);
+			if (m_flush_now
+				|| m_tickcount - m_last_flush >= m_trace_flush) {
+				trace_flush();
+				m_last_flush = m_tickcount;
+				m_flush_now = false;
+			}
 		}
 	}
 
 	virtual	void	reset(void) {
-		m_core->i_reset = 1;
+		m_core->TESTB_RESET = TESTB_RESET_ACTIVE;
 		tick();
-		m_core->i_reset = 0;
+		m_core->TESTB_RESET = !TESTB_RESET_ACTIVE;
 		// printf("RESET\n");
 	}
+
+	// Fast-forward
+	// {{{
+	void	fast_forward(bool ff) { m_fast_forward = ff; }
+	bool	fast_forward(void) const { return m_fast_forward; }
+
+	// The number of ticks skipped so far, rather than simulated
+	unsigned long	skipped(void) const { return m_skipped; }
+
+	// The number of ticks, following this one, across which nothing in the
+	// core will change save for counters that skip_ticks() can advance,
+	// and across which none of the core's inputs will change.  Zero, the
+	// default, if that can't be promised.
+	virtual	unsigned long	idle_ticks(void) { return 0; }
+
+	// Advance the core's counters, and any models of the test bench's own,
+	// by <nticks> ticks--just as that many calls to tick() would have
+	virtual	void	skip_ticks(unsigned long nticks) {}
+
+	// Step over as many idle ticks as possible.  To be called once the
+	// tick is otherwise complete, models and all.
+	void	skip_idle(void) {
+		unsigned long	nticks;
+
+		if (!m_fast_forward)
+			return;
+		nticks = idle_ticks();
+		if (nticks == 0)
+			return;
+
+		skip_ticks(nticks);
+		m_tickcount += nticks;
+		m_skipped   += nticks;
+
+		// The clock is low throughout, so the trace only needs to
+		// show where the counters ended up
+		eval();
+		if (tracing())
+			trace_dump(10*m_tickcount+5);
+	}
+	// }}}
+
+#ifdef	TESTB_SAVABLE
+	// Checkpoints
+	// {{{
+	// Test benches with C++ models of their own should override
+	// save_state() and restore_state(), calling these first and then
+	// adding their models' state, in the same order in each.  Verilator
+	// will complain (fatally) if a checkpoint is restored into a
+	// different model than saved it.
+	virtual	void	save_state(VerilatedSerialize &os) {
+		os.write(&m_tickcount, sizeof(m_tickcount));
+		os << *m_core;
+	}
+
+	virtual	void	restore_state(VerilatedDeserialize &is) {
+		is.read(&m_tickcount, sizeof(m_tickcount));
+		is >> *m_core;
+		m_last_flush = m_tickcount;
+	}
+
+	void	save(const char *fname) {
+		VerilatedSave	os;
+
+		os.open(fname);
+		if (!os.isOpen()) {
+			fprintf(stderr, "ERR: Cannot write checkpoint, %s\n", fname);
+			perror("O/S Err: ");
+			exit(EXIT_FAILURE);
+		}
+		save_state(os);
+		os.close();
+	}
+
+	void	restore(const char *fname) {
+		VerilatedRestore	is;
+
+		is.open(fname);
+		if (!is.isOpen()) {
+			fprintf(stderr, "ERR: Cannot read checkpoint, %s\n", fname);
+			perror("O/S Err: ");
+			exit(EXIT_FAILURE);
+		}
+		restore_state(is);
+		is.close();
+	}
+
+	// The same, but to (or from) memory
+	void	snapshot(TBSNAPSHOT &snap) {
+		TBSNAPSAVE	os(snap);
+
+		save_state(os);
+		os.flush();
+	}
+
+	void	resume(const TBSNAPSHOT &snap) {
+		TBSNAPLOAD	is(snap);
+
+		restore_state(is);
+		if (is.remaining() != 0) {
+			fprintf(stderr, "ERR: Snapshot doesn't match this test bench\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+#endif
+
+private:
+	// Trace backend
+	// {{{
+	bool	trace_open(void) const {
+#if	VM_TRACE_VCD
+		if (m_vcd) return true;
+#endif
+#if	VM_TRACE_FST
+		if (m_fst) return true;
+#endif
+		return false;
+	}
+
+	void	trace_dump(uint64_t when) {
+#if	VM_TRACE_VCD
+		if (m_vcd) m_vcd->dump(when);
+#endif
+#if	VM_TRACE_FST
+		if (m_fst) m_fst->dump(when);
+#endif
+	}
+
+	void	trace_flush(void) {
+#if	VM_TRACE_VCD
+		if (m_vcd) m_vcd->flush();
+#endif
+#if	VM_TRACE_FST
+		if (m_fst) m_fst->flush();
+#endif
+	}
+
+	void	trace_close(void) {
+#if	VM_TRACE_VCD
+		if (m_vcd) m_vcd->close();
+#endif
+#if	VM_TRACE_FST
+		if (m_fst) m_fst->close();
+#endif
+	}
+
+	void	trace_reopen(const char *fname) {
+#if	VM_TRACE_VCD
+		if (m_vcd) m_vcd->open(fname);
+#endif
+#if	VM_TRACE_FST
+		if (m_fst) m_fst->open(fname);
+#endif
+	}
+
+	// Create the trace object, and attach it to the design
+	void	trace_create(void) {
+		TBTRACE	fmt = m_trace_format;
+
+		if (fmt == TBTRACE_AUTO) {
+			const char *ext = strrchr(m_vcdname, '.');
+			fmt = (ext && strcmp(ext, ".fst")==0)
+				? TBTRACE_FST : TBTRACE_VCD;
+		}
+
+		if (fmt == TBTRACE_FST && !VM_TRACE_FST) {
+			fprintf(stderr, "WARNING: Model built without FST support, writing VCD instead\n");
+			fmt = TBTRACE_VCD;
+		} else if (fmt == TBTRACE_VCD && !VM_TRACE_VCD) {
+			fprintf(stderr, "WARNING: Model built without VCD support, writing FST instead\n");
+			fmt = TBTRACE_FST;
+		}
+
+#if	VM_TRACE_VCD
+		if (fmt == TBTRACE_VCD) {
+			m_vcd = new VerilatedVcdC;
+			if (m_trace_scope)
+				m_vcd->dumpvars(0, m_trace_scope);
+			m_core->trace(m_vcd, m_trace_depth);
+		}
+#endif
+#if	VM_TRACE_FST
+		if (fmt == TBTRACE_FST) {
+			m_fst = new VerilatedFstC;
+			if (m_trace_scope)
+				m_fst->dumpvars(0, m_trace_scope);
+			m_core->trace(m_fst, m_trace_depth);
+		}
+#endif
+	}
+	// }}}
+
+	// abort_close, abort_flush
+	// {{{
+	// See TBABORT
+	void	abort_close(void) {
+		closetrace();
+	}
+
+	void	abort_flush(void) {
+		trace_flush();
+		if (m_trace_ring) {
+			ssize_t	ln = write(STDOUT_FILENO, m_ringmsg,
+						strlen(m_ringmsg));
+			(void)ln;
+		}
+	}
+	// }}}
+
+	// ring_message
+	// {{{
+	void	ring_message(void) {
+		char	prior[256], last[256];
+
+		segment_name(prior, sizeof(prior), m_segment^1);
+		segment_name(last, sizeof(last), m_segment);
+		snprintf(m_ringmsg, sizeof(m_ringmsg),
+			"TRACE: Last ticks in %s, prior ones in %s\n",
+			last, prior);
+	}
+	// }}}
+
+	// segment_name
+	// {{{
+	// When keeping a ring of trace files, the two segments are named by
+	// inserting .0 or .1 before the extension of the trace file name
+	void	segment_name(char *buf, size_t ln, int seg) {
+		const char	*ext = strrchr(m_vcdname, '.');
+
+		if (!m_trace_ring)
+			snprintf(buf, ln, "%s", m_vcdname);
+		else if (ext)
+			snprintf(buf, ln, "%.*s.%d%s", (int)(ext-m_vcdname),
+				m_vcdname, seg, ext);
+		else
+			snprintf(buf, ln, "%s.%d", m_vcdname, seg);
+	}
+	// }}}
+
+	// tracing
+	// {{{
+	// Returns true if this tick should be written to the trace, opening
+	// (or rotating) the trace file as necessary.
+	bool	tracing(void) {
+		char	fname[256];
+
+		if (!m_vcdname)
+			return false;
+		if (!m_triggered) {
+			if (!(m_triggered = trigger()))
+				return false;
+			// Whatever fired the trigger may be about to fail
+			m_flush_now = true;
+		}
+		if (m_tickcount < m_trace_from || m_tickcount >= m_trace_until)
+			return false;
+
+		if (!trace_open()) {
+			trace_create();
+			m_segment = 0;
+			segment_name(fname, sizeof(fname), m_segment);
+			trace_reopen(fname);
+			ring_message();
+			m_segment_start = m_tickcount;
+			m_last_flush = m_tickcount;
+			m_flush_now = true;
+		} else if (m_trace_ring
+				&& m_tickcount - m_segment_start >= m_trace_ring) {
+			// Swap to the other segment, overwriting it
+			trace_close();
+			m_segment ^= 1;
+			segment_name(fname, sizeof(fname), m_segment);
+			trace_reopen(fname);
+			ring_message();
+			m_segment_start = m_tickcount;
+			m_flush_now = true;
+		}
+
+		return true;
+	}
+	// }}}
 };
 
 #endif
@@ -36,22 +36,44 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 // }}}
+#ifndef	WB_TB_H
+#define	WB_TB_H
+
 #include <stdio.h>
 
 #include <verilated.h>
 #include <verilated_vcd_c.h>
 #include "testb.h"
+#include "tbhist.h"
 
 const int	BOMBCOUNT = 32,
 		LGMEMSIZE = 15;
 
+// Logging levels for bus transactions
+typedef	enum {
+	WBLOG_NONE=0,	// Say nothing at all, not even on a timeout
+	WBLOG_ERR,	// Only report bus timeouts (the default)
+	WBLOG_BURST,	// Report one line per burst or single transaction
+	WBLOG_ALL	// Report every word transferred
+} WBLOGLVL;
+
+// One element of a pipelined request list.  On return, read requests will
+// have m_data set to the value returned by the bus.
+typedef	struct {
+	unsigned	m_addr, m_data;
+	bool		m_we;
+} WBREQ;
+
 template <class VA>	class	WB_TB : public TESTB<VA> {
 public:
-	bool	m_bomb;
+	bool		m_bomb;
+	WBLOGLVL	m_log;
+	TBHIST		m_wb_stalls;	// Stall cycles, per bus cycle
 
 	WB_TB(void) {
 		// {{{
 		m_bomb = false;
+		m_log  = WBLOG_ERR;
 		TESTB<VA>::m_core->i_wb_cyc = 0;
 		TESTB<VA>::m_core->i_wb_stb = 0;
 	}
@@ -65,209 +87,161 @@ public:
 	}
 	*/
 
-	unsigned wb_read(unsigned a) {
-		// {{{
+	WBLOGLVL	wb_log(void) const	{ return m_log; }
+	WBLOGLVL	wb_log(WBLOGLVL lvl)	{ return m_log = lvl; }
+
+	// wb_pipeline
+	// {{{
+	// Issue a list of requests, reads and writes in any mix, within a
+	// single bus cycle.  STB is held high from the first request to the
+	// last, so that (absent any stalls) one request is issued per clock.
+	// CYC is dropped on the clock the last acknowledgment is received,
+	// without any further idle clocks.
+	void	wb_pipeline(unsigned n, WBREQ *req) {
+		VA		*core = TESTB<VA>::m_core;
+		unsigned	nreqs = 0, nacks = 0, nstalls = 0;
 		int		errcount = 0;
-		unsigned	result;
-
-		// printf("WB-READM(%08x)\n", a);
 
-		TESTB<VA>::m_core->i_wb_cyc = 1;
-		TESTB<VA>::m_core->i_wb_stb = 1;
-		TESTB<VA>::m_core->i_wb_we  = 0;
-		TESTB<VA>::m_core->i_wb_addr= a;
-
-		if (TESTB<VA>::m_core->o_wb_stall) {
-			while((errcount++ < BOMBCOUNT)&&(TESTB<VA>::m_core->o_wb_stall)) {
-				TICK();
-			}
-		} TICK();
+		if (n == 0)
+			return;
 
-		TESTB<VA>::m_core->i_wb_stb = 0;
+		core->i_wb_cyc = 1;
+		core->i_wb_sel = 0x0f;
+		while((nacks < n)&&(errcount++ < BOMBCOUNT)) {
+			bool	accepted;
+
+			if (nreqs < n) {
+				core->i_wb_stb  = 1;
+				core->i_wb_we   = req[nreqs].m_we;
+				core->i_wb_addr = req[nreqs].m_addr;
+				core->i_wb_data = req[nreqs].m_data;
+			} else
+				core->i_wb_stb  = 0;
+
+			// The stall line may depend upon the request
+			core->eval();
+			accepted = core->i_wb_stb && !core->o_wb_stall;
+			if (core->i_wb_stb && core->o_wb_stall)
+				nstalls++;
 
-		while((errcount++ <  BOMBCOUNT)&&(!TESTB<VA>::m_core->o_wb_ack)) {
 			TICK();
-		}
-
 
-		result = TESTB<VA>::m_core->o_wb_data;
+			if (accepted)
+				nreqs++;
+			if (core->o_wb_ack) {
+				if (!req[nacks].m_we)
+					req[nacks].m_data = core->o_wb_data;
+				if (m_log >= WBLOG_ALL) {
+					if (req[nacks].m_we)
+						printf("WB-WRITE(%08x) <= %08x\n",
+							req[nacks].m_addr,
+							req[nacks].m_data);
+					else
+						printf("WB-READ (%08x) => %08x\n",
+							req[nacks].m_addr,
+							req[nacks].m_data);
+				}
+				nacks++;
+				errcount = 0;
+			}
+		}
 
 		// Release the bus
-		TESTB<VA>::m_core->i_wb_cyc = 0;
-		TESTB<VA>::m_core->i_wb_stb = 0;
-
-		if(errcount >= BOMBCOUNT) {
-			printf("WB/SR-BOMB: NO RESPONSE AFTER %d CLOCKS\n", errcount);
-			m_bomb = true;
-		} else if (!TESTB<VA>::m_core->o_wb_ack) {
-			printf("WB/SR-BOMB: NO ACK, NO TIMEOUT\n");
+		core->i_wb_cyc = 0;
+		core->i_wb_stb = 0;
+		m_wb_stalls.add(nstalls);
+
+		if (nacks < n) {
+			if (m_log >= WBLOG_ERR)
+				printf("WB/PIPE-BOMB: NO RESPONSE AFTER %d CLOCKS, %d of %d ACKs\n",
+					errcount, nacks, n);
 			m_bomb = true;
 		}
-		TICK();
-
-		assert(!TESTB<VA>::m_core->o_wb_ack);
-		assert(!TESTB<VA>::m_core->o_wb_stall);
-
-		return result;
 	}
 	// }}}
 
-	void	wb_read(unsigned a, int len, unsigned *buf, const int inc=1) {
+	unsigned wb_read(unsigned a) {
 		// {{{
-		int		errcount = 0;
-		int		THISBOMBCOUNT = BOMBCOUNT * len;
-		int		cnt, rdidx;
+		WBREQ	req;
 
-		printf("WB-READM(%08x, %d)\n", a, len);
-		TESTB<VA>::m_core->i_wb_cyc  = 0;
-		TESTB<VA>::m_core->i_wb_stb  = 0;
+		req.m_addr = a;
+		req.m_data = 0;
+		req.m_we   = false;
+		wb_pipeline(1, &req);
 
-		while((errcount++ < BOMBCOUNT)&&(TESTB<VA>::m_core->o_wb_stall))
-			TICK();
+		if (m_log >= WBLOG_BURST && m_log < WBLOG_ALL)
+			printf("WB-READ (%08x) => %08x\n", a, req.m_data);
 
-		if (errcount >= BOMBCOUNT) {
-			printf("WB-READ(%d): Setting bomb to true (errcount = %d)\n", __LINE__, errcount);
-			m_bomb = true;
-			return;
-		}
-
-		errcount = 0;
-		
-		TESTB<VA>::m_core->i_wb_cyc  = 1;
-		TESTB<VA>::m_core->i_wb_stb  = 1;
-		TESTB<VA>::m_core->i_wb_we   = 0;
-		TESTB<VA>::m_core->i_wb_addr = a;
-
-		rdidx =0; cnt = 0;
-
-		do {
-			int	s;
-			s = (TESTB<VA>::m_core->o_wb_stall==0)?0:1;
-			TICK();
-			TESTB<VA>::m_core->i_wb_addr += inc&(s^1);
-			cnt += (s^1);
-			if (TESTB<VA>::m_core->o_wb_ack)
-				buf[rdidx++] = TESTB<VA>::m_core->o_wb_data;
-		} while((cnt < len)&&(errcount++ < THISBOMBCOUNT));
+		return req.m_data;
+	}
+	// }}}
 
-		TESTB<VA>::m_core->i_wb_stb = 0;
+	void	wb_read(unsigned a, int len, unsigned *buf, const int inc=1) {
+		// {{{
+		WBREQ	*req;
 
-		while((rdidx < len)&&(errcount++ < THISBOMBCOUNT)) {
-			TICK();
-			if (TESTB<VA>::m_core->o_wb_ack)
-				buf[rdidx++] = TESTB<VA>::m_core->o_wb_data;
+		if (len <= 0)
+			return;
+		if (m_log >= WBLOG_BURST)
+			printf("WB-READM(%08x, %d)\n", a, len);
+
+		req = new WBREQ[len];
+		for(int k=0; k<len; k++) {
+			req[k].m_addr = a + k * inc;
+			req[k].m_data = 0;
+			req[k].m_we   = false;
 		}
 
-		// Release the bus
-		TESTB<VA>::m_core->i_wb_cyc = 0;
+		wb_pipeline(len, req);
 
-		if(errcount >= THISBOMBCOUNT) {
-			printf("WB/PR-BOMB: NO RESPONSE AFTER %d CLOCKS\n", errcount);
-			m_bomb = true;
-		} else if (!TESTB<VA>::m_core->o_wb_ack) {
-			printf("WB/PR-BOMB: NO ACK, NO TIMEOUT\n");
-			m_bomb = true;
-		}
-		TICK();
-		assert(!TESTB<VA>::m_core->o_wb_ack);
+		for(int k=0; k<len; k++)
+			buf[k] = req[k].m_data;
+		delete[] req;
 	}
 	// }}}
 
 	void	wb_write(unsigned a, unsigned v) {
 		// {{{
-		int errcount = 0;
-
-		printf("WB-WRITEM(%08x) <= %08x\n", a, v);
-		TESTB<VA>::m_core->i_wb_cyc = 1;
-		TESTB<VA>::m_core->i_wb_stb = 1;
-		TESTB<VA>::m_core->i_wb_we  = 1;
-		TESTB<VA>::m_core->i_wb_addr= a;
-		TESTB<VA>::m_core->i_wb_data= v;
-		TESTB<VA>::m_core->i_wb_sel = 0x0f;
-
-		if (TESTB<VA>::m_core->o_wb_stall)
-			while((errcount++ < BOMBCOUNT)&&(TESTB<VA>::m_core->o_wb_stall)) {
-				printf("Stalled, so waiting, errcount=%d\n", errcount);
-				TICK();
-			}
-		TICK();
+		WBREQ	req;
 
-		TESTB<VA>::m_core->i_wb_stb = 0;
+		if (m_log >= WBLOG_BURST && m_log < WBLOG_ALL)
+			printf("WB-WRITE(%08x) <= %08x\n", a, v);
 
-		while((errcount++ <  BOMBCOUNT)&&(!TESTB<VA>::m_core->o_wb_ack))
-			TICK();
-		TICK();
-
-		// Release the bus?
-		TESTB<VA>::m_core->i_wb_cyc = 0;
-		TESTB<VA>::m_core->i_wb_stb = 0;
-
-		if(errcount >= BOMBCOUNT) {
-			printf("WB/SW-BOMB: NO RESPONSE AFTER %d CLOCKS (LINE=%d)\n", errcount, __LINE__);
-			m_bomb = true;
-		} TICK();
-		assert(!TESTB<VA>::m_core->o_wb_ack);
-		assert(!TESTB<VA>::m_core->o_wb_stall);
+		req.m_addr = a;
+		req.m_data = v;
+		req.m_we   = true;
+		wb_pipeline(1, &req);
 	}
 	// }}}
 
 	void	wb_write(unsigned a, unsigned int ln, unsigned *buf, const int inc=1) {
 		// {{{
-		unsigned errcount = 0, nacks = 0;
-
-		printf("WB-WRITEM(%08x, %d, ...)\n", a, ln);
-		TESTB<VA>::m_core->i_wb_cyc = 1;
-		TESTB<VA>::m_core->i_wb_stb = 1;
-		TESTB<VA>::m_core->i_wb_we  = 1;
-		TESTB<VA>::m_core->i_wb_addr= a;
-		TESTB<VA>::m_core->i_wb_sel = 0x0f;
-		for(unsigned stbcnt=0; stbcnt<ln; stbcnt++) {
-			// m_core->i_wb_addr= a+stbcnt;
-			TESTB<VA>::m_core->i_wb_data= buf[stbcnt];
-			errcount = 0;
-
-			while((errcount++ < BOMBCOUNT)&&(TESTB<VA>::m_core->o_wb_stall)) {
-				TICK();
-				if (TESTB<VA>::m_core->o_wb_ack)
-					nacks++;
-			}
-			// Tick, now that we're not stalled.  This is the tick
-			// that gets accepted.
-			TICK();
-			if (TESTB<VA>::m_core->o_wb_ack) nacks++;
-
-			// Now update the address
-			TESTB<VA>::m_core->i_wb_addr += inc;
-		}
-
-		TESTB<VA>::m_core->i_wb_stb = 0;
+		WBREQ	*req;
 
-		errcount = 0;
-		while((nacks < ln)&&(errcount++ < BOMBCOUNT)) {
-			TICK();
-			if (TESTB<VA>::m_core->o_wb_ack) {
-				nacks++;
-				errcount = 0;
-			}
+		if (ln == 0)
+			return;
+		if (m_log >= WBLOG_BURST)
+			printf("WB-WRITEM(%08x, %d, ...)\n", a, ln);
+
+		req = new WBREQ[ln];
+		for(unsigned k=0; k<ln; k++) {
+			req[k].m_addr = a + k * inc;
+			req[k].m_data = buf[k];
+			req[k].m_we   = true;
 		}
 
-		// Release the bus
-		TESTB<VA>::m_core->i_wb_cyc = 0;
-		TESTB<VA>::m_core->i_wb_stb = 0;
-
-		if(errcount >= BOMBCOUNT) {
-			printf("WB/PW-BOMB: NO RESPONSE AFTER %d CLOCKS (LINE=%d)\n",errcount,__LINE__);
-			m_bomb = true;
-		}
-		TICK();
-		assert(!TESTB<VA>::m_core->o_wb_ack);
-		assert(!TESTB<VA>::m_core->o_wb_stall);
+		wb_pipeline(ln, req);
+		delete[] req;
 	}
 	// }}}
 
 	bool	bombed(void) const { return m_bomb; }
 
+	// The distribution of stall cycles per bus cycle, so far
+	const TBHIST	&wb_stalls(void) const { return m_wb_stalls; }
+
 	// bool	debug(void) const	{ return m_debug; }
 	// bool	debug(bool nxtv)	{ return m_debug = nxtv; }
 };
 
+#endif
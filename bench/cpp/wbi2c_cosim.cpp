@@ -0,0 +1,350 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2c_cosim.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Runs the I2C master core against the I2C slave core, both
+//		Verilated, on one bus.  For each bus speed (R_SPEED) and
+//	transfer length, random data is written from the master's memory into
+//	the slave's, and then read back the other way, checking both via each
+//	core's Wishbone port, and reporting the end to end latency and
+//	throughput of each transfer.
+//
+//	Then, for each speed, a full length write is repeated while the
+//	slave's Wishbone port is kept busy writing to the other half of its
+//	memory, so as to measure the stalls (o_wb_stall) that bus sees from
+//	I2C traffic into the same memory, and to check that neither write
+//	is lost.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "verilated.h"
+#include "tbrand.h"
+#include "wbi2c_cosim.h"
+
+#define	MAXSPEEDS	32
+#define	DEFAULT_CLKHZ	100e6
+
+// Words within each core's memory
+#define	MWORDS		(FULMEMSZ/4)
+#define	SWORDS		(SLAVE_MEMSZ/4)
+
+// Bus speeds, in clocks per I2C quarter bit, to sweep by default
+static const unsigned	default_speeds[] = { 10, 20, 40, 100, 250 };
+
+// Transfer lengths, in bytes, to sweep by default
+static const unsigned	default_lengths[] = { 1, 2, 4, 8, 16, 32, 64, CMEMMSK };
+
+void	usage(void) {
+	printf("USAGE: wbi2c_cosim [-h] [-a] [-v] [-c <speed>]* [-f <clkhz>] [-s <seed>]\n"
+"\t\t[-t <vcd>] [-T <vcd>]\n"
+"\n"
+"\t-a\tSweep all transfer lengths, from 1 through %d bytes, rather than\n"
+"\t\tjust the powers of two\n"
+"\t-c <speed>\tAdds <speed> to the list of R_SPEED values to be swept.\n"
+"\t\tMay be given more than once.  If not given, the speeds\n"
+"\t\t10, 20, 40, 100, and 250 are swept.\n"
+"\t-f <clkhz>\tSets the system clock rate used to report bytes per\n"
+"\t\tsecond.  Defaults to %.0f\n"
+"\t-s <seed>\tSeed the random test data with <seed>.  If not given,\n"
+"\t\ta new seed is chosen.  Either way, the seed is reported\n"
+"\t\tso that any failure can be repeated\n"
+"\t-t <vcd>\tTrace the master core to <vcd>\n"
+"\t-T <vcd>\tTrace the slave core to <vcd>\n"
+"\t-v\tDump the bus timing, latency, and stall statistics at the end\n"
+"\n"
+"\tIf the last line returns in SUCCESS, then every transfer was correct\n", CMEMMSK, DEFAULT_CLKHZ);
+}
+
+// Byte a of a memory held (as both cores hold theirs) in big endian words
+static	unsigned	getbyte(const unsigned *w, unsigned a) {
+	return (w[a>>2] >> (8*(3-(a&3)))) & 0x0ff;
+}
+
+static	void	randwords(TBRAND &rng, unsigned n, unsigned *w) {
+	for(unsigned k=0; k<n; k++)
+		w[k] = rng();
+}
+
+//
+// Slave port traffic, while the master is busy
+// {{{
+// Each time the master is found busy, write one word into the half of the
+// slave's memory the I2C transfer doesn't touch, keeping track of what was
+// last written where.
+static	unsigned	hammer_words[SWORDS], hammer_count;
+
+static	void	hammer(I2CCOSIM_TB *tb) {
+	unsigned	a = SWORDS/2 + (hammer_count % (SWORDS/2));
+
+	hammer_words[a] = hammer_count * 0x9e3779b9u;
+	tb->m_slave->wb_write(a, hammer_words[a]);
+	hammer_count++;
+}
+// }}}
+
+//
+// check_bytes
+// {{{
+// Compare the first ln bytes of two memories, reporting any differences
+static	int	check_bytes(const char *what, unsigned ln,
+			const unsigned *expected, const unsigned *actual) {
+	int	nerrs = 0;
+
+	for(unsigned a=0; a<ln; a++) {
+		unsigned	e = getbyte(expected, a), v = getbyte(actual, a);
+
+		if (e != v) {
+			if (nerrs++ < 4)
+				printf("ERR: %s, byte %d is %02x, not %02x\n",
+					what, a, v, e);
+		}
+	}
+
+	return nerrs;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	// {{{
+	I2CCOSIM_TB	*tb;
+	unsigned	speeds[MAXSPEEDS], nspeeds = 0;
+	unsigned	lengths[FULMEMSZ], nlengths = 0;
+	unsigned	mwords[MWORDS], swords[SWORDS], rbuf[SWORDS];
+	bool		all_lengths = false, verbose = false;
+	double		clkhz = DEFAULT_CLKHZ;
+	const char	*seedstr = NULL, *mvcd = NULL, *svcd = NULL;
+	TBRAND		rng;
+	int		opt, nerrs = 0;
+
+	Verilated::commandArgs(argc, argv);
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "havc:f:s:t:T:")) != -1) {
+		switch(opt) {
+		case 'a': all_lengths = true; break;
+		case 'v': verbose = true; break;
+		case 'f': clkhz = atof(optarg);
+			if (clkhz <= 0) {
+				fprintf(stderr, "ERR: Invalid clock rate, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} break;
+		case 's': seedstr = optarg; break;
+		case 'c':
+			if (nspeeds >= MAXSPEEDS) {
+				fprintf(stderr, "ERR: Too many speeds\n");
+				exit(EXIT_FAILURE);
+			}
+			speeds[nspeeds] = strtoul(optarg, NULL, 0);
+			if (speeds[nspeeds] < 2) {
+				fprintf(stderr, "ERR: Invalid speed, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} nspeeds++;
+			break;
+		case 't': mvcd = optarg; break;
+		case 'T': svcd = optarg; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	if (nspeeds == 0) {
+		for(unsigned k=0; k<sizeof(default_speeds)/sizeof(unsigned); k++)
+			speeds[nspeeds++] = default_speeds[k];
+	}
+
+	if (all_lengths) {
+		for(unsigned k=1; k<=CMEMMSK; k++)
+			lengths[nlengths++] = k;
+	} else {
+		for(unsigned k=0; k<sizeof(default_lengths)/sizeof(unsigned); k++)
+			lengths[nlengths++] = default_lengths[k];
+	}
+	// }}}
+
+	rng.reseed(tbrand_seed(seedstr));
+
+	tb = new I2CCOSIM_TB();
+	tb->reset();
+	tb->opentrace(mvcd, svcd);
+
+	// End to end transfers
+	// {{{
+	printf("%5s %3s %4s %10s %10s %10s %12s\n",
+		"SPEED", "DIR", "LEN", "LATENCY", "CLKS/BYTE",
+		"BYTES/CLK", "BYTES/SEC");
+	for(unsigned s=0; s<nspeeds; s++) {
+		// As for wbi2cm_bench, allow a generous timeout
+		unsigned long	timeout = (unsigned long)speeds[s]
+					* 40 * (FULMEMSZ+4) + 100000;
+
+		tb->m_master->wb_write(R_SPEED, speeds[s]);
+		for(int dir=0; dir<2; dir++) {
+			for(unsigned k=0; k<nlengths; k++) {
+				unsigned	ln = lengths[k], cmd, status;
+				unsigned long	latency;
+
+				// Fresh data on both sides, so nothing can
+				// match by accident
+				randwords(rng, MWORDS, mwords);
+				randwords(rng, SWORDS, swords);
+				tb->m_master->wb_write(R_MEM, MWORDS, mwords);
+				tb->m_slave->wb_write(0, SWORDS, swords);
+
+				cmd = (dir) ? READCMD(SLAVE_ADDRESS, 0, ln)
+					: WRITECMD(SLAVE_ADDRESS, 0, ln);
+				latency = tb->run_cmd(cmd, timeout);
+				if (latency == 0) {
+					printf("%5d %3s %4d %10s\n", speeds[s],
+						(dir) ? "RD":"WR", ln,
+						"TIMEOUT");
+					nerrs++;
+					continue;
+				}
+
+				status = tb->m_master->wb_read(R_CMD);
+				if (status != WRITECMD(SLAVE_ADDRESS, ln, 0)) {
+					printf("ERR: Unexpected status, %08x\n",
+						status);
+					nerrs++;
+				}
+
+				if (dir) {
+					tb->m_master->wb_read(R_MEM, MWORDS, rbuf);
+					nerrs += check_bytes("Read from slave",
+						ln, swords, rbuf);
+				} else {
+					tb->m_slave->wb_read(0, SWORDS, rbuf);
+					nerrs += check_bytes("Write to slave",
+						ln, mwords, rbuf);
+					// Nothing beyond the transfer should
+					// have changed
+					for(unsigned a=ln; a<SLAVE_MEMSZ; a++)
+						if (getbyte(rbuf,a) != getbyte(swords,a)) {
+							printf("ERR: Slave byte %d changed\n", a);
+							nerrs++;
+						}
+				}
+
+				printf("%5d %3s %4d %10ld %10.1f %10.6f %12.1f\n",
+					speeds[s], (dir) ? "RD":"WR", ln,
+					latency, latency / (double)ln,
+					ln / (double)latency,
+					ln * clkhz / (double)latency);
+
+				// Give the bus some idle time before the
+				// next command
+				for(unsigned i=0; i<speeds[s]*8; i++)
+					tb->tick();
+			}
+		}
+	}
+	// }}}
+
+	// Slave port contention
+	// {{{
+	printf("\n%5s %10s %8s %10s %10s %8s\n", "SPEED", "LATENCY",
+		"WB-WRS", "STALLCLKS", "MEANSTALL", "MAXSTALL");
+	for(unsigned s=0; s<nspeeds; s++) {
+		unsigned long	timeout = (unsigned long)speeds[s]
+					* 40 * (FULMEMSZ+4) + 100000,
+				latency;
+		TBHIST		&stalls = tb->m_slave->m_wb_stalls;
+
+		randwords(rng, MWORDS, mwords);
+		randwords(rng, SWORDS, swords);
+		tb->m_master->wb_write(R_SPEED, speeds[s]);
+		tb->m_master->wb_write(R_MEM, MWORDS, mwords);
+		tb->m_slave->wb_write(0, SWORDS, swords);
+		memcpy(hammer_words, swords, sizeof(swords));
+		hammer_count = 0;
+
+		stalls.clear();
+		latency = tb->run_cmd(WRITECMD(SLAVE_ADDRESS, 0, CMEMMSK),
+				timeout, hammer);
+		if (latency == 0) {
+			printf("%5d %10s\n", speeds[s], "TIMEOUT");
+			nerrs++;
+			continue;
+		}
+
+		printf("%5d %10ld %8ld %10.0f %10.3f %8ld\n", speeds[s],
+			latency, stalls.count(), stalls.sum(), stalls.mean(),
+			stalls.max());
+
+		// Both the I2C transfer, and every write from the slave's bus
+		// port, should have landed
+		tb->m_slave->wb_read(0, SWORDS, rbuf);
+		nerrs += check_bytes("Write to slave, while busy", CMEMMSK,
+				mwords, rbuf);
+		for(unsigned a=SWORDS/2; a<SWORDS; a++)
+			if (rbuf[a] != hammer_words[a]) {
+				printf("ERR: Slave WB write to %d lost, %08x != %08x\n",
+					a, rbuf[a], hammer_words[a]);
+				nerrs++;
+			}
+
+		for(unsigned i=0; i<speeds[s]*8; i++)
+			tb->tick();
+	}
+	// }}}
+
+	if (tb->bombed()) {
+		printf("ERR: Wishbone bus timeout\n");
+		nerrs++;
+	}
+
+	if (verbose) {
+		printf("\n");
+		tb->dump_stats(stdout);
+	}
+
+	tb->closetrace();
+	delete tb;
+
+	if (nerrs) {
+		printf("FAIL: %d errors\n", nerrs);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("SUCCESS!\n");
+	exit(EXIT_SUCCESS);
+}
+// }}}
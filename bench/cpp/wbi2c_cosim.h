@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2c_cosim.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Defines the I2CCOSIM_TB test bench, placing the I2C master
+//		(wbi2cmaster) and the I2C slave (wbi2cslave) cores on the same
+//	(wired-AND) bus, so that the two may be run against each other rather
+//	than each against a C++ model.  Each core keeps its own Wishbone port,
+//	driven by its own WB_TB.  Both cores share one clock: any tick of
+//	either side, including those within a Wishbone transaction on that
+//	side, advances both.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBI2C_COSIM_H
+#define	WBI2C_COSIM_H
+
+#include "verilated.h"
+#include "Vwbi2cmaster.h"
+#include "Vwbi2cslave.h"
+
+#include "testb.h"
+#include "wb_tb.h"
+#include "i2cstats.h"
+#include "tbhist.h"
+#include "wbi2cm_regs.h"
+
+// The slave core, as Verilated with its default parameters
+#define	SLAVE_ADDRESS		0x50
+#define	SLAVE_MEM_ADDR_BITS	8
+#define	SLAVE_MEMSZ		(1<<(SLAVE_MEM_ADDR_BITS))
+
+class	I2CCOSIM_TB;
+
+// COSIM_PORT
+// {{{
+// One core within the co-simulation, together with the Wishbone driver for
+// its bus port
+template <class VA>	class	COSIM_PORT : public WB_TB<VA> {
+	I2CCOSIM_TB	*m_sys;
+public:
+	COSIM_PORT(I2CCOSIM_TB *sys) : m_sys(sys) {}
+
+	// Any tick on this port, to include those within wb_read() and
+	// wb_write(), is a tick of the whole system
+	void	tick(void);
+
+	// Step this core alone, once its inputs have been set
+	void	step(void) { WB_TB<VA>::tick(); }
+};
+// }}}
+
+class	I2CCOSIM_TB {
+public:
+	COSIM_PORT<Vwbi2cmaster>	*m_master;
+	COSIM_PORT<Vwbi2cslave>		*m_slave;
+	I2CSTATS	m_stats;
+	TBHIST		m_cmd_latency;
+	unsigned long	m_tickcount;
+
+	I2CCOSIM_TB(void) : m_tickcount(0) {
+		m_master = new COSIM_PORT<Vwbi2cmaster>(this);
+		m_slave  = new COSIM_PORT<Vwbi2cslave>(this);
+
+		m_master->m_core->i_i2c_scl = 1;
+		m_master->m_core->i_i2c_sda = 1;
+		m_slave->m_core->i_i2c_scl = 1;
+		m_slave->m_core->i_i2c_sda = 1;
+
+		// Nothing arrives via the slave's AXI stream port
+		m_slave->m_core->s_valid = 0;
+		m_slave->m_core->s_data  = 0;
+		m_slave->m_core->s_last  = 0;
+	}
+
+	~I2CCOSIM_TB(void) {
+		delete m_master;
+		delete m_slave;
+	}
+
+	void	tick(void) {
+		Vwbi2cmaster	*mc = m_master->m_core;
+		Vwbi2cslave	*sc = m_slave->m_core;
+		int		scl, sda;
+
+		// Resolve the bus from what both cores are driving
+		scl = mc->o_i2c_scl & sc->o_i2c_scl;
+		sda = mc->o_i2c_sda & sc->o_i2c_sda;
+		mc->i_i2c_scl = scl;
+		mc->i_i2c_sda = sda;
+		sc->i_i2c_scl = scl;
+		sc->i_i2c_sda = sda;
+		m_stats(I2CBUS(mc->o_i2c_scl, mc->o_i2c_sda), I2CBUS(scl, sda));
+
+		m_master->step();
+		m_slave->step();
+		m_tickcount++;
+	}
+
+	void	reset(void) {
+		m_master->m_core->i_reset = 1;
+		m_slave->m_core->i_reset = 1;
+		tick();
+		m_master->m_core->i_reset = 0;
+		m_slave->m_core->i_reset = 0;
+	}
+
+	// Each core may be traced, each to its own file
+	void	opentrace(const char *mvcd, const char *svcd) {
+		if (mvcd)
+			m_master->opentrace(mvcd);
+		if (svcd)
+			m_slave->opentrace(svcd);
+	}
+
+	void	closetrace(void) {
+		m_master->closetrace();
+		m_slave->closetrace();
+	}
+
+	// run_cmd
+	// {{{
+	// Issue one command to the master, and wait for its interrupt.
+	// Returns the number of clocks from the command being issued until
+	// o_int, or zero on a timeout.  If busy() is given, it is called
+	// every time the master is found still busy, in place of a tick--so
+	// that it may (for example) use the slave's bus port in the meantime.
+	unsigned long	run_cmd(unsigned cmd, unsigned long timeout,
+				void (*busy)(I2CCOSIM_TB *) = NULL) {
+		unsigned long	start, latency;
+
+		start = m_tickcount;
+		m_master->wb_write(R_CMD, cmd);
+
+		// The core takes a clock or two to leave the idle state
+		tick();
+		tick();
+		while(0 == m_master->m_core->o_int) {
+			if (m_tickcount - start > timeout)
+				return 0;
+			if (busy)
+				busy(this);
+			else
+				tick();
+		}
+		latency = m_tickcount - start;
+		m_cmd_latency.add(latency);
+
+		return latency;
+	}
+	// }}}
+
+	bool	bombed(void) const {
+		return m_master->bombed() || m_slave->bombed();
+	}
+
+	// Dump all of the statistics collected so far
+	void	dump_stats(FILE *fp) {
+		m_stats.dump(fp);
+		m_cmd_latency.dump(fp, "Command to interrupt");
+		m_master->wb_stalls().dump(fp, "Master WB stalls, per cycle");
+		m_slave->wb_stalls().dump(fp, "Slave WB stalls, per cycle");
+	}
+};
+
+template <class VA>	void	COSIM_PORT<VA>::tick(void) {
+	m_sys->tick();
+}
+
+#endif
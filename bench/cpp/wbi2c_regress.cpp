@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2c_regress.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A regression runner, running many randomized scenarios of both
+//		the I2C master and the I2C slave in parallel.  Each scenario is
+//	given its own seed, from which it chooses its own bus speed and set of
+//	transfers, and is run in its own process.  Since the test benches
+//	abort on a failed assertion, a process per scenario keeps one failure
+//	from taking down the rest of the run.  Up to one scenario per CPU is
+//	run at a time.  At the end, the runner reports the number of
+//	scenarios passed and failed, and the command needed to rerun (and
+//	trace) any failing seed on its own.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "verilated.h"
+#include "regress.h"
+
+#define	DEFAULT_SEEDS		1000
+#define	DEFAULT_TRANSFERS	8
+#define	DEFAULT_TIMEOUT		600
+
+typedef	enum { RG_MASTER=0, RG_SLAVE } RGCORE;
+
+static	const char	*core_name[2] = { "m", "s" };
+
+typedef	struct {
+	pid_t		m_pid;
+	unsigned	m_seed;
+	RGCORE		m_core;
+} RGJOB;
+
+void	usage(void) {
+	printf("USAGE: wbi2c_regress [-hlv] [-j <jobs>] [-n <seeds>] [-s <seed>]\n"
+"\t\t[-c <m|s|ms>] [-x <transfers>] [-T <secs>] [-t <trace>]\n"
+"\n"
+"\t-c <cores>\tWhich cores to test: m for the master, s for the slave.\n"
+"\t\tDefaults to both, ms\n"
+"\t-j <jobs>\tRun up to <jobs> scenarios at once.  Defaults to the\n"
+"\t\tnumber of CPUs\n"
+"\t-l\tRun the master\'s scenarios against a transaction level\n"
+"\t\tslave model, trading its bit level checks for speed\n"
+"\t-n <seeds>\tRun <seeds> scenarios per core.  Defaults to %d\n"
+"\t-s <seed>\tThe first seed to run.  Seeds are run consecutively\n"
+"\t\tfrom here.  Defaults to 1\n"
+"\t-x <transfers>\tNumber of transfers per scenario.  Defaults to %d\n"
+"\t-T <secs>\tConsider any scenario taking longer than <secs> seconds\n"
+"\t\tto have failed.  Defaults to %d\n"
+"\t-t <trace>\tTrace each scenario to <trace>.  Only useful when\n"
+"\t\trerunning a single seed\n"
+"\t-v\tVerbose: let each scenario describe its transfers.  Otherwise\n"
+"\t\tonly failing scenarios produce any output\n",
+	DEFAULT_SEEDS, DEFAULT_TRANSFERS, DEFAULT_TIMEOUT);
+}
+
+// run_job
+// {{{
+// Start one scenario in a child process, returning the child's PID.  The
+// child's exit status is the scenario's pass (0) or failure (non-zero).
+static	pid_t	run_job(RGCORE core, const REGRESS &rg, unsigned timeout) {
+	pid_t	pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("O/S Err: fork");
+		exit(EXIT_FAILURE);
+	} else if (pid == 0) {
+		int	nerrs;
+
+		alarm(timeout);
+		nerrs = (core == RG_MASTER) ? i2cm_scenario(rg)
+					: i2cs_scenario(rg);
+		fflush(stdout);
+		_exit((nerrs == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	return pid;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	// {{{
+	RGJOB		*jobs;
+	REGRESS		rg;
+	const char	*cores = "ms";
+	unsigned	njobs, nseeds = DEFAULT_SEEDS, first_seed = 1,
+			timeout = DEFAULT_TIMEOUT, nactive = 0, npass = 0,
+			nfail = 0, ncores = 0;
+	RGCORE		corelist[2];
+	long		ncpus;
+	int		opt;
+
+	Verilated::commandArgs(argc, argv);
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	njobs = (ncpus > 0) ? ncpus : 1;
+	rg.m_transfers = DEFAULT_TRANSFERS;
+	rg.m_verbose   = false;
+	rg.m_fast      = false;
+	rg.m_trace     = NULL;
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "hlvc:j:n:s:x:T:t:")) != -1) {
+		switch(opt) {
+		case 'c': cores = optarg; break;
+		case 'j': njobs = strtoul(optarg, NULL, 0); break;
+		case 'n': nseeds = strtoul(optarg, NULL, 0); break;
+		case 's': first_seed = strtoul(optarg, NULL, 0); break;
+		case 'x': rg.m_transfers = strtoul(optarg, NULL, 0); break;
+		case 'T': timeout = strtoul(optarg, NULL, 0); break;
+		case 't': rg.m_trace = optarg; break;
+		case 'l': rg.m_fast = true; break;
+		case 'v': rg.m_verbose = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	if (strchr(cores, 'm'))
+		corelist[ncores++] = RG_MASTER;
+	if (strchr(cores, 's'))
+		corelist[ncores++] = RG_SLAVE;
+	if (ncores == 0 || njobs == 0) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+	// }}}
+
+	printf("Running %d scenarios (from seed %d) of %d transfers each, %d at a time\n",
+		nseeds * ncores, first_seed, rg.m_transfers, njobs);
+
+	jobs = new RGJOB[njobs];
+	for(unsigned k=0; k<njobs; k++)
+		jobs[k].m_pid = 0;
+
+	for(unsigned n=0; n<nseeds * ncores || nactive > 0; ) {
+		int	status;
+		pid_t	pid;
+
+		// Keep every job slot busy
+		// {{{
+		for(unsigned k=0; k<njobs && n < nseeds * ncores; k++) {
+			if (jobs[k].m_pid != 0)
+				continue;
+			rg.m_seed = first_seed + n / ncores;
+			jobs[k].m_seed = rg.m_seed;
+			jobs[k].m_core = corelist[n % ncores];
+			jobs[k].m_pid  = run_job(jobs[k].m_core, rg, timeout);
+			nactive++;
+			n++;
+		}
+		// }}}
+
+		// Wait for any job to complete
+		// {{{
+		pid = wait(&status);
+		if (pid < 0) {
+			perror("O/S Err: wait");
+			exit(EXIT_FAILURE);
+		}
+
+		for(unsigned k=0; k<njobs; k++) {
+			if (jobs[k].m_pid != pid)
+				continue;
+
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+				npass++;
+			else {
+				nfail++;
+				if (WIFSIGNALED(status))
+					printf("FAIL: I2C%s seed %u, %s\n",
+						(jobs[k].m_core == RG_MASTER)
+						? "M" : "S", jobs[k].m_seed,
+						(WTERMSIG(status) == SIGALRM)
+						? "timed out"
+						: strsignal(WTERMSIG(status)));
+				else
+					printf("FAIL: I2C%s seed %u\n",
+						(jobs[k].m_core == RG_MASTER)
+						? "M" : "S", jobs[k].m_seed);
+				printf("\tRerun with: %s -c %s -s %u -n 1 -x %u%s -v\n",
+					argv[0], core_name[jobs[k].m_core],
+					jobs[k].m_seed, rg.m_transfers,
+					(rg.m_fast) ? " -l" : "");
+			}
+
+			jobs[k].m_pid = 0;
+			nactive--;
+			break;
+		}
+		// }}}
+	}
+
+	delete[] jobs;
+
+	printf("\n%d passed, %d failed\n", npass, nfail);
+	if (nfail) {
+		printf("FAIL!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("SUCCESS!\n");
+	exit(EXIT_SUCCESS);
+}
+// }}}
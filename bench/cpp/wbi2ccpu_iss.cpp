@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2ccpu_iss.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Runs an i2casm script on the I2CISS instruction set simulator,
+//		rather than on the Verilated CPU, and reports the same
+//	instruction, bus, and stream statistics wbi2ccpu_tb does--in a small
+//	fraction of the time.  No Verilator model is needed.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i2csim.h"
+#include "i2ceeprom.h"
+#include "i2ciss.h"
+#include "cpubench.h"
+
+#define	LGMEMBYTES	16
+
+// The options wbi2ccpu_iss takes beyond, or in place of, those it shares
+// with wbi2ccpu_tb
+static const CPUBENCH_OPT	iss_opts[] = {
+	// {{{
+	{ 'i', "<trace>", false,
+"\tLogs every instruction issued to <trace>, with the clock\n"
+"\t\tit was issued on and the address it came from\n" },
+	{ 'n', NULL, false,
+"\tSimulates every clock, rather than jumping over those the CPU\n"
+"\t\tspends waiting on its clock divider.  The results are the same.\n" },
+	{ 'w', "<clocks>", false,
+"\tThe clocks the instruction memory takes to return the\n"
+"\t\tfirst instruction after a jump or abort.  Instructions are\n"
+"\t\totherwise fetched as fast as they issue.  Defaults to 0.\n" },
+	{ 0, NULL, false, NULL }
+	// }}}
+};
+
+int	main(int argc, char **argv) {
+	// {{{
+	// There's no fetch bus to stall, pipeline, or refresh
+	CPUBENCH	cpu("wbi2ccpu_iss", iss_opts, "pRW",
+"\tRuns <script> on a native model of the I2C CPU, rather than on the\n"
+"\tVerilated one, taking the same options (where they apply) as\n"
+"\twbi2ccpu_tb, and reporting the same statistics.\n");
+	I2CISS		*iss;
+	unsigned	latency = 0;
+	unsigned long	nclks;
+	const char	*trace_fname = NULL;
+	bool		every_clock = false, halted;
+	int		opt;
+
+	// Argument processing
+	// {{{
+	while((opt = cpu.getopt(argc, argv)) != -1) {
+		switch(opt) {
+		case 'i': trace_fname = optarg; break;
+		case 'n': every_clock = true; break;
+		case 'w': latency = strtoul(optarg, NULL, 0); break;
+		}
+	}
+	// }}}
+
+	iss = new I2CISS(LGMEMBYTES);
+	cpu.setup(*iss);
+	iss->fast_forward(!every_clock);
+	iss->fetch_latency(latency);
+	iss->ckcount(cpu.m_ckcount);
+	if (trace_fname)
+		iss->trace(trace_fname);
+
+	cpu.load(*iss);
+
+	iss->jump(cpu.m_start_addr);
+
+	cpu.start();
+	do {
+		iss->clock(cpu.sync(iss->tickcount()));
+		nclks = iss->tickcount();
+	} while(!iss->halted() && nclks < cpu.m_maxclks);
+	cpu.stop();
+	halted = iss->halted();
+
+	printf("\n");
+	if (halted)
+		printf("Halted after %ld clocks, at the HALT from 0x%08x\n",
+			nclks, iss->insn_addr());
+	else
+		printf("Timed out after %ld clocks, script still running\n",
+			nclks);
+
+	cpu.report(*iss, nclks);
+	iss->sink().dump(stdout);
+	printf("Clocks skipped:        %10ld (%.2f%%)\n", iss->skipped(),
+		100.0 * iss->skipped() / (double)nclks);
+	cpu.report_rate(nclks);
+
+	delete iss;
+
+	exit((halted) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+// }}}
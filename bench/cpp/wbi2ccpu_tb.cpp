@@ -0,0 +1,664 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2ccpu_tb.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A test bench and benchmark for the I2C CPU, wbi2ccpu, and the
+//		axisi2c controller within it.  An i2casm assembled script is
+//	loaded into a simulated Wishbone memory, from which the CPU fetches its
+//	instructions.  The I2C port is connected to a bus of I2CSIMSLAVE
+//	models, and the outgoing AXI stream is captured.  Once the script
+//	halts, or a clock limit is reached, the test bench reports the number
+//	of instructions issued per second, the fraction of time the I2C and
+//	the fetch buses were busy, and the stream bytes produced per clock.
+//
+//	The instruction memory (WBMEM) may be given wait states, stalls, and
+//	refresh intervals, to find how much fetch latency the CPU tolerates
+//	before it shows up as gaps on the I2C bus.
+//
+//	The stream is received by an AXISSINK, which may apply backpressure.
+//	Since the CPU doesn't stretch the I2C clock when its stream is held
+//	off, but instead drops any byte received while the last is still
+//	waiting, the bench reports the I2C clocks spent under backpressure
+//	and the bytes lost to it.  A FIFO may be placed
+//	within the sink, to find how deep it must be to lose nothing.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2021-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "verilated.h"
+#include "Vwbi2ccpu.h"
+
+#include "testb.h"
+#include "tbhist.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "i2cstats.h"
+#include "i2ceeprom.h"
+#include "i2cmonitor.h"
+#include "i2cfault.h"
+#include "wbmem.h"
+#include "axissink.h"
+#include "i2ciss.h"
+#include "cpubench.h"
+
+#ifdef	OLD_VERILATOR
+#define	VVAR(A)	v__DOT_ ## A
+#elif defined(ROOT_VERILATOR)
+#include "Vwbi2ccpu___024root.h"
+
+#define	VVAR(A)	rootp->wbi2ccpu__DOT_ ## A
+#else
+#define	VVAR(A)	wbi2ccpu__DOT_ ## A
+#endif
+
+#define	insn_valid	VVAR(_insn_valid)
+#define	s_tready	VVAR(_s_tready)
+#define	i2c_abort	VVAR(_i2c_abort)
+#define	insn		VVAR(_insn)
+#define	r_wait		VVAR(_r_wait)
+#define	i2c_ckedge	VVAR(_i2c_ckedge)
+#define	i2c_ckcount	VVAR(_i2c_ckcount)
+#ifdef	CPU_WATCHDOG
+#define	watchdog	VVAR(_u_axisi2c__DOT__GEN_WATCHDOG__DOT__r_watchdog_counter)
+#define	channel_busy	VVAR(_u_axisi2c__DOT__channel_busy)
+#endif
+
+// RXK, RXN, RXLK, and RXLN each receive one byte for the stream
+#define	RXINSN(I)	((((I) >> 8) & 0x0c) == 0x04)
+
+// Address locations
+#define	ADR_CONTROL	0
+#define	ADR_OVERRIDE	1
+#define	ADR_ADDRESS	2
+#define	ADR_CKCOUNT	3
+
+#define	LGMEMBYTES	16
+
+#define	DEFAULT_RIVAL	0x48
+
+class	CPU_TB : public WB_TB<Vwbi2ccpu> {
+	WBMEM<uint32_t>	m_imem;
+	unsigned long	m_insns, m_i2c_busy, m_pf_busy, m_rx_insns, m_bp_scl,
+			m_aborts, m_lost, m_abort_tick;
+	bool		m_i2c_active, m_recovering, m_fault_abort;
+	unsigned	m_settled;
+	I2CBUS		m_last_bus, m_last_drv, m_rival_out;
+	I2CSIMBUS	m_i2c;
+	I2CSIMMASTER	*m_rival;
+	I2CFAULT	*m_fault;
+	I2CMONITOR	*m_mon;
+	TBHIST		m_recovery;
+	I2CSTATS	m_stats;
+	AXISSINK	m_sink;
+	I2CISS		*m_iss;
+	unsigned long	m_matched;
+public:
+
+	CPU_TB(void) : m_imem(LGMEMBYTES),
+			m_insns(0), m_i2c_busy(0), m_pf_busy(0),
+			m_rx_insns(0), m_bp_scl(0), m_aborts(0), m_lost(0),
+			m_abort_tick(0), m_i2c_active(false),
+			m_recovering(false), m_fault_abort(false),
+			m_settled(0), m_rival(NULL), m_fault(NULL),
+			m_mon(NULL), m_iss(NULL), m_matched(0) {
+		m_core->i_i2c_scl = 1;
+		m_core->i_i2c_sda = 1;
+		m_core->i_pf_stall = 0;
+		m_core->i_pf_ack   = 0;
+		m_core->i_pf_err   = 0;
+		m_core->i_pf_data  = 0;
+		m_core->M_AXIS_TREADY = m_sink.tready();
+		m_core->i_sync_signal = 1;
+	}
+
+	~CPU_TB(void) {
+		if (m_mon)
+			delete m_mon;
+		if (m_rival)
+			delete m_rival;
+		if (m_fault)
+			delete m_fault;
+		if (m_iss)
+			delete m_iss;
+	}
+
+	// Load an i2casm script into memory at the byte address given.
+	// Returns the number of bytes loaded.
+	unsigned	load(const char *fname, unsigned addr) {
+		if (m_iss)
+			m_iss->load(fname, addr);
+		return m_imem.load(fname, addr);
+	}
+
+	unsigned char	&operator[](unsigned addr) {
+		return m_imem[addr];
+	}
+
+	// The instruction memory, so that its latency and stalls may be
+	// configured, and its statistics read
+	WBMEM<uint32_t>	&imem(void) { return m_imem; }
+
+	const I2CSTATS	&stats(void) const { return m_stats; }
+
+	I2CSIMBUS	&i2cbus(void) { return m_i2c; }
+
+	// The stream sink, so that its backpressure may be configured, and
+	// the stream read back
+	AXISSINK	&sink(void) { return m_sink; }
+
+	// Log every bus transaction to the given file.  See I2CMONITOR.
+	void	monitor(const char *fname) {
+		if (!m_mon)
+			m_mon = new I2CMONITOR();
+		m_mon->open(fname);
+	}
+
+	// Add a second master to the bus, competing with the CPU for it.
+	// See I2CSIMMASTER.
+	I2CSIMMASTER	*rival(const int devaddr, unsigned long period,
+				const int halfbit, uint64_t seed) {
+		if (!m_rival)
+			m_rival = new I2CSIMMASTER(devaddr, period, halfbit,
+								seed);
+		return m_rival;
+	}
+
+	// Place a fault injector between the CPU and the bus.  See I2CFAULT.
+	// The CPU has recovered from a fault once it has aborted and issued
+	// its next instruction or, if it never aborts, once the fault is over
+	// and the CPU has finished its transaction with a STOP.
+	I2CFAULT	*fault(uint64_t seed) {
+		if (!m_fault) {
+			m_fault = new I2CFAULT(seed);
+			m_i2c.protocol(I2CSIM_IGNORE);
+		}
+		return m_fault;
+	}
+
+	// Check every instruction the CPU issues against the instruction set
+	// simulator, I2CISS, running the same script in lockstep.  Since
+	// nothing in a script depends upon the data it reads, only the I2C
+	// aborts need be passed from the CPU to the ISS to keep the two
+	// together.  Must be called before load().
+	void	lockstep(void) {
+		if (!m_iss)
+			m_iss = new I2CISS(LGMEMBYTES);
+	}
+
+	// The instructions that have matched so far
+	unsigned long	matched(void) const { return m_matched; }
+
+	unsigned long	insns(void) const	{ return m_insns; }
+	unsigned long	i2c_busy(void) const	{ return m_i2c_busy; }
+	unsigned long	pf_busy(void) const	{ return m_pf_busy; }
+	unsigned long	stream_bytes(void) const { return m_sink.beats(); }
+
+	// I2C clocks (SCL rising edges) while the sink held off a stream byte,
+	// and the bytes the CPU dropped as a result: those its RX
+	// instructions received that never made it into the stream.  Bytes
+	// an abort cuts short count as lost, too.
+	unsigned long	backpressure_scl(void) const { return m_bp_scl; }
+	unsigned long	stream_lost(void) const {
+		unsigned long	got = m_sink.beats()
+					+ (m_core->M_AXIS_TVALID ? 1:0);
+
+		return (m_rx_insns > got) ? m_rx_insns - got : 0;
+	}
+
+	// I2C aborts, those while the other master was on the bus (i.e. lost
+	// arbitration), and the clocks from each abort until the CPU issues
+	// its next instruction
+	unsigned long	aborts(void) const	{ return m_aborts; }
+	unsigned long	lost(void) const	{ return m_lost; }
+	const TBHIST	&recovery(void) const	{ return m_recovery; }
+
+	void	tick(void) {
+		I2CBUS		drv, ib;
+		bool		pf_cyc, pf_stb, issued, stopped = false,
+				tvalid, tlast;
+		unsigned	pf_addr, tdata, tid;
+
+		// I2C bus
+		// {{{
+		drv = I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda)
+							+ m_rival_out;
+		ib = (m_fault) ? (*m_fault)(drv, m_i2c) : m_i2c(drv);
+		if (m_rival)
+			m_rival_out = (*m_rival)(ib);
+		m_core->i_i2c_scl = ib.m_scl;
+		m_core->i_i2c_sda = ib.m_sda;
+		if (m_mon)
+			(*m_mon)(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+		m_stats(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+
+		// I2C clocks while the stream is being held off
+		if (ib.m_scl && !m_last_bus.m_scl && m_sink.stalled())
+			m_bp_scl++;
+
+		// Keep track of when the bus is between a START and a STOP
+		if (ib.m_scl) {
+			if (!ib.m_sda && m_last_bus.m_sda)
+				m_i2c_active = true;
+			else if (ib.m_sda && !m_last_bus.m_sda) {
+				stopped = m_i2c_active;
+				m_i2c_active = false;
+			}
+		}
+		// Clocks that nothing has moved, on either the I2C bus or the
+		// fetch bus, and no stream byte is waiting
+		if (ib.m_scl == m_last_bus.m_scl && ib.m_sda == m_last_bus.m_sda
+				&& m_core->o_i2c_scl == m_last_drv.m_scl
+				&& m_core->o_i2c_sda == m_last_drv.m_sda
+				&& !m_core->o_pf_cyc && !m_core->M_AXIS_TVALID)
+			m_settled++;
+		else
+			m_settled = 0;
+
+		m_last_bus = ib;
+		m_last_drv = I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda);
+		if (m_i2c_active)
+			m_i2c_busy++;
+		// }}}
+
+		// Instruction and stream accounting
+		// {{{
+		issued = m_core->insn_valid && m_core->s_tready;
+		if (issued) {
+			m_insns++;
+			if (RXINSN(m_core->insn))
+				m_rx_insns++;
+			if (m_recovering) {
+				m_recovery.add(m_tickcount - m_abort_tick);
+				m_recovering = false;
+			}
+		}
+
+		if (m_iss && (issued || m_core->i2c_abort))
+			check_lockstep(issued);
+
+		if (m_core->i2c_abort) {
+			m_aborts++;
+			if (m_rival && m_rival->active())
+				m_lost++;
+			m_abort_tick = m_tickcount;
+			m_recovering = true;
+		}
+
+		if (m_fault && m_fault->pending()) {
+			if (m_core->i2c_abort)
+				m_fault_abort = true;
+			else if (m_fault_abort ? issued
+					: (stopped && !m_fault->active())) {
+				m_fault->recovered();
+				m_fault_abort = false;
+			}
+		}
+		// }}}
+
+		// Instruction memory, and the stream sink
+		// {{{
+		if (m_core->o_pf_cyc)
+			m_pf_busy++;
+		pf_cyc  = m_core->o_pf_cyc;
+		pf_stb  = m_core->o_pf_stb;
+		pf_addr = m_core->o_pf_addr;
+		tvalid  = m_core->M_AXIS_TVALID;
+		tdata   = m_core->M_AXIS_TDATA & 0x0ff;
+		tlast   = m_core->M_AXIS_TLAST;
+		tid     = m_core->M_AXIS_TID;
+
+		WB_TB<Vwbi2ccpu>::tick();
+
+		m_sink.clock(tvalid, tdata, tlast, tid);
+		m_core->M_AXIS_TREADY = m_sink.tready();
+
+		m_imem.clock(pf_cyc, pf_stb, false, pf_addr, 0, 0x0f);
+		// Nothing is acknowledged once the CPU abandons its fetch
+		if (!m_core->o_pf_cyc)
+			m_imem.abort();
+		m_core->i_pf_stall = m_imem.stall();
+		m_core->i_pf_ack   = m_imem.ack();
+		m_core->i_pf_err   = m_imem.err();
+		m_core->i_pf_data  = m_imem.data();
+		// }}}
+
+		skip_idle();
+	}
+
+	// Fast-forward
+	// {{{
+	// Between I2C bus edges, the CPU does little more than wait on its
+	// clock divider, i2c_ckcount, for the next i2c_ckedge.  While an
+	// instruction is waiting for that edge, the fetch bus is quiet, and
+	// the I2C bus has settled (through the synchronizers), nothing else
+	// in the core changes until the divider runs out.  Stop two clocks
+	// short of that, so the edge itself is simulated.
+	unsigned long	idle_ticks(void) {
+		unsigned long	nticks;
+
+		// The other master and the fault injector act on schedules
+		// of their own
+		if (m_rival || m_fault)
+			return 0;
+		if (m_core->i_reset || m_core->i_wb_cyc || m_core->o_wb_ack)
+			return 0;
+		// The settled count covers the clocks before this last edge,
+		// so check nothing moved on the edge itself, either
+		if (m_settled < 4 || m_core->o_pf_cyc || m_core->M_AXIS_TVALID
+				|| m_core->o_i2c_scl != m_last_drv.m_scl
+				|| m_core->o_i2c_sda != m_last_drv.m_sda)
+			return 0;
+		if (!m_core->insn_valid || m_core->s_tready || m_core->r_wait)
+			return 0;
+		if (m_core->i2c_ckedge || m_core->i2c_ckcount < 3)
+			return 0;
+
+		nticks = m_core->i2c_ckcount - 2;
+#ifdef	CPU_WATCHDOG
+		// Don't let the watchdog reach its timeout while skipping
+		if (m_core->channel_busy) {
+			const unsigned long	wdmax = (1ul << CPU_WATCHDOG) - 1;
+
+			if (m_core->watchdog + 1 >= wdmax)
+				return 0;
+			if (nticks > wdmax - 1 - m_core->watchdog)
+				nticks = wdmax - 1 - m_core->watchdog;
+		}
+#endif
+
+		if (nticks > m_i2c.idle_ticks())
+			nticks = m_i2c.idle_ticks();
+		return nticks;
+	}
+
+	void	skip_ticks(unsigned long nticks) {
+		I2CBUS	ib;
+
+		// The core.  Nothing reads i2c_ckcount between clock edges,
+		// so it may be written directly.
+		m_core->i2c_ckcount -= nticks;
+#ifdef	CPU_WATCHDOG
+		if (m_core->channel_busy)
+			m_core->watchdog += nticks;
+#endif
+
+		// The I2C bus
+		ib = m_i2c.skip(nticks);
+		assert(ib.m_scl == m_last_bus.m_scl
+				&& ib.m_sda == m_last_bus.m_sda);
+		if (m_i2c_active)
+			m_i2c_busy += nticks;
+
+		// The cheaper models are stepped, clock by clock, to keep
+		// their counters and random streams exactly where they'd be
+		for(unsigned long k=0; k<nticks; k++) {
+			m_stats(m_last_drv, m_last_bus);
+			if (m_mon)
+				(*m_mon)(m_last_drv, m_last_bus);
+			m_imem.clock(false, false, false, 0, 0, 0);
+			m_sink.clock(false, 0, false, 0);
+		}
+		m_core->i_pf_stall = m_imem.stall();
+		m_core->i_pf_ack   = m_imem.ack();
+		m_core->i_pf_err   = m_imem.err();
+		m_core->M_AXIS_TREADY = m_sink.tready();
+	}
+	// }}}
+
+	// Lockstep
+	// {{{
+	// The instruction the CPU issues is in bits [11:0] of its debug
+	// output, in the same format the ISS uses.  Only SEND and CHANNEL
+	// have an immediate--otherwise, the low eight bits are left over from
+	// whatever came before.
+	void	check_lockstep(bool issued) {
+		const unsigned	rtl = m_core->o_debug & 0x0fff;
+		I2CISSINSN	in;
+		bool		expected, ok;
+
+		if (issued) {
+			const unsigned	op = (rtl >> 8) & 0x0f;
+
+			ok = expected = m_iss->issue(in, !m_core->i2c_abort);
+			if (ok && op != ((in.m_insn >> 8) & 0x0f))
+				ok = false;
+			if (ok && (op == I2CISS_SEND || op == I2CISS_CHANNEL)
+					&& (rtl & 0x0ff) != (in.m_insn & 0x0ff))
+				ok = false;
+
+			if (!ok) {
+				fprintf(stderr, "ERR: Lockstep mismatch, clock %ld, after %ld instructions\n",
+					m_tickcount, m_matched);
+				fprintf(stderr, "ERR: CPU issued  %-7s (0x%03x)\n",
+					I2CISS::mnemonic(op), rtl);
+				if (!expected)
+					fprintf(stderr, "ERR: ISS expected nothing, having halted\n");
+				else {
+					fprintf(stderr, "ERR: ISS expected ");
+					I2CISS::dump(stderr, in);
+				}
+				closetrace();
+				exit(EXIT_FAILURE);
+			}
+			m_matched++;
+		}
+
+		if (m_core->i2c_abort)
+			m_iss->abort();
+	}
+	// }}}
+
+	// Start the CPU running from the given address
+	void	run(unsigned addr) {
+		if (m_iss)
+			m_iss->jump(addr);
+		wb_write(ADR_ADDRESS, addr);
+	}
+
+	bool	halted(void) {
+		return m_core->o_interrupt;
+	}
+};
+
+// The options wbi2ccpu_tb takes beyond those of every CPU bench
+static const CPUBENCH_OPT	cpu_opts[] = {
+	// {{{
+	{ 'F', "<fault>", true,
+"\tInjects faults into the bus, either <type>:<prob>[:<ticks>]\n"
+"\t\tfor a fault with probability <prob> at every byte, or\n"
+"\t\t<type>@<clock>[:<ticks>] for one at a given clock.  <type>\n"
+"\t\tis nak, sda (held low), scl (held low), or glitch (SCL\n"
+"\t\tpulled low briefly).  <ticks> is how long the fault lasts,\n"
+"\t\tforever by default for sda and scl.  Since the CPU can only\n"
+"\t\trecover from a stuck bus via its watchdog, build it with\n"
+"\t\tCPU_WATCHDOG=<bits> in rtl/ for those.  May be given more\n"
+"\t\tthan once.\n" },
+	{ 'j', NULL, false,
+"\tJumps over the clocks where the CPU is doing nothing but waiting\n"
+"\t\ton its clock divider, rather than simulating each, so that slow\n"
+"\t\tbuses simulate quickly.  Clock counts are unaffected.  Has no\n"
+"\t\teffect with -x or -F.\n" },
+	{ 'L', NULL, false,
+"\tRuns the script on the native instruction set simulator, as\n"
+"\t\twbi2ccpu_iss does, in lockstep with the CPU.  Every instruction\n"
+"\t\tthe CPU issues is checked against the one the script calls\n"
+"\t\tfor, stopping at the first that differs.\n" },
+	{ 'x', "<period>[:<devaddr>]", false,
+"\tAdds a second master to the bus, to compete\n"
+"\t\twith the CPU for it.  It starts a transaction of its own\n"
+"\t\tto <devaddr> (default 0x48, where a slave will be added)\n"
+"\t\tevery <period> clocks or so.  Each time the CPU loses\n"
+"\t\tarbitration it aborts, and the clocks it then takes to\n"
+"\t\tissue its next instruction are reported.\n" },
+	{ 0, NULL, false, NULL }
+	// }}}
+};
+
+int	main(int argc, char **argv) {
+	// {{{
+	CPUBENCH	cpu("wbi2ccpu_tb", cpu_opts);
+	CPU_TB		*tb;
+	unsigned	rival_addr = DEFAULT_RIVAL;
+	unsigned long	start_clk, nclks, rival_period = 0;
+	I2CSIMMASTER	*rival = NULL;
+	I2CFAULT	*fault = NULL;
+	const char	*faults[I2CFAULT_MAXSPECS];
+	unsigned	nfaults = 0;
+	bool		tb_halted, jump = false, lockstep = false;
+	int		opt;
+
+	Verilated::commandArgs(argc, argv);
+
+	// Argument processing
+	// {{{
+	while((opt = cpu.getopt(argc, argv)) != -1) {
+		switch(opt) {
+		case 'F':
+			if (nfaults >= I2CFAULT_MAXSPECS) {
+				fprintf(stderr, "ERR: Too many faults\n");
+				exit(EXIT_FAILURE);
+			}
+			faults[nfaults++] = optarg;
+			break;
+		case 'j': jump = true; break;
+		case 'L': lockstep = true; break;
+		case 'x': {
+			char	*ptr;
+
+			rival_period = strtoul(optarg, &ptr, 0);
+			if (*ptr == ':')
+				rival_addr = strtoul(ptr+1, NULL, 0) & 0x07f;
+			} break;
+		}
+	}
+	// }}}
+
+	tb = new CPU_TB();
+	cpu.imem(tb->imem());
+	cpu.setup(*tb);
+	if (rival_period) {
+		// One I2C bit takes four clock edges, each ckcount+1 clocks.
+		// Let the other master START anywhere from one clock to a full
+		// bit after the bus goes free, so that it will sometimes START
+		// together with the CPU.
+		unsigned	halfbit = 2*(cpu.m_ckcount+1);
+
+		if (tb->i2cbus().slave(rival_addr) == NULL)
+			tb->i2cbus().add(rival_addr);
+		rival = tb->rival(rival_addr, rival_period, halfbit,
+							cpu.m_rng.next());
+		rival->holdoff(1, 2*halfbit);
+	}
+	if (nfaults > 0) {
+		fault = tb->fault(cpu.m_rng.next());
+		for(unsigned k=0; k<nfaults; k++) {
+			if (!fault->add(faults[k])) {
+				fprintf(stderr, "ERR: Bad fault, %s\n", faults[k]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	tb->fast_forward(jump);
+	if (lockstep)
+		tb->lockstep();
+
+	cpu.load(*tb);
+
+	tb->reset();
+	tb->wb_write(ADR_CKCOUNT, cpu.m_ckcount);
+	tb->run(cpu.m_start_addr);
+
+	cpu.start();
+	start_clk = tb->m_tickcount;
+	do {
+		tb->m_core->i_sync_signal = cpu.sync(tb->m_tickcount - start_clk);
+		tb->tick();
+		nclks = tb->m_tickcount - start_clk;
+	} while(!tb->halted() && nclks < cpu.m_maxclks);
+	cpu.stop();
+	tb_halted = tb->halted();
+
+	printf("\n");
+	if (tb_halted) {
+		unsigned	ctrl = tb->wb_read(ADR_CONTROL),
+				pc   = tb->wb_read(ADR_ADDRESS);
+		printf("Halted after %ld clocks, PC = 0x%08x, CONTROL = 0x%08x\n",
+			nclks, pc, ctrl);
+	} else
+		printf("Timed out after %ld clocks, script still running\n",
+			nclks);
+
+	cpu.report(*tb, nclks);
+	printf("Fetch bus utilization: %10.2f%%\n",
+		100.0 * tb->pf_busy() / (double)nclks);
+	printf("Fetches:               %10ld, %ld clocks stalled, %ld abandoned\n",
+		tb->imem().requests(), tb->imem().stalls(),
+		tb->imem().aborts());
+	printf("I2C clocks held off:   %10ld\n", tb->backpressure_scl());
+	if (rival) {
+		printf("Lost arbitration:      %10ld\n", tb->lost());
+		printf("Other master:          %10ld attempts, %ld completed, %ld lost\n",
+			rival->attempts(), rival->completed(),
+			rival->lost());
+	}
+	if (tb->aborts() > 0)
+		tb->recovery().dump(stdout, "Clocks from abort to next instruction");
+
+	// How much the fetch latency slows the bus, between bits (SCL low)
+	// and between transactions
+	tb->imem().latency().dump(stdout, "Fetch latency, clocks");
+	tb->stats().scl_low().dump(stdout, "SCL low time");
+	tb->stats().idle().dump(stdout, "I2C idle, STOP to START");
+	tb->sink().dump(stdout);
+	if (fault)
+		fault->dump(stdout);
+	if (lockstep)
+		printf("Lockstep matched:      %10ld instructions\n",
+			tb->matched());
+	if (jump)
+		printf("Clocks skipped:        %10ld (%.2f%%)\n", tb->skipped(),
+			100.0 * tb->skipped() / (double)nclks);
+	cpu.report_rate(nclks);
+
+	delete tb;
+
+	exit((tb_halted) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+// }}}
@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2cm_arb.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	An arbitration benchmark for the I2C master.  A second, simulated
+//		master (I2CSIMMASTER) shares the bus with the core, starting
+//	transactions of its own at random times.  Every so often both masters
+//	will START together, and one of them must lose arbitration.  When the
+//	core loses, it reports the error in bit 30 of its status register, and
+//	this program issues the command again--much as software would.
+//	Reported are how often the core lost the bus, and the number of clocks
+//	it took to recover: from the failed command completing until its
+//	retry (or retries) finally succeeded.
+//
+//	Faults may also be injected into the bus (see I2CFAULT), with or
+//	without the second master, in which case the clocks from each fault
+//	until the core's next command succeeds are reported as well.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "verilated.h"
+#include "Vwbi2cmaster.h"
+
+#include "testb.h"
+#include "tbrand.h"
+#include "tbhist.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "i2cfault.h"
+#include "wbi2cm_tb.h"
+
+#define	DEFAULT_NCMDS	1000
+#define	DEFAULT_SPEED	40
+#define	DEFAULT_PERIOD	20000ul
+#define	DEFAULT_RIVAL	0x48
+#define	MAXLEN		8
+#define	MAXRETRIES	32
+#define	MAXFAULTS	I2CFAULT_MAXSPECS
+
+void	usage(void) {
+	printf("USAGE: wbi2cm_arb [-h] [-d <devaddr>] [-F <fault>]* [-n <ncmds>]\n"
+"\t\t[-p <period>] [-s <speed>] [-S <seed>] [-t <timeout>]\n"
+"\n"
+"\t-d <devaddr>\tThe (7-bit) device the competing master addresses.  A\n"
+"\t\tslave is added there if need be.  Defaults to 0x%02x which,\n"
+"\t\tbeing below the core\'s slave at 0x%02x, wins arbitration\n"
+"\t\tduring the device word.  Use 0x%02x to contend over the\n"
+"\t\tdata instead.\n"
+"\t-F <fault>\tInjects faults into the bus.  <fault> is either\n"
+"\t\t<type>:<prob>[:<ticks>], to inject with probability <prob>\n"
+"\t\tat every byte, or <type>@<tick>[:<ticks>], to inject once.\n"
+"\t\t<type> is nak, sda (held low), scl (held low), or glitch\n"
+"\t\t(SCL pulled low briefly).  <ticks> is how long the fault\n"
+"\t\tlasts, forever by default for sda and scl.  May be given\n"
+"\t\tmore than once.\n"
+"\t-n <ncmds>\tThe number of commands to complete.  Defaults to %d.\n"
+"\t-p <period>\tThe mean number of clocks between the competing\n"
+"\t\tmaster\'s transactions.  Defaults to %ld.  Zero leaves the\n"
+"\t\tcore alone on the bus.\n"
+"\t-s <speed>\tThe R_SPEED value to use, in clocks per quarter bit.\n"
+"\t\tDefaults to %d.  The competing master runs at the same rate.\n"
+"\t-S <seed>\tSeeds the commands, the competing master, and the\n"
+"\t\tfaults\n"
+"\t-t <timeout>\tGive up on a command after <timeout> clocks.  The\n"
+"\t\tdefault is long enough for any command, but not for the\n"
+"\t\tcore\'s bus watchdog\n"
+"\n"
+"\tResults are written to stdout.\n",
+		DEFAULT_RIVAL, SLAVE_ADDRESS, SLAVE_ADDRESS,
+		DEFAULT_NCMDS, DEFAULT_PERIOD, DEFAULT_SPEED);
+}
+
+//
+// run_cmd
+// {{{
+// Issue one command to the core, and wait for o_int.  Returns the number of
+// clocks from the command being issued to o_int, or zero on a timeout.  On
+// return, *contended is set if the competing master was on the bus, or a
+// fault had been injected, at any time while the command was running.
+unsigned long	run_cmd(I2CM_TB *tb, unsigned cmd, unsigned long timeout,
+			bool *contended) {
+	unsigned long	start;
+
+	*contended = false;
+	start = tb->m_tickcount;
+	tb->wb_write(R_CMD, cmd);
+
+	// The core takes a clock or two to leave the idle state
+	tb->tick();
+	tb->tick();
+	while(0 == tb->m_core->o_int) {
+		if (tb->m_tickcount - start > timeout)
+			return 0;
+		if (tb->rival() && tb->rival()->active())
+			*contended = true;
+		if (tb->fault() && tb->fault()->pending())
+			*contended = true;
+		tb->tick();
+	}
+
+	return tb->m_tickcount - start;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	// {{{
+	I2CM_TB		*tb;
+	I2CSIMMASTER	*rival = NULL;
+	I2CFAULT	*fault = NULL;
+	TBRAND		rng;
+	TBHIST		clean, recovery, retries;
+	unsigned	ncmds = DEFAULT_NCMDS, speed = DEFAULT_SPEED,
+			rdev = DEFAULT_RIVAL;
+	unsigned long	period = DEFAULT_PERIOD, timeout = 0, nlost = 0,
+			ncontended = 0, nerrs = 0, start_clk, nclks;
+	const char	*seedstr = NULL, *faults[MAXFAULTS];
+	int		opt, nfaults = 0;
+
+	Verilated::commandArgs(argc, argv);
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "hd:F:n:p:s:S:t:")) != -1) {
+		switch(opt) {
+		case 'd': rdev = strtoul(optarg, NULL, 0) & 0x07f; break;
+		case 'F':
+			if (nfaults >= MAXFAULTS) {
+				fprintf(stderr, "ERR: Too many faults\n");
+				exit(EXIT_FAILURE);
+			}
+			faults[nfaults++] = optarg;
+			break;
+		case 'n': ncmds = strtoul(optarg, NULL, 0); break;
+		case 'p': period = strtoul(optarg, NULL, 0); break;
+		case 's': speed = strtoul(optarg, NULL, 0);
+			if (speed < 2) {
+				fprintf(stderr, "ERR: Invalid speed, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} break;
+		case 'S': seedstr = optarg; break;
+		case 't': timeout = strtoul(optarg, NULL, 0); break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	rng.reseed(tbrand_seed(seedstr));
+
+	tb = new I2CM_TB();
+	if (period) {
+		if (tb->i2cbus().slave(rdev) == NULL)
+			tb->i2cbus().add(rdev, MEM_ADDR_BITS);
+
+		// One half bit of the core is two of its quarter bits.  Let
+		// the competing master START anywhere from one clock to a full
+		// bit after the bus goes free, so that it will sometimes START
+		// together with the core.
+		rival = tb->rival(rdev, period, 2*speed, rng.next());
+		rival->holdoff(1, 4*speed);
+		rival->maxlen(MAXLEN);
+	}
+
+	if (nfaults > 0) {
+		fault = tb->fault(rng.next());
+		for(int k=0; k<nfaults; k++) {
+			if (!fault->add(faults[k])) {
+				fprintf(stderr, "ERR: Bad fault, %s\n", faults[k]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	tb->reset();
+	tb->wb_write(R_SPEED, speed);
+
+	// About 40 quarter bits per byte, plus the device and address bytes,
+	// plus stretching, plus waiting on the other master
+	if (timeout == 0)
+		timeout = (unsigned long)speed * 40 * (2*MAXLEN+8) + 100000;
+
+	start_clk = tb->m_tickcount;
+	for(unsigned k=0; k<ncmds; k++) {
+		unsigned	ln, addr, cmd, status, ntries = 0;
+		unsigned long	latency, failed_at = 0;
+		bool		contended, lost = false;
+
+		ln   = 1 + rng.range(MAXLEN);
+		addr = rng.range(FULMEMSZ);
+		cmd  = (rng.flip()) ? READCMD(SLAVE_ADDRESS, addr, ln)
+				: WRITECMD(SLAVE_ADDRESS, addr, ln);
+
+		do {
+			latency = run_cmd(tb, cmd, timeout, &contended);
+			if (latency == 0) {
+				printf("ERR: Timeout, CMD = %08x\n", cmd);
+				nerrs++;
+				break;
+			}
+
+			status = tb->wb_read(R_CMD);
+			if (contended)
+				ncontended++;
+			if (0 == (status & (1u<<30))) {
+				// A command that succeeds ends any fault
+				if (fault)
+					fault->recovered();
+				break;
+			}
+
+			// The command failed.  If the other master was
+			// on the bus at the time, we lost arbitration to it--
+			// or, if a fault was injected, we ran into that.
+			// Otherwise, something else is wrong.
+			if (!contended) {
+				printf("ERR: Uncontended failure, CMD = %08x, STATUS = %08x\n",
+					cmd, status);
+				nerrs++;
+			}
+			if (!lost)
+				failed_at = tb->m_tickcount;
+			lost = true;
+			nlost++;
+		} while(++ntries < MAXRETRIES);
+
+		if (ntries >= MAXRETRIES) {
+			printf("ERR: Too many retries, CMD = %08x\n", cmd);
+			nerrs++;
+		} else if (lost) {
+			recovery.add(tb->m_tickcount - failed_at);
+			retries.add(ntries);
+		} else if (latency)
+			clean.add(latency);
+
+		if (nerrs)
+			break;
+
+		// Some random idle time between commands, so that we don't
+		// always come back to the bus at the same point in the
+		// other master's holdoff
+		for(unsigned i=rng.range(8*speed); i>0; i--)
+			tb->tick();
+	}
+	nclks = tb->m_tickcount - start_clk;
+
+	printf("Commands:              %10d\n", ncmds);
+	printf("Contended attempts:    %10ld\n", ncontended);
+	printf("Failed attempts:       %10ld (%.3f%% of attempts)\n", nlost,
+		100.0 * nlost / (double)(ncmds + nlost));
+	if (rival)
+		printf("Other master:          %10ld attempts, %ld completed, %ld lost\n",
+			rival->attempts(), rival->completed(),
+			rival->lost());
+	if (fault) {
+		printf("Protocol errors:       %10ld\n",
+			tb->i2cbus().protocol_errors());
+		fault->dump(stdout);
+	}
+	printf("Clocks:                %10ld\n", nclks);
+	clean.dump(stdout, "Clocks per command, on the first try");
+	recovery.dump(stdout, "Recovery clocks, from failure to success");
+	retries.dump(stdout, "Retries per lost command");
+
+	delete tb;
+
+	if (nerrs) {
+		printf("FAIL: %ld errors\n", nerrs);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("SUCCESS!\n");
+	exit(EXIT_SUCCESS);
+}
+// }}}
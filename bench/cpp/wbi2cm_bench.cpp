@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2cm_bench.cpp
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A throughput benchmark for the I2C master.  Rather than
+//		checking for correctness, as wbi2cm_tb does, this program
+//	sweeps the bus speed (R_SPEED) and the transfer length, issuing both
+//	WRITECMD and READCMD transactions to the slave model, and then reports
+//	for each the number of clocks from the command being issued until
+//	o_int is raised, together with the bytes per clock that results.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "verilated.h"
+#include "Vwbi2cmaster.h"
+
+#include "testb.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "wbi2cm_tb.h"
+
+#define	MAXSPEEDS	32
+#define	DEFAULT_CLKHZ	100e6
+
+// Bus speeds, in clocks per I2C quarter bit, to sweep by default
+static const unsigned	default_speeds[] = { 10, 20, 40, 100, 250, 1000 };
+
+// Transfer lengths, in bytes, to sweep by default.  The command word can only
+// hold 127 bytes in its count field.
+static const unsigned	default_lengths[] = { 1, 2, 4, 8, 16, 32, 64, CMEMMSK };
+
+void	usage(void) {
+	printf("USAGE: wbi2cm_bench [-h] [-a] [-l] [-z] [-f <clkhz>] [-s <speed>]*\n"
+"\n"
+"\t-a\tSweep all transfer lengths, from 1 through %d bytes, rather than\n"
+"\t\tjust the powers of two\n"
+"\t-f <clkhz>\tSets the system clock rate used to report bytes per\n"
+"\t\tsecond.  Defaults to %.0f\n"
+"\t-l\tUse a transaction level slave model.  This never stretches\n"
+"\t\tthe clock, and skips the model\'s bit level checks\n"
+"\t-s <speed>\tAdds <speed> to the list of R_SPEED values to be swept.\n"
+"\t\tMay be given more than once.  If not given, the speeds\n"
+"\t\t10, 20, 40, 100, 250, and 1000 are swept.\n"
+"\t-z\tUse a slave that never stretches the clock on an ACK\n"
+"\n"
+"\tResults are written to stdout, one line per speed, direction, and\n"
+"\tlength.\n", CMEMMSK, DEFAULT_CLKHZ);
+}
+
+//
+// run_cmd
+// {{{
+// Issue one command to the core, and count the clocks until the core signals
+// that it has completed via o_int.  Returns the number of clocks from the
+// command being issued to o_int, or zero on a timeout.
+unsigned long	run_cmd(I2CM_TB *tb, unsigned cmd, unsigned long timeout) {
+	unsigned long	start, latency;
+
+	start = tb->m_tickcount;
+	tb->wb_write(R_CMD, cmd);
+
+	// The core takes a clock or two to leave the idle state
+	tb->tick();
+	tb->tick();
+	while(0 == tb->m_core->o_int) {
+		if (tb->m_tickcount - start > timeout)
+			return 0;
+		tb->tick();
+	}
+	latency = tb->m_tickcount - start;
+
+	return latency;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	// {{{
+	I2CM_TB	*tb;
+	unsigned	speeds[MAXSPEEDS], nspeeds = 0;
+	unsigned	lengths[FULMEMSZ], nlengths = 0;
+	bool		all_lengths = false, no_stretch = false, tlm = false;
+	double		clkhz = DEFAULT_CLKHZ;
+	int		opt, nerrs = 0;
+
+	Verilated::commandArgs(argc, argv);
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "halzf:s:")) != -1) {
+		switch(opt) {
+		case 'a': all_lengths = true; break;
+		case 'l': tlm = true; break;
+		case 'z': no_stretch = true; break;
+		case 'f': clkhz = atof(optarg);
+			if (clkhz <= 0) {
+				fprintf(stderr, "ERR: Invalid clock rate, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} break;
+		case 's':
+			if (nspeeds >= MAXSPEEDS) {
+				fprintf(stderr, "ERR: Too many speeds\n");
+				exit(EXIT_FAILURE);
+			}
+			speeds[nspeeds] = strtoul(optarg, NULL, 0);
+			if (speeds[nspeeds] < 2) {
+				fprintf(stderr, "ERR: Invalid speed, %s\n", optarg);
+				exit(EXIT_FAILURE);
+			} nspeeds++;
+			break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	if (nspeeds == 0) {
+		for(unsigned k=0; k<sizeof(default_speeds)/sizeof(unsigned); k++)
+			speeds[nspeeds++] = default_speeds[k];
+	}
+
+	if (all_lengths) {
+		for(unsigned k=1; k<=CMEMMSK; k++)
+			lengths[nlengths++] = k;
+	} else {
+		for(unsigned k=0; k<sizeof(default_lengths)/sizeof(unsigned); k++)
+			lengths[nlengths++] = default_lengths[k];
+	}
+	// }}}
+
+	tb = new I2CM_TB();
+	if (no_stretch)
+		tb->slave().stretch(0);
+	tb->i2cbus().transaction_level(tlm);
+	tb->reset();
+
+	printf("%5s %3s %4s %10s %10s %10s %12s\n",
+		"SPEED", "DIR", "LEN", "LATENCY", "CLKS/BYTE",
+		"BYTES/CLK", "BYTES/SEC");
+	for(unsigned s=0; s<nspeeds; s++) {
+		// Allow a generous timeout: about 40 quarter bits per byte,
+		// plus the device and address bytes, plus stretching
+		unsigned long	timeout = (unsigned long)speeds[s]
+					* 40 * (FULMEMSZ+4) + 100000;
+
+		tb->wb_write(R_SPEED, speeds[s]);
+		for(int dir=0; dir<2; dir++) {
+			for(unsigned k=0; k<nlengths; k++) {
+				unsigned	ln = lengths[k], cmd, status;
+				unsigned long	latency;
+
+				cmd = (dir) ? READCMD(SLAVE_ADDRESS, 0, ln)
+					: WRITECMD(SLAVE_ADDRESS, 0, ln);
+				latency = run_cmd(tb, cmd, timeout);
+				if (latency == 0) {
+					printf("%5d %3s %4d %10s\n", speeds[s],
+						(dir) ? "RD":"WR", ln,
+						"TIMEOUT");
+					nerrs++;
+					continue;
+				}
+
+				// On completion, the address should have
+				// advanced by the number of bytes transferred
+				status = tb->wb_read(R_CMD);
+				if (status != WRITECMD(SLAVE_ADDRESS, ln, 0)) {
+					printf("ERR: Unexpected status, %08x\n",
+						status);
+					nerrs++;
+				}
+
+				printf("%5d %3s %4d %10ld %10.1f %10.6f %12.1f\n",
+					speeds[s], (dir) ? "RD":"WR", ln,
+					latency, latency / (double)ln,
+					ln / (double)latency,
+					ln * clkhz / (double)latency);
+
+				// Give the bus some idle time before the
+				// next command
+				for(unsigned i=0; i<speeds[s]*8; i++)
+					tb->tick();
+			}
+		}
+	}
+
+	delete tb;
+
+	if (nerrs) {
+		printf("FAIL: %d errors\n", nerrs);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("SUCCESS!\n");
+	exit(EXIT_SUCCESS);
+}
+// }}}
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2cm_regs.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	The register map and command format of the I2C master,
+//		wbi2cmaster, for those programs that drive it over its
+//	Wishbone port.  Unlike wbi2cm_tb.h, this brings in no test bench, and
+//	none of the bus models that go with it.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBI2CM_REGS_H
+#define	WBI2CM_REGS_H
+
+#define	MEM_ADDR_BITS	7
+#define	CMEMMSK		((1<<(MEM_ADDR_BITS))-1)
+#define	WMEMMSK		(CMEMMSK >> 2)
+#define	HALFMEM		(1<<(MEM_ADDR_BITS-1))
+#define	FULMEMSZ	(1<<(MEM_ADDR_BITS))
+
+#define	MASTER_WR	0
+#define	MASTER_RD	1
+
+// Address locations
+#define	R_CMD		0
+#define	R_CONTROL	R_CMD
+#define	R_COMMAND	R_CMD
+#define	R_SPEED		1
+#define	R_MEM		(1<<(MEM_ADDR_BITS-2))
+
+// Command format(s)
+#define	GENCMD(DEV,ADDR,CNT)	((((DEV)&0x07f)<<17)|(((ADDR)&CMEMMSK)<<8)|((CNT)&CMEMMSK))
+#define	READCMD(DEV,ADDR,CNT)	(GENCMD(DEV,ADDR,CNT)|(MASTER_RD<<16))
+#define	WRITECMD(DEV,ADDR,CNT)	(GENCMD(DEV,ADDR,CNT))
+
+#endif
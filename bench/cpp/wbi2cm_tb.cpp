@@ -49,124 +49,98 @@
 
 #include "byteswap.h"
 #include "testb.h"
+#include "tbrand.h"
 #include "wb_tb.h"
 #include "i2csim.h"
+#include "wbi2cm_tb.h"
 // #include "twoc.h"
 
-#ifdef	OLD_VERILATOR
-#define	VVAR(A)	v__DOT_ ## A
-#elif defined(ROOT_VERILATOR)
-#include "Vwbi2cmaster___024root.h"
-
-#define	VVAR(A)	rootp->wbi2cmaster__DOT_ ## A
-#else
-#define	VVAR(A)	wbi2cmaster__DOT_ ## A
-#endif
-
-#define	mem	VVAR(_mem.m_storage)
-
-
-#define	MEM_ADDR_BITS	7
-#define	CMEMMSK		((1<<(MEM_ADDR_BITS))-1)
-#define	WMEMMSK		(CMEMMSK >> 2)
-#define	HALFMEM		(1<<(MEM_ADDR_BITS-1))
-#define	FULMEMSZ	(1<<(MEM_ADDR_BITS))
-
-#define	SLAVE_ADDRESS	0x50
-#define	MASTER_WR	0
-#define	MASTER_RD	1
-
-// Address locations
-#define	R_CMD		0
-#define	R_CONTROL	R_CMD
-#define	R_COMMAND	R_CMD
-#define	R_SPEED		1
-#define	R_MEM		(1<<(MEM_ADDR_BITS-2))
-
 // Speed to command things
 #define	I2CSPEED	40
 
-// Command format(s)
-#define	GENCMD(DEV,ADDR,CNT)	((((DEV)&0x07f)<<17)|(((ADDR)&CMEMMSK)<<8)|((CNT)&CMEMMSK))
-#define	READCMD(DEV,ADDR,CNT)	(GENCMD(DEV,ADDR,CNT)|(MASTER_RD<<16))
-#define	WRITECMD(DEV,ADDR,CNT)	(GENCMD(DEV,ADDR,CNT))
-
 #define	TESTBREAK	for(int i=0; i<I2CSPEED * 1000; i++) tb->tick()
 
-class	I2CM_TB : public WB_TB<Vwbi2cmaster> {
-	I2CSIMSLAVE	m_slave;
-public:
-	I2CM_TB(void) : m_slave(0x50, MEM_ADDR_BITS) {
-		m_core->i_i2c_scl = 1;
-		m_core->i_i2c_sda = 1;
-	}
-
-	~I2CM_TB(void) {}
-
-	void	reset(void) {
-		// m_flash.debug(false);
-		TESTB<Vwbi2cmaster>::reset();
-	}
-
-	void	dbgdump(void) {}
-
-	void	tick(void) {
-		const bool	debug = false;
-		I2CBUS	ib;
-
-		ib = m_slave(m_core->o_i2c_scl, m_core->o_i2c_sda);
-		m_core->i_i2c_scl = ib.m_scl;
-		m_core->i_i2c_sda = ib.m_sda;
-		// m_core->i_vstate = m_slave.vstate();
-
-		if (debug)
-			dbgdump();
-		WB_TB<Vwbi2cmaster>::tick();
-	}
-
-	// Internally, the design keeps things in one memory 32-bits wide.
-	// To get at a byte, we need to select which byte from within it.
-	unsigned char operator[](const int addr) const {
-		unsigned int *memp;
-		int	wv;
-
-		memp = (unsigned int *)m_core->mem;
-		wv = memp[(addr>>2)&WMEMMSK];
-		wv >>= 8*(3-(addr&0x03));
-		return wv & 0x0ff;
-	}
-
-	I2CSIMSLAVE &slave(void) {
-		return m_slave;
-	}
-};
-
-void	randomize_buffer(unsigned nc, char *buf) {
-	if (true) {
-		const char	*fname = "/dev/urandom";
-		FILE	*fp = fopen(fname, "r");
-		unsigned	nr;
-		assert(fp);
-		nr = fread(buf, sizeof(char), nc, fp);
-		assert(nr == nc);
-		fclose(fp);
-	} else {
-		for(unsigned i=0; i<nc; i++)
-			buf[i] = (rand()&0x0ff);
-	}
-}
-
 //
 // Standard usage functions.
 //
-// Notice that the test bench provides no options.  Everything is
-// self-contained.
+// Everything within the test is self-contained.  The options only control
+// how (and whether) the test is traced and logged, and the seed used for its
+// random data.
 void	usage(void) {
-	printf("USAGE: wbi2cm_tb\n");
+	printf("USAGE: wbi2cm_tb [-h] [-n] [-t <vcd>] [-b <tick>] [-e <tick>] [-r <ticks>]\n"
+		"\t\t[-D <depth>] [-H <scope>] [-i] [-m <log>] [-s <seed>]\n"
+		"\t\t[-S <ckpt>] [-L <ckpt>]\n");
+	printf("\n");
+	printf("\t-n\tDon\'t write a trace file\n");
+	printf("\t-t <vcd>\tWrite the trace to <vcd>, rather than i2cm_tb.vcd.  If\n"
+		"\t\t<vcd> ends in .fst, the trace will be written in FST format\n");
+	printf("\t-b <tick>\tOnly trace from <tick> onwards\n");
+	printf("\t-e <tick>\tStop tracing at <tick>\n");
+	printf("\t-r <ticks>\tKeep only (at least) the last <ticks> ticks,\n"
+		"\t\tsplit between two trace files\n");
+	printf("\t-D <depth>\tOnly trace <depth> levels of the design\n");
+	printf("\t-H <scope>\tOnly trace the design beneath <scope>, such as\n"
+		"\t\tTOP.wbi2cmaster\n");
+	printf("\t-i\tDon\'t start tracing until the bus model sees an\n"
+		"\t\tillegal bus condition.  Nothing from before then is kept.\n");
+	printf("\t-m <log>\tLog every I2C bus transaction to <log>, as text, or\n"
+		"\t\tin binary if <log> ends in .bin\n");
+	printf("\t-s <seed>\tSeed the random test data with <seed>.  If not given,\n"
+		"\t\ta new seed is chosen.  Either way, the seed is reported\n"
+		"\t\tso that any failure can be repeated\n");
+	printf("\t-S <ckpt>\tSave a checkpoint to <ckpt> once the core has been\n"
+		"\t\treset, its memory loaded, and its speed set\n");
+	printf("\t-L <ckpt>\tSkip all of that, starting instead from the\n"
+		"\t\tcheckpoint in <ckpt>.  The seed is taken from the checkpoint.\n"
+		"\t\tBoth of these require a build with SAVABLE=1\n");
 	printf("\n");
 	printf("\tIf the last line returns in SUCCESS, then the test was successful\n");
 }
 
+#ifdef	TESTB_SAVABLE
+// Checkpoints
+// {{{
+// Besides the test bench, a checkpoint holds the test's own data: the memory
+// preloaded into the core, and the random stream that made it, so that a run
+// restored from a checkpoint is tick for tick the same as the run that saved
+// it.
+void	save_checkpoint(I2CM_TB *tb, const char *fname, const char *buf,
+		const TBRAND &rng) {
+	VerilatedSave	os;
+
+	os.open(fname);
+	if (!os.isOpen()) {
+		fprintf(stderr, "ERR: Cannot write checkpoint, %s\n", fname);
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+	tb->save_state(os);
+	os.write(buf, FULMEMSZ);
+	rng.save(os);
+	os.close();
+	printf("Checkpoint saved to %s, at tick %lu\n", fname, tb->m_tickcount);
+}
+
+void	load_checkpoint(I2CM_TB *tb, const char *fname, char *buf,
+		TBRAND &rng) {
+	VerilatedRestore	is;
+
+	is.open(fname);
+	if (!is.isOpen()) {
+		fprintf(stderr, "ERR: Cannot read checkpoint, %s\n", fname);
+		perror("O/S Err: ");
+		exit(EXIT_FAILURE);
+	}
+	tb->restore_state(is);
+	is.read(buf, FULMEMSZ);
+	rng.restore(is);
+	is.close();
+	printf("Restored from %s, at tick %lu, seed %lu\n", fname,
+		tb->m_tickcount, (unsigned long)rng.seed());
+}
+// }}}
+#endif
+
 //
 int	main(int argc, char **argv) {
 	// Setup
@@ -175,43 +149,105 @@ int	main(int argc, char **argv) {
 	char	buf[FULMEMSZ], tbuf[FULMEMSZ];
 	unsigned	addr, pre, post, wbaddr, rval;
 	unsigned long	prel, postl, rvall;
+	const char	*vcdname = (VM_TRACE_FST) ? "i2cm_tb.fst" : "i2cm_tb.vcd",
+			*trace_scope = NULL;
+	int		trace_levels = 99;
+	unsigned long	trace_from = 0, trace_until = ULONG_MAX, ring_depth = 0;
+	bool		trace_illegal = false;
+	const char	*seedstr = NULL, *logname = NULL,
+			*ckpt_save = NULL, *ckpt_load = NULL;
+	TBRAND		rng;
+	int		opt;
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "hnt:b:e:r:D:H:im:s:S:L:")) != -1) {
+		switch(opt) {
+		case 'n': vcdname = NULL; break;
+		case 't': vcdname = optarg; break;
+		case 'b': trace_from  = strtoul(optarg, NULL, 0); break;
+		case 'e': trace_until = strtoul(optarg, NULL, 0); break;
+		case 'r': ring_depth  = strtoul(optarg, NULL, 0); break;
+		case 'D': trace_levels = atoi(optarg); break;
+		case 'H': trace_scope = optarg; break;
+		case 'i': trace_illegal = true; break;
+		case 'm': logname = optarg; break;
+		case 's': seedstr = optarg; break;
+		case 'S': ckpt_save = optarg; break;
+		case 'L': ckpt_load = optarg; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
 
-	tb->reset();
-	tb->opentrace("i2cm_tb.vcd");
-	srand(2);
-
-	randomize_buffer(sizeof(buf), &buf[0]);
-
-	tb->wb_write(R_MEM, sizeof(buf)/4, (unsigned *)buf);
+#ifndef	TESTB_SAVABLE
+	if (ckpt_save || ckpt_load) {
+		fprintf(stderr, "ERR: Checkpoints require a build with SAVABLE=1\n");
+		exit(EXIT_FAILURE);
+	}
+#endif
 
-	//
-	//
-	//
-	//
-	//
-	//
-	//
-	//
-	// Test point 1 : check that what we've written to the controller (WB)
-	// is what we can read back (WB).
-	tb->wb_read(R_MEM, (unsigned)sizeof(buf)/4, (unsigned *)tbuf);
-	for(unsigned i=0; i<sizeof(buf); i++)
-		TBASSERT(*tb, (buf[i] == tbuf[i]));
+	if (ckpt_load) {
+#ifdef	TESTB_SAVABLE
+		load_checkpoint(tb, ckpt_load, buf, rng);
+#endif
+	} else {
+		rng.reseed(tbrand_seed(seedstr));
+		tb->reset();
+	}
 
-	byteswapbuf(sizeof(buf)/4, (unsigned *)buf);
+	if (vcdname) {
+		tb->trace_window(trace_from, trace_until);
+		tb->trace_ring(ring_depth);
+		tb->trace_depth(trace_levels);
+		tb->trace_scope(trace_scope);
+		tb->trace_wait(trace_illegal);
+		tb->opentrace(vcdname);
+	}
+	if (logname)
+		tb->monitor(logname);
+
+	if (!ckpt_load) {
+		rng.fill(sizeof(buf), &buf[0]);
+
+		tb->wb_write(R_MEM, sizeof(buf)/4, (unsigned *)buf);
+
+		//
+		//
+		//
+		//
+		//
+		//
+		//
+		//
+		// Test point 1 : check that what we've written to the controller
+		// (WB) is what we can read back (WB).
+		tb->wb_read(R_MEM, (unsigned)sizeof(buf)/4, (unsigned *)tbuf);
+		for(unsigned i=0; i<sizeof(buf); i++)
+			TBASSERT(*tb, (buf[i] == tbuf[i]));
+
+		byteswapbuf(sizeof(buf)/4, (unsigned *)buf);
+
+
+		tb->wb_write(R_SPEED, I2CSPEED);
+		{
+			unsigned	spd = tb->wb_read(R_SPEED);
+			if (spd != I2CSPEED) {
+				fprintf(stderr, "ERR: WRONG SPEED READ AFTER SETTING DEV SPD, %d != %d\n", spd, I2CSPEED);
+				TBASSERT(*tb, (spd == I2CSPEED));
+			}
+		}
 
+		TESTBREAK;
 
-	tb->wb_write(R_SPEED, I2CSPEED);
-	{
-		unsigned	spd = tb->wb_read(R_SPEED);
-		if (spd != I2CSPEED) {
-			fprintf(stderr, "ERR: WRONG SPEED READ AFTER SETTING DEV SPD, %d != %d\n", spd, I2CSPEED);
-			TBASSERT(*tb, (spd == I2CSPEED));
-		}
+#ifdef	TESTB_SAVABLE
+		if (ckpt_save)
+			save_checkpoint(tb, ckpt_save, buf, rng);
+#endif
 	}
 
-	TESTBREAK;
-
 	//
 	//
 	//
@@ -338,7 +374,7 @@ int	main(int argc, char **argv) {
 	//
 	//
 	// Now, let's try reading.  First, we'll scramble our buffer again.
-	randomize_buffer(sizeof(buf), &buf[0]);
+	rng.fill(sizeof(buf), &buf[0]);
 
 	tb->wb_write(R_MEM, sizeof(buf)/4, (unsigned *)buf);
 	// And verify that it was properly scrambled
@@ -383,7 +419,7 @@ int	main(int argc, char **argv) {
 	// Now let's try random access reading
 	printf("\n\nNext test: Reads from random I2C addresses\n\n\n");
 	// Randomize the buffer
-	randomize_buffer(sizeof(buf), &buf[0]);
+	rng.fill(sizeof(buf), &buf[0]);
 	// We'll fill the slave's buffer with these values
 	for(unsigned i=0; i<FULMEMSZ; i++) {
 		tb->slave()[i] = buf[i];
@@ -451,7 +487,7 @@ int	main(int argc, char **argv) {
 	//
 	printf("\n\nNext test: Reads from random I2C addresses, 2x at a time\n\n\n");
 	// Randomize the buffer (again)
-	randomize_buffer(sizeof(buf), &buf[0]);
+	rng.fill(sizeof(buf), &buf[0]);
 	// We'll fill the slave's buffer with these values
 	for(unsigned i=0; i<FULMEMSZ; i++) {
 		// Set the data ... the cheaters way that can only be done on a
@@ -508,6 +544,10 @@ int	main(int argc, char **argv) {
 	}
 
 
+	printf("\n");
+	tb->dump_stats(stdout);
+	printf("\n");
+
 	delete	tb;
 
 	// And declare success
@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2cm_tb.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Defines the I2CM_TB test bench class for the I2C master, so that
+//		it may be shared between the various programs that drive it.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBI2CM_TB_H
+#define	WBI2CM_TB_H
+
+#include "verilated.h"
+#include "Vwbi2cmaster.h"
+
+#include "testb.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "i2cmonitor.h"
+#include "i2cstats.h"
+#include "i2cfault.h"
+#include "wbi2cm_regs.h"
+
+#ifdef	OLD_VERILATOR
+#define	VVAR(A)	v__DOT_ ## A
+#elif defined(ROOT_VERILATOR)
+#include "Vwbi2cmaster___024root.h"
+
+#define	VVAR(A)	rootp->wbi2cmaster__DOT_ ## A
+#else
+#define	VVAR(A)	wbi2cmaster__DOT_ ## A
+#endif
+
+#define	mem	VVAR(_mem.m_storage)
+
+#define	SLAVE_ADDRESS	0x50
+
+class	I2CM_TB : public WB_TB<Vwbi2cmaster> {
+	I2CSIMBUS	m_i2c;
+	I2CMONITOR	*m_mon;
+	I2CSIMMASTER	*m_rival;
+	I2CBUS		m_rival_out;
+	I2CFAULT	*m_fault;
+	I2CSTATS	m_stats;
+	TBHIST		m_cmd_latency;
+	unsigned long	m_cmd_tick;
+	bool		m_cmd_pending, m_cmd_busy;
+public:
+	I2CM_TB(void) {
+		m_i2c.add(SLAVE_ADDRESS, MEM_ADDR_BITS);
+		m_mon = NULL;
+		m_rival = NULL;
+		m_fault = NULL;
+		m_cmd_tick = 0;
+		m_cmd_pending = false;
+		m_cmd_busy = false;
+		m_core->i_i2c_scl = 1;
+		m_core->i_i2c_sda = 1;
+	}
+
+	~I2CM_TB(void) {
+		if (m_mon)
+			delete m_mon;
+		if (m_rival)
+			delete m_rival;
+		if (m_fault)
+			delete m_fault;
+	}
+
+	// Log every bus transaction to the given file.  See I2CMONITOR.
+	void	monitor(const char *fname) {
+		if (!m_mon)
+			m_mon = new I2CMONITOR();
+		m_mon->open(fname);
+	}
+
+	// Add a second master to the bus, competing with the core for it.
+	// See I2CSIMMASTER.
+	I2CSIMMASTER	*rival(const int devaddr, unsigned long period,
+				const int halfbit, uint64_t seed) {
+		if (!m_rival)
+			m_rival = new I2CSIMMASTER(devaddr, period, halfbit,
+								seed);
+		return m_rival;
+	}
+
+	I2CSIMMASTER	*rival(void) { return m_rival; }
+
+	// Place a fault injector between the core and the bus.  See I2CFAULT.
+	// Whatever issues the commands must call I2CFAULT::recovered() once
+	// one succeeds (as wbi2cm_arb does), since only it can read back the
+	// status to know.  The slaves will no longer stop the simulation on
+	// a protocol violation, since the faults will cause them.
+	I2CFAULT	*fault(uint64_t seed) {
+		if (!m_fault) {
+			m_fault = new I2CFAULT(seed);
+			m_i2c.protocol(I2CSIM_IGNORE);
+		}
+		return m_fault;
+	}
+
+	I2CFAULT	*fault(void) { return m_fault; }
+
+	// Make sure the bus log is complete, should an assertion fail
+	void	closetrace(void) {
+		if (m_mon)
+			m_mon->flush();
+		TESTB<Vwbi2cmaster>::closetrace();
+	}
+
+	void	reset(void) {
+		// m_flash.debug(false);
+		TESTB<Vwbi2cmaster>::reset();
+	}
+
+	void	dbgdump(void) {}
+
+	// Trace trigger: the bus, or a slave on it, has seen an illegal bus
+	// condition
+	bool	trigger(void) {
+		return m_i2c.illegal();
+	}
+
+	void	tick(void) {
+		const bool	debug = false;
+		I2CBUS	drv, ib;
+
+		drv = I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda)
+							+ m_rival_out;
+		ib = (m_fault) ? (*m_fault)(drv, m_i2c) : m_i2c(drv);
+		if (m_rival)
+			m_rival_out = (*m_rival)(ib);
+		m_core->i_i2c_scl = ib.m_scl;
+		m_core->i_i2c_sda = ib.m_sda;
+		// m_core->i_vstate = slave().vstate();
+		if (m_mon)
+			(*m_mon)(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+		m_stats(I2CBUS(m_core->o_i2c_scl, m_core->o_i2c_sda), ib);
+
+		// Command latency: from the clock a command is written, until
+		// the interrupt shows the core is idle again.  The write only
+		// registers start_request, and r_busy (so !o_int) follows on
+		// the clock after that, so o_int is still high on the tick
+		// after the write.  It only counts once it has been seen low.
+		if (m_cmd_pending && !m_core->o_int)
+			m_cmd_busy = true;
+		else if (m_cmd_pending && m_cmd_busy) {
+			m_cmd_latency.add(m_tickcount - m_cmd_tick);
+			m_cmd_pending = false;
+			m_cmd_busy = false;
+		}
+		if (m_core->i_wb_stb && m_core->i_wb_we
+				&& m_core->i_wb_addr == R_CMD
+				&& !m_core->o_wb_stall) {
+			m_cmd_tick = m_tickcount;
+			m_cmd_pending = true;
+			m_cmd_busy = false;
+		}
+
+		if (debug)
+			dbgdump();
+		WB_TB<Vwbi2cmaster>::tick();
+	}
+
+#ifdef	TESTB_SAVABLE
+	// Checkpoints carry the simulated slave(s) and any command in flight,
+	// besides the core itself.  The bus log, any rival master or fault
+	// injector, and the statistics all start afresh following a restore.
+	void	save_state(VerilatedSerialize &os) {
+		WB_TB<Vwbi2cmaster>::save_state(os);
+		m_i2c.save(os);
+		os.write(&m_cmd_tick, sizeof(m_cmd_tick));
+		os.write(&m_cmd_pending, sizeof(m_cmd_pending));
+		os.write(&m_cmd_busy, sizeof(m_cmd_busy));
+	}
+
+	void	restore_state(VerilatedDeserialize &is) {
+		WB_TB<Vwbi2cmaster>::restore_state(is);
+		m_i2c.restore(is);
+		is.read(&m_cmd_tick, sizeof(m_cmd_tick));
+		is.read(&m_cmd_pending, sizeof(m_cmd_pending));
+		is.read(&m_cmd_busy, sizeof(m_cmd_busy));
+	}
+#endif
+
+	const I2CSTATS	&stats(void) const { return m_stats; }
+	const TBHIST	&cmd_latency(void) const { return m_cmd_latency; }
+
+	// Dump all of the statistics collected so far
+	void	dump_stats(FILE *fp) {
+		m_stats.dump(fp);
+		m_cmd_latency.dump(fp, "Command to interrupt");
+		wb_stalls().dump(fp, "WB stalls, per bus cycle");
+	}
+
+	// Internally, the design keeps things in one memory 32-bits wide.
+	// To get at a byte, we need to select which byte from within it.
+	unsigned char operator[](const int addr) const {
+		unsigned int *memp;
+		int	wv;
+
+		memp = (unsigned int *)m_core->mem;
+		wv = memp[(addr>>2)&WMEMMSK];
+		wv >>= 8*(3-(addr&0x03));
+		return wv & 0x0ff;
+	}
+
+	I2CSIMSLAVE &slave(void) {
+		return m_i2c[SLAVE_ADDRESS];
+	}
+
+	// The bus itself, so that other devices may be added to it
+	I2CSIMBUS &i2cbus(void) {
+		return m_i2c;
+	}
+};
+
+#endif
@@ -50,282 +50,51 @@
 
 #include "byteswap.h"
 #include "testb.h"
+#include "tbrand.h"
 #include "wb_tb.h"
+#include "wbi2cs_tb.h"
 // #include "twoc.h"
 
-#ifdef	OLD_VERILATOR
-#define	VVAR(A)	v__DOT_ ## A
-#elif defined(ROOT_VERILATOR)
-#include "Vwbi2cslave___024root.h"
-
-#define	VVAR(A)	rootp->wbi2cslave__DOT_ ## A
-#else
-#define	VVAR(A)	wbi2cslave__DOT_ ## A
-#endif
-
-#ifdef	ROOT_VERILATOR
-#define	mem	VVAR(_mem.m_storage)
-#else
-#define	mem	VVAR(_mem)
-#endif
-
-#define	MEM_ADDR_BITS	8
-#define	FULMEMSZ	(1<<(MEM_ADDR_BITS))
-
-#define	SLAVE_ADDRESS	0x50
-#define	SCK	m_core->i_i2c_scl
-#define	SDA	m_core->i_i2c_sda
-#define	MASTER_WR	0
-#define	MASTER_RD	1
-
-class	I2CS_TB : public WB_TB<Vwbi2cslave> {
-public:
-	I2CS_TB(void) {
-		SCK = 1;
-		SDA = 1;
-	}
-
-	~I2CS_TB(void) {}
-
-	void	reset(void) {
-		// m_flash.debug(false);
-		TESTB<Vwbi2cslave>::reset();
-	}
-
-	void	dbgdump(void) {}
-
-	void	tick(void) {
-		const bool	debug = false;
-		int	sck = SCK, sda = SDA;
-
-		SCK &= m_core->o_i2c_scl;
-		SDA &= m_core->o_i2c_sda;
-
-		if (debug)
-			dbgdump();
-		WB_TB<Vwbi2cslave>::tick();
-
-		SCK = sck & m_core->o_i2c_scl;
-		SDA = sda & m_core->o_i2c_sda;
-
-	}
-
-	// Internally, the design keeps things in one memory 32-bits wide.
-	// To get at a byte, we need to select which byte from within it.
-	unsigned char operator[](const int addr) const {
-		unsigned int *memp;
-		int	wv;
-
-		memp = (unsigned int *)m_core->mem;
-		wv = memp[(addr>>2)&((FULMEMSZ-1)>>2)];
-		wv >>= 8*(3-(addr&0x03));
-		return wv & 0x0ff;
-	}
-
-	void	i2c_halfwait(void) {
-		for(int i=0; i<8; i++)
-			tick();
-	}
-
-	void	i2c_wait(void) {
-		i2c_halfwait();
-		i2c_halfwait();
-	}
-
-	void	i2c_idle(void) {
-		for(int i=0; i<26; i++)
-			i2c_wait();
-	}
-
-	void	i2c_start() {
-		// printf("I2C-START\n");
-		TBASSERT(*this, ((SCK)&&(SDA)));
-		SDA = 0;
-		i2c_halfwait();
-		SCK = 0;
-		i2c_halfwait();
-	}
-
-	void	i2c_repeat_start() {
-		// printf("I2C-REPEAT-START\n");
-		TBASSERT(*this, (!SCK));
-		SDA = 1;
-		i2c_halfwait();
-		SCK = 1;
-		i2c_halfwait();
-		i2c_start();
-	}
-
-	void	i2c_stop() {
-		TBASSERT(*this, ((!SCK)&&(!SDA)));
-		SCK = 1;
-		i2c_halfwait();
-		SDA = 1;
-		i2c_halfwait();
-		// printf("I2C-STOP\n");
-	}
-
-	int	i2c_rxbit(void) {
-		int	r;
-
-		SDA = 1;
-		i2c_halfwait();
-		SCK = 1;
-		do {
-			i2c_halfwait();
-		} while(SCK == 0);
-		i2c_halfwait();
-		r = SDA;
-		SCK = 0;
-		i2c_halfwait();
-		TBASSERT(*this, (!SCK));
-
-		// printf("I2C-RX: %d\n", r);
-		return r;
-	}
-
-	void	i2c_txbit(int b) {
-		SDA = b;
-		i2c_halfwait();
-		SCK = 1;
-		do {
-			i2c_halfwait();
-		} while(SCK == 0);
-		i2c_halfwait();
-		SCK = 0;
-		i2c_halfwait();
-		TBASSERT(*this, (!SCK));
-	}
-
-	void	i2c_txbyte(const int b) {
-		int	tx = b;
-		for(int i=0; i<8; i++) {
-			i2c_txbit((tx>>7)&1);
-			tx <<= 1;
-		} // printf("TRANSMITTED %02x\n", b);
-	}
-
-	int	i2c_rxbyte(void) {
-		int	b = 0;
-		for(int i=0; i<8; i++) {
-			b = (b<<1) | i2c_rxbit();
-		}
-		// printf("I2C-READ: %02x\n", b);
-		return b;
-	}
-
-	void	i2c_read(int slave_addr, int addr,
-			const unsigned cnt, char *buf) {
-		int	ack;
-
-		if (cnt == 0)
-			return;
-
-		// printf("I2C_READ(SLV=%02x, ADR=%02x, CNT=%d,...)\n",
-		//	slave_addr, addr, cnt);
-
-		slave_addr <<= 1;
-		i2c_start();
-
-		// First, set the address
-		i2c_txbyte((slave_addr&0xfe)|MASTER_WR);//Master is sending data
-		ack = i2c_rxbit();	// (i.e., the address to rd from)
-		// printf("RXACK = %d\n", ack);
-		TBASSERT(*this, (ack==0));
-
-		i2c_txbyte(addr);	// Address we wish to read from
-		ack = i2c_rxbit();
-		// printf("RXACK = %d\n", ack);
-		TBASSERT(*this, (ack==0));
-
-		i2c_repeat_start();
-
-
-		// Then, read the data
-		i2c_txbyte((slave_addr&0xfe)|MASTER_RD); // Request data
-		ack = i2c_rxbit();
-		// printf("RXACK = %d\n", ack);
-		TBASSERT(*this, (ack==0));
-
-		for(unsigned i=0; i<cnt-1; i++) {
-			buf[i] = i2c_rxbyte();
-			i2c_txbit(0);
-			// printf("TX-ACK SENT\n");
-		}
-
-		buf[cnt-1] = i2c_rxbyte();
-
-		// Send a stop bit instead of an ack
-		SDA = 0;
-		i2c_halfwait();
-		i2c_stop();
-	}
-
-	void	i2c_read(int addr, const unsigned cnt, char *buf) {
-		i2c_read(SLAVE_ADDRESS, addr, cnt, buf);
-	}
-
-
-	void	i2c_write(int slave_addr, int addr,
-			const unsigned cnt, const char *buf) {
-		int	ack;
-
-		// printf("I2C_WRITE(SLV=%02x, ADR=%02x, CNT=%d,...)\n",
-		//	slave_addr, addr, cnt);
-
-		slave_addr <<= 1;
-		i2c_start();
-
-		i2c_txbyte((slave_addr&0xfe)|MASTER_WR);
-		ack = i2c_rxbit();
-		// printf("RXACK = %d\n", ack);
-		TBASSERT(*this, (ack==0));
-
-		i2c_txbyte(addr);
-		ack = i2c_rxbit();
-		// printf("RXACK = %d\n", ack);
-		TBASSERT(*this, (ack==0));
-
-		for(unsigned i=0; i<cnt; i++) {
-			i2c_txbyte(buf[i] & 0xff);
-			ack = i2c_rxbit();
-			// printf("RXACK = %d\n", ack);
-			TBASSERT(*this, (ack==0));
-		}
-
-		i2c_stop();
-	}
-
-	void	i2c_write(int addr, const unsigned cnt, const char *buf) {
-		i2c_write(SLAVE_ADDRESS, addr, cnt, buf);
-	}
-
-};
-
-void	randomize_buffer(unsigned nc, char *buf) {
-	if (true) {
-		const char	*fname = "/dev/urandom";
-		FILE	*fp = fopen(fname, "r");
-		unsigned	nr;
-		assert(fp);
-		nr = fread(buf, sizeof(char), nc, fp);
-		assert(nr == nc);
-		fclose(fp);
-	} else {
-		for(unsigned i=0; i<nc; i++)
-			buf[i] = (rand()&0x0ff);
-	}
-}
-
 //
 // Standard usage functions.
 //
-// Notice that the test bench provides no options.  Everything is
-// self-contained.
+// Everything within the test is self-contained.  The options only control
+// how (and whether) the test is traced, and the seed used for its random data
+// ... unless a capture is given to replay, in which case the capture replaces
+// the test.
 void	usage(void) {
-	printf("USAGE: wbi2cs_tb\n");
+	printf("USAGE: wbi2cs_tb [-h] [-n] [-t <vcd>] [-b <tick>] [-e <tick>] [-r <ticks>]\n"
+		"\t\t[-D <depth>] [-H <scope>] [-s <seed>]\n"
+		"\t\t[-p <capture> [-f <clkhz>] [-R <rate>] [-c <t>,<scl>,<sda>]]\n");
 	printf("\n");
-	printf("\t\n");
+	printf("\t-n\tDon\'t write a trace file\n");
+	printf("\t-t <vcd>\tWrite the trace to <vcd>, rather than i2cs_tb.vcd.  If\n"
+		"\t\t<vcd> ends in .fst, the trace will be written in FST format\n");
+	printf("\t-b <tick>\tOnly trace from <tick> onwards\n");
+	printf("\t-e <tick>\tStop tracing at <tick>\n");
+	printf("\t-r <ticks>\tKeep only (at least) the last <ticks> ticks,\n"
+		"\t\tsplit between two trace files\n");
+	printf("\t-D <depth>\tOnly trace <depth> levels of the design\n");
+	printf("\t-H <scope>\tOnly trace the design beneath <scope>, such as\n"
+		"\t\tTOP.wbi2cslave\n");
+	printf("\t-s <seed>\tSeed the random test data with <seed>.  If not given,\n"
+		"\t\ta new seed is chosen.  Either way, the seed is reported\n"
+		"\t\tso that any failure can be repeated\n");
+	printf("\t-p <capture>\tReplay a logic analyzer capture of SCL and SDA into\n"
+		"\t\tthe slave, rather than running the built-in test.  Captures\n"
+		"\t\tending in .csv are read as CSV, as from sigrok-cli -O csv,\n"
+		"\t\tanything else as raw samples, as from sigrok-cli -O binary\n");
+	printf("\t-f <clkhz>\tThe simulated clock rate, used to place each\n"
+		"\t\tcaptured sample on a clock tick.  Defaults to 100MHz\n");
+	printf("\t-R <rate>\tThe capture\'s sample rate, in Hz.  Required for\n"
+		"\t\tbinary captures, and CSV captures without a time column\n");
+	printf("\t-c <t>,<scl>,<sda>\tThe CSV columns (from 0) holding time,\n"
+		"\t\tSCL, and SDA.  A time column of -1 means there is none.\n"
+		"\t\tFor binary captures, these are instead the bytes per\n"
+		"\t\tsample and the bits holding SCL and SDA.  Defaults to\n"
+		"\t\t0,1,2 for CSV, 1,0,1 for binary\n");
+	printf("\n");
+	printf("\tIf the last line returns in SUCCESS, then the test was successful\n");
 }
 
 //
@@ -334,12 +103,90 @@ int	main(int argc, char **argv) {
 	Verilated::commandArgs(argc, argv);
 	I2CS_TB	*tb = new I2CS_TB();
 	char	buf[FULMEMSZ], tbuf[FULMEMSZ];
+	const char	*vcdname = (VM_TRACE_FST) ? "i2cs_tb.fst" : "i2cs_tb.vcd",
+			*trace_scope = NULL;
+	int		trace_levels = 99;
+	unsigned long	trace_from = 0, trace_until = ULONG_MAX, ring_depth = 0;
+	const char	*seedstr = NULL, *capname = NULL, *colstr = NULL;
+	double		clkhz = 100e6, caprate = 0;
+	TBRAND		rng;
+	int		opt;
+
+	// Argument processing
+	// {{{
+	while((opt = getopt(argc, argv, "hnt:b:e:r:D:H:s:p:f:R:c:")) != -1) {
+		switch(opt) {
+		case 'n': vcdname = NULL; break;
+		case 't': vcdname = optarg; break;
+		case 'b': trace_from  = strtoul(optarg, NULL, 0); break;
+		case 'e': trace_until = strtoul(optarg, NULL, 0); break;
+		case 'r': ring_depth  = strtoul(optarg, NULL, 0); break;
+		case 'D': trace_levels = atoi(optarg); break;
+		case 'H': trace_scope = optarg; break;
+		case 's': seedstr = optarg; break;
+		case 'p': capname = optarg; break;
+		case 'f': clkhz   = atof(optarg); break;
+		case 'R': caprate = atof(optarg); break;
+		case 'c': colstr  = optarg; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	rng.reseed(tbrand_seed(seedstr));
 
 	tb->reset();
-	tb->opentrace("i2cs_tb.vcd");
-	srand(2);
+	if (vcdname) {
+		tb->trace_window(trace_from, trace_until);
+		tb->trace_ring(ring_depth);
+		tb->trace_depth(trace_levels);
+		tb->trace_scope(trace_scope);
+		tb->opentrace(vcdname);
+	}
 
-	randomize_buffer(sizeof(buf), &buf[0]);
+	if (capname) {
+		// Replay a capture, reproducing its timing against the slave
+		// {{{
+		I2CREPLAY	cap(capname, clkhz);
+		unsigned long	ticks, mismatches;
+
+		if (caprate > 0)
+			cap.samplerate(caprate);
+		if (colstr) {
+			int	a, b, c;
+
+			if (sscanf(colstr, "%d,%d,%d", &a, &b, &c) != 3) {
+				fprintf(stderr, "ERR: Bad column list, %s\n", colstr);
+				exit(EXIT_FAILURE);
+			} if (cap.csv())
+				cap.columns(a, b, c);
+			else
+				cap.bits(b, c, a);
+		}
+
+		ticks = tb->replay(cap);
+		printf("Replayed %lu samples over %lu ticks (%.6f s)\n",
+			cap.samples(), ticks, ticks / clkhz);
+		mismatches = tb->mismatches();
+		printf("SDA mismatches: %lu\n", mismatches);
+
+		printf("\n");
+		tb->dump_stats(stdout);
+		printf("\n");
+
+		delete	tb;
+		if (mismatches > 0) {
+			printf("FAIL: %lu SDA mismatches\n", mismatches);
+			exit(EXIT_FAILURE);
+		}
+		printf("SUCCESS!\n");
+		exit(EXIT_SUCCESS);
+		// }}}
+	}
+
+	rng.fill(sizeof(buf), &buf[0]);
 
 	tb->wb_write(0, sizeof(buf)/4, (unsigned *)buf);
 
@@ -424,7 +271,7 @@ int	main(int argc, char **argv) {
 	}
 
 	// Test point 6: Write a new buffer, pairs of addresses at a time
-	randomize_buffer(sizeof(buf), buf);
+	rng.fill(sizeof(buf), buf);
 	printf("\n\nWRITE-TEST\n\n");
 	for(unsigned i=0, a=0; i<sizeof(buf); i++, a += 61*2) {
 		a &= (FULMEMSZ-2);
@@ -449,6 +296,10 @@ int	main(int argc, char **argv) {
 		TBASSERT(*tb, ((buf[i]&0x0ff) == ((*tb)[i]&0x0ff)));
 	}
 
+	printf("\n");
+	tb->dump_stats(stdout);
+	printf("\n");
+
 	delete	tb;
 
 	// And declare success
@@ -0,0 +1,357 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbi2cs_tb.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	Defines the I2CS_TB test bench class for the I2C slave, so that
+//		it may be shared between the various programs that drive it.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBI2CS_TB_H
+#define	WBI2CS_TB_H
+
+#include "verilated.h"
+#include "Vwbi2cslave.h"
+
+#include "testb.h"
+#include "wb_tb.h"
+#include "i2csim.h"
+#include "i2cstats.h"
+#include "i2creplay.h"
+
+#ifdef	OLD_VERILATOR
+#define	VVAR(A)	v__DOT_ ## A
+#elif defined(ROOT_VERILATOR)
+#include "Vwbi2cslave___024root.h"
+
+#define	VVAR(A)	rootp->wbi2cslave__DOT_ ## A
+#else
+#define	VVAR(A)	wbi2cslave__DOT_ ## A
+#endif
+
+#ifdef	ROOT_VERILATOR
+#define	mem	VVAR(_mem.m_storage)
+#else
+#define	mem	VVAR(_mem)
+#endif
+
+#define	MEM_ADDR_BITS	8
+#define	FULMEMSZ	(1<<(MEM_ADDR_BITS))
+
+#define	SLAVE_ADDRESS	0x50
+#define	SCK	m_core->i_i2c_scl
+#define	SDA	m_core->i_i2c_sda
+#define	MASTER_WR	0
+#define	MASTER_RD	1
+
+class	I2CS_TB : public WB_TB<Vwbi2cslave> {
+	int		m_halfwait;
+	unsigned long	m_mismatches;
+	I2CSTATS	m_stats;
+public:
+	I2CS_TB(void) : m_halfwait(8), m_mismatches(0) {
+		SCK = 1;
+		SDA = 1;
+	}
+
+	~I2CS_TB(void) {}
+
+	void	reset(void) {
+		// m_flash.debug(false);
+		TESTB<Vwbi2cslave>::reset();
+	}
+
+	void	dbgdump(void) {}
+
+	void	tick(void) {
+		const bool	debug = false;
+		int	sck = SCK, sda = SDA;
+
+		SCK &= m_core->o_i2c_scl;
+		SDA &= m_core->o_i2c_sda;
+
+		if (debug)
+			dbgdump();
+		WB_TB<Vwbi2cslave>::tick();
+
+		SCK = sck & m_core->o_i2c_scl;
+		SDA = sda & m_core->o_i2c_sda;
+
+		// What the master wants is lost in SCK and SDA, so no clock
+		// stretching can be seen here
+		m_stats(I2CBUS(SCK, SDA));
+	}
+
+	const I2CSTATS	&stats(void) const { return m_stats; }
+
+	// SCL high periods from the last replay() where the slave drove SDA
+	// low, but the capture had it high
+	unsigned long	mismatches(void) const { return m_mismatches; }
+
+	// Dump all of the statistics collected so far
+	void	dump_stats(FILE *fp) {
+		m_stats.dump(fp);
+		wb_stalls().dump(fp, "WB stalls, per bus cycle");
+	}
+
+	// Internally, the design keeps things in one memory 32-bits wide.
+	// To get at a byte, we need to select which byte from within it.
+	unsigned char operator[](const int addr) const {
+		unsigned int *memp;
+		int	wv;
+
+		memp = (unsigned int *)m_core->mem;
+		wv = memp[(addr>>2)&((FULMEMSZ-1)>>2)];
+		wv >>= 8*(3-(addr&0x03));
+		return wv & 0x0ff;
+	}
+
+	// Set the number of clocks per half I2C bit
+	void	i2c_speed(int halfwait) {
+		m_halfwait = halfwait;
+	}
+
+	void	i2c_halfwait(void) {
+		for(int i=0; i<m_halfwait; i++)
+			tick();
+	}
+
+	void	i2c_wait(void) {
+		i2c_halfwait();
+		i2c_halfwait();
+	}
+
+	void	i2c_idle(void) {
+		for(int i=0; i<26; i++)
+			i2c_wait();
+	}
+
+	// Drive the bus from a logic analyzer capture, in place of the
+	// i2c_* sequences below, until the capture runs out.  Returns the
+	// number of ticks played.
+	//
+	// Wherever the slave pulls SDA low, the capture should show it low
+	// as well.  Any SCL high period where it doesn't is counted as a
+	// mismatch.  Only the SCL high periods are checked, since that's
+	// when SDA is sampled, and the slave may change SDA a clock or two
+	// later than the captured device did while SCL is low.
+	unsigned long	replay(I2CREPLAY &cap) {
+		I2CBUS	b;
+		bool	bad = false;
+
+		m_mismatches = 0;
+		while(cap(b)) {
+			SCK = b.m_scl;
+			SDA = b.m_sda;
+			tick();
+
+			if (b.m_scl && b.m_sda && !m_core->o_i2c_sda)
+				bad = true;
+			else if (!b.m_scl && bad) {
+				m_mismatches++;
+				bad = false;
+			}
+		} if (bad)
+			m_mismatches++;
+
+		SCK = 1;
+		SDA = 1;
+		return cap.ticks();
+	}
+
+	void	i2c_start() {
+		// printf("I2C-START\n");
+		TBASSERT(*this, ((SCK)&&(SDA)));
+		SDA = 0;
+		i2c_halfwait();
+		SCK = 0;
+		i2c_halfwait();
+	}
+
+	void	i2c_repeat_start() {
+		// printf("I2C-REPEAT-START\n");
+		TBASSERT(*this, (!SCK));
+		SDA = 1;
+		i2c_halfwait();
+		SCK = 1;
+		i2c_halfwait();
+		i2c_start();
+	}
+
+	void	i2c_stop() {
+		TBASSERT(*this, ((!SCK)&&(!SDA)));
+		SCK = 1;
+		i2c_halfwait();
+		SDA = 1;
+		i2c_halfwait();
+		// printf("I2C-STOP\n");
+	}
+
+	int	i2c_rxbit(void) {
+		int	r;
+
+		SDA = 1;
+		i2c_halfwait();
+		SCK = 1;
+		do {
+			i2c_halfwait();
+		} while(SCK == 0);
+		i2c_halfwait();
+		r = SDA;
+		SCK = 0;
+		i2c_halfwait();
+		TBASSERT(*this, (!SCK));
+
+		// printf("I2C-RX: %d\n", r);
+		return r;
+	}
+
+	void	i2c_txbit(int b) {
+		SDA = b;
+		i2c_halfwait();
+		SCK = 1;
+		do {
+			i2c_halfwait();
+		} while(SCK == 0);
+		i2c_halfwait();
+		SCK = 0;
+		i2c_halfwait();
+		TBASSERT(*this, (!SCK));
+	}
+
+	void	i2c_txbyte(const int b) {
+		int	tx = b;
+		for(int i=0; i<8; i++) {
+			i2c_txbit((tx>>7)&1);
+			tx <<= 1;
+		} // printf("TRANSMITTED %02x\n", b);
+	}
+
+	int	i2c_rxbyte(void) {
+		int	b = 0;
+		for(int i=0; i<8; i++) {
+			b = (b<<1) | i2c_rxbit();
+		}
+		// printf("I2C-READ: %02x\n", b);
+		return b;
+	}
+
+	void	i2c_read(int slave_addr, int addr,
+			const unsigned cnt, char *buf) {
+		int	ack;
+
+		if (cnt == 0)
+			return;
+
+		// printf("I2C_READ(SLV=%02x, ADR=%02x, CNT=%d,...)\n",
+		//	slave_addr, addr, cnt);
+
+		slave_addr <<= 1;
+		i2c_start();
+
+		// First, set the address
+		i2c_txbyte((slave_addr&0xfe)|MASTER_WR);//Master is sending data
+		ack = i2c_rxbit();	// (i.e., the address to rd from)
+		// printf("RXACK = %d\n", ack);
+		TBASSERT(*this, (ack==0));
+
+		i2c_txbyte(addr);	// Address we wish to read from
+		ack = i2c_rxbit();
+		// printf("RXACK = %d\n", ack);
+		TBASSERT(*this, (ack==0));
+
+		i2c_repeat_start();
+
+
+		// Then, read the data
+		i2c_txbyte((slave_addr&0xfe)|MASTER_RD); // Request data
+		ack = i2c_rxbit();
+		// printf("RXACK = %d\n", ack);
+		TBASSERT(*this, (ack==0));
+
+		for(unsigned i=0; i<cnt-1; i++) {
+			buf[i] = i2c_rxbyte();
+			i2c_txbit(0);
+			// printf("TX-ACK SENT\n");
+		}
+
+		buf[cnt-1] = i2c_rxbyte();
+
+		// Send a stop bit instead of an ack
+		SDA = 0;
+		i2c_halfwait();
+		i2c_stop();
+	}
+
+	void	i2c_read(int addr, const unsigned cnt, char *buf) {
+		i2c_read(SLAVE_ADDRESS, addr, cnt, buf);
+	}
+
+
+	void	i2c_write(int slave_addr, int addr,
+			const unsigned cnt, const char *buf) {
+		int	ack;
+
+		// printf("I2C_WRITE(SLV=%02x, ADR=%02x, CNT=%d,...)\n",
+		//	slave_addr, addr, cnt);
+
+		slave_addr <<= 1;
+		i2c_start();
+
+		i2c_txbyte((slave_addr&0xfe)|MASTER_WR);
+		ack = i2c_rxbit();
+		// printf("RXACK = %d\n", ack);
+		TBASSERT(*this, (ack==0));
+
+		i2c_txbyte(addr);
+		ack = i2c_rxbit();
+		// printf("RXACK = %d\n", ack);
+		TBASSERT(*this, (ack==0));
+
+		for(unsigned i=0; i<cnt; i++) {
+			i2c_txbyte(buf[i] & 0xff);
+			ack = i2c_rxbit();
+			// printf("RXACK = %d\n", ack);
+			TBASSERT(*this, (ack==0));
+		}
+
+		i2c_stop();
+	}
+
+	void	i2c_write(int addr, const unsigned cnt, const char *buf) {
+		i2c_write(SLAVE_ADDRESS, addr, cnt, buf);
+	}
+
+};
+
+#endif
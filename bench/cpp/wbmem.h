@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	wbmem.h
+// {{{
+// Project:	WBI2C ... a set of Wishbone controlled I2C controllers
+//
+// Purpose:	A Wishbone slave memory model, to serve a core's (pipelined)
+//		Wishbone master port--such as the instruction fetch port of
+//	wbi2ccpu.  Requests are accepted while STB is high and STALL low, and
+//	acknowledged in order, each after a (configurable, and possibly
+//	random) number of wait states.  STALL may be raised at random, during
+//	periodic "refresh" intervals (when acknowledgments are held off as
+//	well), or whenever too many requests are outstanding, so as to mimic a
+//	memory behind a busy interconnect.  Words are big endian, of the width
+//	of the template argument, BW.
+//
+//	Scripts may be loaded straight from i2casm (see TBMEM).
+//
+//	Each clock, call clock() with the master's outputs as they were going
+//	into the clock edge, and then set the slave's inputs from stall(),
+//	ack(), err(), and data().
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBMEM_H
+#define	WBMEM_H
+
+#include <stdint.h>
+
+#include "tbmem.h"
+#include "tbrand.h"
+#include "tbhist.h"
+
+// The most requests that may be outstanding at once
+#define	WBMEM_MAXPENDING	64
+
+template <class BW = uint32_t>	class	WBMEM : public TBMEM {
+	// A request, once accepted, awaiting its acknowledgment
+	typedef	struct {
+		unsigned	m_addr, m_sel;
+		BW		m_data;
+		bool		m_we;
+		unsigned long	m_start, m_due;
+	} WBMEMREQ;
+
+	WBMEMREQ	m_fifo[WBMEM_MAXPENDING];
+	unsigned	m_head, m_count, m_maxpending, m_minwait, m_maxwait;
+	double		m_stall_prob;
+	unsigned long	m_refresh_period, m_refresh_length;
+	TBRAND		m_rng;
+	unsigned long	m_tick, m_waiting, m_requests, m_stalls, m_aborts;
+	TBHIST		m_latency;
+	bool		m_stall, m_ack, m_err;
+	BW		m_data;
+
+	// True if a refresh interval is underway
+	bool	refreshing(void) const {
+		return m_refresh_period
+			&& (m_tick % m_refresh_period) < m_refresh_length;
+	}
+
+	// Words in memory
+	unsigned long	words(void) const { return m_size / sizeof(BW); }
+
+public:
+	WBMEM(const int lgsize, uint64_t seed = 1)
+			: TBMEM(lgsize), m_rng(seed) {
+		m_head = m_count = 0;
+		m_maxpending = WBMEM_MAXPENDING;
+		m_minwait = m_maxwait = 0;
+		m_stall_prob = 0.0;
+		m_refresh_period = m_refresh_length = 0;
+		m_tick = m_waiting = 0;
+		m_requests = m_stalls = m_aborts = 0;
+		m_stall = m_ack = m_err = false;
+		m_data = 0;
+	}
+
+	// Configuration
+	// {{{
+	// Restart the stream the wait states and stalls are drawn from.  Any
+	// other random model in the same bench should be given a seed of its
+	// own, lest the two streams move in lockstep.
+	void	seed(uint64_t s) { m_rng.reseed(s); }
+
+	// Each request is acknowledged after 1+<n> clocks, where n is chosen
+	// (uniformly) from lo through hi.  Zero wait states acknowledges the
+	// clock after the request.
+	void	wait_states(unsigned lo, unsigned hi) {
+		m_minwait = lo;
+		m_maxwait = (hi > lo) ? hi : lo;
+	}
+	void	wait_states(unsigned n) { wait_states(n, n); }
+
+	// Stall any given clock with probability prob
+	void	stall(double prob) { m_stall_prob = prob; }
+
+	// Every <period> clocks, stall for <length> clocks, acknowledging
+	// nothing in the meantime
+	void	refresh(unsigned long period, unsigned long length) {
+		m_refresh_period = period;
+		m_refresh_length = length;
+	}
+
+	// Accept no more than <n> requests before acknowledging the first.
+	// One makes for a memory that isn't pipelined at all.
+	void	pipeline(unsigned n) {
+		m_maxpending = (n < 1) ? 1
+			: (n > WBMEM_MAXPENDING) ? WBMEM_MAXPENDING : n;
+	}
+	// }}}
+
+	// clock
+	// {{{
+	// The master's outputs, as they were going into this clock edge
+	void	clock(bool cyc, bool stb, bool we, unsigned addr, BW data,
+			unsigned sel) {
+		m_tick++;
+
+		if (!cyc)
+			abort();
+		else if (stb && m_stall) {
+			m_stalls++;
+			m_waiting++;
+		} else if (stb) {
+			WBMEMREQ	*req;
+			unsigned	wait = m_minwait;
+
+			if (m_maxwait > m_minwait)
+				wait += m_rng.range(m_maxwait - m_minwait + 1);
+
+			req = &m_fifo[(m_head + m_count) % WBMEM_MAXPENDING];
+			req->m_addr  = addr;
+			req->m_sel   = sel;
+			req->m_data  = data;
+			req->m_we    = we;
+			req->m_start = m_tick - m_waiting;
+			req->m_due   = m_tick + wait;
+			m_count++;
+			m_waiting = 0;
+			m_requests++;
+		}
+
+		// Outputs for the next clock: acknowledge (at most) one
+		// request, in order, once it's due
+		m_ack = m_err = false;
+		if (m_count > 0 && m_fifo[m_head].m_due <= m_tick
+				&& !refreshing()) {
+			WBMEMREQ	*req = &m_fifo[m_head];
+
+			if (req->m_addr >= words())
+				m_err = true;
+			else {
+				if (req->m_we)
+					wrword<BW>(req->m_addr, req->m_data,
+						req->m_sel);
+				else
+					m_data = rdword<BW>(req->m_addr);
+				m_ack = true;
+			}
+			m_latency.add(m_tick + 1 - req->m_start);
+			m_head = (m_head + 1) % WBMEM_MAXPENDING;
+			m_count--;
+		}
+
+		m_stall = (m_count >= m_maxpending) || refreshing()
+			|| (m_stall_prob > 0 && m_rng.uniform() < m_stall_prob);
+	}
+	// }}}
+
+	// The master has dropped CYC, abandoning anything still outstanding
+	void	abort(void) {
+		if (m_count > 0)
+			m_aborts++;
+		m_count = 0;
+		m_waiting = 0;
+		m_ack = m_err = false;
+	}
+
+	// The slave's outputs, for the next clock
+	bool	stall(void) const	{ return m_stall; }
+	bool	ack(void) const		{ return m_ack; }
+	bool	err(void) const		{ return m_err; }
+	BW	data(void) const	{ return m_data; }
+
+	// Statistics
+	// {{{
+	// Requests accepted, clocks a request was stalled, cycles abandoned
+	// with requests outstanding, and the clocks from each request first
+	// being presented until its acknowledgment
+	unsigned long	requests(void) const	{ return m_requests; }
+	unsigned long	stalls(void) const	{ return m_stalls; }
+	unsigned long	aborts(void) const	{ return m_aborts; }
+	const TBHIST	&latency(void) const	{ return m_latency; }
+	// }}}
+};
+
+#endif